@@ -54,6 +54,29 @@ def f_action(label, loss, sampl):
 
 
 
+def read_results(file_path: str) -> list:
+    # binary result files (commune/resultRecord.hpp): 32B header, 32B records
+    if file_path.endswith('.wres'):
+        with open(file_path, 'rb') as f:
+            magic, version, record_size = struct.unpack('<III', f.read(32)[:12])
+            if magic != 0x52505357 or record_size != 32:
+                raise ValueError('{}: not a Whisper result file'.format(file_path))
+            # version 1 has the same record layout, without sampled or aggregate records
+            if version not in (1, 2):
+                raise ValueError('{}: unsupported result file version {}'.format(file_path, version))
+            data = f.read()
+        ls = []
+        for off in range(0, len(data) - len(data) % 32, 32):
+            address, flags, distance, packet_num, _ts = struct.unpack_from('<IIdQd', data, off)
+            # RESULT_FLAG_AGGREGATE: the address is a coarse bucket, not a source
+            if flags & 0x4:
+                continue
+            ls.append([address, distance, packet_num])
+        return ls
+    with open(file_path, 'r') as f:
+        return json.load(f)['Results']
+
+
 def analyze_action(tag: str, malicious_addr: List[str], sampl: int) -> None:
 
     int_malicious_addr = []
@@ -68,18 +91,17 @@ def analyze_action(tag: str, malicious_addr: List[str], sampl: int) -> None:
 
     print('Read files from: ' + save_path + tag)
     for file in traget_files:
-        with open(save_path + tag + '/' + file, 'r') as f:
-            ls = json.load(f)['Results']
-            try:
-                for entery in ls:
-                    if entery[0] in int_malicious_addr:
-                        # print([*(entery[1] for _ in range(entery[2]))])
-                        # print(len([*(entery[1] for _ in range(entery[2]))]))
-                        abnormal.extend([*(entery[1] for _ in range(entery[2]))])
-                    else:
-                        normal.extend([*(entery[1] for _ in range(entery[2]))])
-            except TypeError:
-                continue
+        ls = read_results(save_path + tag + '/' + file)
+        try:
+            for entery in ls:
+                if entery[0] in int_malicious_addr:
+                    # print([*(entery[1] for _ in range(entery[2]))])
+                    # print(len([*(entery[1] for _ in range(entery[2]))]))
+                    abnormal.extend([*(entery[1] for _ in range(entery[2]))])
+                else:
+                    normal.extend([*(entery[1] for _ in range(entery[2]))])
+        except TypeError:
+            continue
 
     print(f'Normal packets: {len(normal)}, Abnormal packets: {len(abnormal)}.')
 
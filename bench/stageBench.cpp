@@ -0,0 +1,364 @@
+// Microbenchmarks of the Whisper pipeline stages on synthetic data, no DPDK device needed.
+//
+//   ./WhisperBench --benchmark_out=bench.json --benchmark_out_format=json
+//   compare.py benchmarks base.json bench.json     (tools/ of Google Benchmark)
+//
+// Arguments: flows, pkts (per flow), n_fft, K, specialized (kernel), precision (of the
+// centers: 0 fp32, 1 bf16, 2 int8), sampling (0 systematic, 1 reservoir, 2 segment), as
+// named in the results.
+
+#include "../common.hpp"
+#include "../commune/dpdkCommon.hpp"
+#include "../commune/spscRing.hpp"
+#include "../commune/waveKernels.hpp"
+#include "../commune/flowSampler.hpp"
+#include "../commune/heavyHitterSketch.hpp"
+#include "../commune/peregrineRecord.hpp"
+#include "../commune/parserWorker.hpp"
+#include "../commune/kMeansLearner.hpp"
+
+#include <pcapplusplus/RawPacket.h>
+
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+using namespace Whisper;
+
+// Mean window of the testing mode, as in configTemplate.json
+#define BENCH_MEAN_WIN 100
+
+static const double_t bench_max_dist = 1e12;
+
+// K random centers of n_fft / 2 + 1 features, in the range of the log power
+static void make_centers(CenterStore & store, size_t K, size_t n_fft, center_precision_t precision) {
+    mt19937 gen(7);
+    uniform_real_distribution<double_t> feature_dist(0, 20);
+    vector<vector<double_t> > centers(K, vector<double_t>(n_fft / 2 + 1));
+    for (auto & c: centers) {
+        for (auto & v: c) {
+            v = feature_dist(gen);
+        }
+    }
+    store.load(centers, precision, false);
+}
+
+// flows * pkts records of flows interleaved packet by packet, as a switch batch would be
+static auto make_batch(size_t flows, size_t pkts, uint32_t seed = 7) -> vector<PktMetadata> {
+    mt19937 gen(seed);
+    uniform_int_distribution<uint16_t> len_dist(64, 1500);
+    uniform_int_distribution<uint16_t> proto_dist(0, 2);
+    static const uint16_t protos[] = {6, 17, 1};
+
+    vector<PktMetadata> batch;
+    batch.reserve(flows * pkts);
+    double_t ts = 1e9;
+    for (size_t p = 0; p < pkts; p ++) {
+        for (size_t f = 0; f < flows; f ++) {
+            ts += 100 + gen() % 1000;
+            batch.emplace_back(htonl(0x0a000000u + (uint32_t) f), protos[proto_dist(gen)],
+                               len_dist(gen), ts);
+        }
+    }
+    return batch;
+}
+
+// Flow states of a batch, as the analyzer keeps them
+static auto make_flow_states(const vector<PktMetadata> & batch) -> unordered_map<uint32_t, FlowState> {
+    BatchGrouper grouper;
+    FlowGroups groups;
+    unordered_map<uint32_t, FlowState> mp;
+    grouper.group(batch.data(), batch.size(), groups);
+    accumulate_groups(batch.data(), groups, mp, [] (uint32_t, FlowState &, bool) -> void {});
+    return mp;
+}
+
+// One flow after the frequency domain transformation
+static auto make_flow_features(size_t pkts, size_t n_fft) -> torch::Tensor {
+    return frequency_transform(encode_flow(make_flow_states(make_batch(1, pkts)).begin()->second), n_fft);
+}
+
+static void bm_peregrine_decode(benchmark::State & state) {
+    const size_t flows = state.range(0);
+
+    vector<shared_ptr<pcpp::RawPacket> > packets;
+    const auto batch = make_batch(flows, 1);
+    uint8_t frame[PEREGRINE_FRAME_MIN_LEN];
+    timeval tv = {0, 0};
+    for (const auto & m: batch) {
+        const size_t len = encode_peregrine_frame(m, frame);
+        packets.push_back(make_shared<pcpp::RawPacket>(frame, (int) len, tv, false));
+    }
+
+    PktMetadata meta;
+    for (auto _ : state) {
+        for (const auto & p_raw: packets) {
+            benchmark::DoNotOptimize(ParserWorkerThread::decode_peregrine(p_raw.get(), meta));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * packets.size());
+}
+BENCHMARK(bm_peregrine_decode)->ArgNames({"flows"})->Arg(1024);
+
+// Parser to analyzer handoff within one core: bursts pushed, then popped in bulk
+static void bm_handoff(benchmark::State & state) {
+    const size_t burst = state.range(0);
+    const auto batch = make_batch(burst, 1);
+    vector<PktMetadata> out(burst);
+    SpscRing<PktMetadata> ring(1 << 16);
+
+    for (auto _ : state) {
+        for (const auto & m: batch) {
+            ring.push(m);
+        }
+        benchmark::DoNotOptimize(ring.pop_bulk(out.data(), burst));
+    }
+    state.SetItemsProcessed(state.iterations() * burst);
+}
+BENCHMARK(bm_handoff)->ArgNames({"burst"})->Arg(32)->Arg(512);
+
+// Parser to analyzer handoff across cores: a producer thread keeps the ring busy
+static void bm_handoff_cross_core(benchmark::State & state) {
+    const size_t burst = state.range(0);
+    const auto batch = make_batch(burst, 1);
+    vector<PktMetadata> out(burst);
+    SpscRing<PktMetadata> ring(1 << 16);
+
+    atomic<bool> stop(false);
+    thread producer([&] () -> void {
+        size_t i = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (ring.push(batch[i])) {
+                i = (i + 1) % batch.size();
+            }
+        }
+    });
+
+    size_t moved = 0;
+    for (auto _ : state) {
+        moved += ring.pop_bulk(out.data(), burst);
+    }
+    stop.store(true, std::memory_order_relaxed);
+    producer.join();
+    state.SetItemsProcessed(moved);
+}
+BENCHMARK(bm_handoff_cross_core)->ArgNames({"burst"})->Arg(512)->UseRealTime();
+
+// Radix grouping of the batch and the append to the flow states
+static void bm_aggregate(benchmark::State & state) {
+    const auto batch = make_batch(state.range(0), state.range(1));
+    BatchGrouper grouper;
+    FlowGroups groups;
+    unordered_map<uint32_t, FlowState> mp;
+
+    for (auto _ : state) {
+        mp.clear();
+        grouper.group(batch.data(), batch.size(), groups);
+        benchmark::DoNotOptimize(accumulate_groups(batch.data(), groups, mp, [] (uint32_t, FlowState &, bool) -> void {}));
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(bm_aggregate)->ArgNames({"flows", "pkts"})
+    ->ArgsProduct({{64, 1024, 65536}, {2, 128, 1024}});
+
+// The grouping alone, against one hash insert per packet
+static void bm_group_radix(benchmark::State & state) {
+    const auto batch = make_batch(state.range(0), state.range(1));
+    BatchGrouper grouper;
+    FlowGroups groups;
+
+    for (auto _ : state) {
+        grouper.group(batch.data(), batch.size(), groups);
+        benchmark::DoNotOptimize(groups.size());
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(bm_group_radix)->ArgNames({"flows", "pkts"})->ArgsProduct({{1024, 65536}, {2, 16}});
+
+static void bm_group_hash(benchmark::State & state) {
+    const auto batch = make_batch(state.range(0), state.range(1));
+    unordered_map<uint32_t, vector<size_t> > mp;
+
+    for (auto _ : state) {
+        mp.clear();
+        for (size_t i = 0; i < batch.size(); i ++) {
+            mp[ntohl(batch[i].ip_src)].push_back(i);
+        }
+        benchmark::DoNotOptimize(mp.size());
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(bm_group_hash)->ArgNames({"flows", "pkts"})->ArgsProduct({{1024, 65536}, {2, 16}});
+
+// Packet encoding of a batch, as accumulate_groups does it record by record
+static void bm_weight_transform(benchmark::State & state) {
+    const auto batch = make_batch(state.range(0), state.range(1));
+    vector<float> values(batch.size());
+
+    for (auto _ : state) {
+        for (size_t i = 0; i < batch.size(); i ++) {
+            values[i] = weight_transform(batch[i]);
+        }
+        benchmark::DoNotOptimize(values.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(bm_weight_transform)->ArgNames({"flows", "pkts"})->ArgsProduct({{64}, {128, 1024}});
+
+// STFT, power and log of one flow
+static void bm_frequency_transform(benchmark::State & state) {
+    const size_t pkts = state.range(0), n_fft = state.range(1);
+    const torch::Tensor ten = encode_flow(make_flow_states(make_batch(1, pkts)).begin()->second).clone();
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(frequency_transform(ten, n_fft));
+    }
+    state.SetItemsProcessed(state.iterations() * pkts);
+}
+BENCHMARK(bm_frequency_transform)->ArgNames({"pkts", "n_fft"})
+    ->ArgsProduct({{128, 1024, 8192}, {16, 50, 128}});
+
+// The same transformation as the packets arrive: frames of the hop and window sums
+static void bm_sliding_spectrum(benchmark::State & state) {
+    const size_t pkts = state.range(0), n_fft = state.range(1);
+    const auto values = make_flow_states(make_batch(1, pkts)).begin()->second.values;
+    const SpectrumPlan plan(n_fft, BENCH_MEAN_WIN, state.range(2) != 0);
+
+    for (auto _ : state) {
+        SlidingSpectrum spectrum;
+        spectrum.push(plan, values.data(), values.size(), [] (const vector<float> & sum, size_t) -> void {
+            benchmark::DoNotOptimize(sum.data());
+        });
+        benchmark::DoNotOptimize(spectrum.window_frames());
+    }
+    state.SetItemsProcessed(state.iterations() * pkts);
+}
+BENCHMARK(bm_sliding_spectrum)->ArgNames({"pkts", "n_fft", "specialized"})
+    ->ArgsProduct({{128, 1024, 8192}, {16, 50, 128}, {0, 1}});
+
+// One elephant flow under the sample cap, in batches of 512 packets; a segment is cut
+// as soon as it is complete
+static void bm_flow_sampler(benchmark::State & state) {
+    const size_t pkts = state.range(0), cap = 1024, batch_len = 512;
+    const auto values = make_flow_states(make_batch(1, batch_len)).begin()->second.values;
+
+    for (auto _ : state) {
+        FlowSampler sampler;
+        sampler.configure(state.range(1), cap, 1);
+        FlowState flow;
+        for (size_t n = 0; n < pkts; n += batch_len) {
+            flow.values.insert(flow.values.end(), values.begin(), values.end());
+            flow.packet_num += batch_len;
+            sampler.apply(flow, false);
+            if (sampler.verdict_len(flow) < flow.values.size()) {
+                sampler.cut(flow, sampler.verdict_len(flow));
+            }
+        }
+        benchmark::DoNotOptimize(flow.values.data());
+    }
+    state.SetItemsProcessed(state.iterations() * pkts);
+}
+BENCHMARK(bm_flow_sampler)->ArgNames({"pkts", "sampling"})
+    ->ArgsProduct({{1 << 16, 1 << 20}, {FLOW_SAMPLING_SYSTEMATIC, FLOW_SAMPLING_RESERVOIR, FLOW_SAMPLING_SEGMENT}});
+
+// Rate estimate of the admission stage under a flood of one-packet sources
+static void bm_admission_sketch(benchmark::State & state) {
+    const auto batch = make_batch(state.range(0), 1);
+    HeavyHitterSketch sketch;
+    sketch.configure(state.range(1), 1.0, 0);
+
+    for (auto _ : state) {
+        for (const auto & info: batch) {
+            benchmark::DoNotOptimize(sketch.add(ntohl(info.ip_src), 1));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(bm_admission_sketch)->ArgNames({"flows", "width"})->ArgsProduct({{65536}, {1 << 12, 1 << 16, 1 << 20}});
+
+static void bm_window_means(benchmark::State & state) {
+    const size_t pkts = state.range(0), n_fft = state.range(1);
+    const torch::Tensor ten_res = make_flow_features(pkts, n_fft);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(window_means(ten_res, BENCH_MEAN_WIN));
+    }
+    state.SetItemsProcessed(state.iterations() * pkts);
+}
+BENCHMARK(bm_window_means)->ArgNames({"pkts", "n_fft"})
+    ->ArgsProduct({{1024, 8192}, {16, 50, 128}});
+
+static void bm_center_distance(benchmark::State & state) {
+    const size_t pkts = state.range(0), n_fft = state.range(1), K = state.range(2);
+    const torch::Tensor means = window_means(make_flow_features(pkts, n_fft), BENCH_MEAN_WIN);
+    CenterStore centers;
+    make_centers(centers, K, n_fft, (center_precision_t) state.range(3));
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(center_distance(means, centers, bench_max_dist));
+    }
+    state.SetItemsProcessed(state.iterations() * pkts);
+}
+BENCHMARK(bm_center_distance)->ArgNames({"pkts", "n_fft", "K", "precision"})
+    ->ArgsProduct({{1024, 8192}, {16, 50, 128}, {10, 30, 1024}, {CENTER_FP32, CENTER_BF16, CENTER_INT8}});
+
+// Everything wave_analyze does to one flow in the testing mode
+static void bm_flow_pipeline(benchmark::State & state) {
+    const size_t flows = state.range(0), pkts = state.range(1);
+    const size_t n_fft = state.range(2), K = state.range(3);
+    const auto batch = make_batch(flows, pkts);
+    CenterStore centers;
+    make_centers(centers, K, n_fft, CENTER_FP32);
+
+    BatchGrouper grouper;
+    FlowGroups groups;
+    unordered_map<uint32_t, FlowState> mp;
+    for (auto _ : state) {
+        mp.clear();
+        grouper.group(batch.data(), batch.size(), groups);
+        accumulate_groups(batch.data(), groups, mp, [] (uint32_t, FlowState &, bool) -> void {});
+        for (const auto & ref: mp) {
+            const torch::Tensor ten_res = frequency_transform(encode_flow(ref.second), n_fft);
+            benchmark::DoNotOptimize(center_distance(window_means(ten_res, BENCH_MEAN_WIN),
+                                                     centers, bench_max_dist));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size());
+}
+BENCHMARK(bm_flow_pipeline)->ArgNames({"flows", "pkts", "n_fft", "K"})
+    ->ArgsProduct({{64}, {256, 1024}, {16, 50, 128}, {10}})->Unit(benchmark::kMillisecond);
+
+// Clustering of flows training records of n_fft / 2 + 1 features into K centers
+static void bm_kmeans_train(benchmark::State & state) {
+    const size_t records = state.range(0), n_fft = state.range(1), K = state.range(2);
+    mt19937 gen(7);
+    normal_distribution<double_t> dist(5.0, 2.0);
+    vector<vector<double_t> > train_set(records, vector<double_t>(n_fft / 2 + 1));
+    for (auto & ve: train_set) {
+        for (auto & v: ve) {
+            v = dist(gen);
+        }
+    }
+
+    const auto p_config = make_shared<LearnerConfigParam>();
+    p_config->val_K = K;
+    p_config->verbose = false;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        KMeansLearner learner(p_config);
+        auto _data = train_set;
+        learner.add_train_data(_data, 0);
+        state.ResumeTiming();
+
+        learner.start_train();
+    }
+    state.SetItemsProcessed(state.iterations() * records);
+}
+BENCHMARK(bm_kmeans_train)->ArgNames({"flows", "n_fft", "K"})
+    ->ArgsProduct({{2000, 20000}, {16, 50, 128}, {10, 30}})->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,290 @@
+#pragma once
+
+#include "../common.hpp"
+#include "evaluationMetrics.hpp"
+
+#include <vector>
+#include <arpa/inet.h>
+
+using namespace std;
+
+namespace Whisper {
+
+struct AccuracyMonitorParam final {
+    // Labels in the analysis/address.json format, empty disables the monitor
+    string label_file = "";
+    // Tag of the replayed trace, "ALL" for the union of every tag
+    string label_tag = "ALL";
+    // Sliding window (s) and the number of slots it advances by
+    double_t window = 60.0;
+    size_t window_slots = 6;
+    // Log-spaced score bins over [0, max_score]
+    size_t score_bins = 256;
+    double_t max_score = 1e6;
+    // Alarm threshold (distance > threshold) and the FPR of the reported TPR
+    double_t threshold = 6.0;
+    double_t at_fpr = 0.1;
+};
+
+// Malicious source addresses (host byte order), open addressing with linear probing
+class LabeledAddressSet final {
+
+    private:
+        vector<uint32_t> slots;
+        // 0 marks an empty slot, so 0.0.0.0 is kept aside
+        bool has_zero = false;
+        size_t mask = 0, num = 0;
+
+        auto static inline hash(uint32_t a) -> size_t {
+            return (size_t) (a * 0x9E3779B1u);
+        }
+
+    public:
+        LabeledAddressSet() = default;
+        virtual ~LabeledAddressSet() {}
+        LabeledAddressSet & operator=(const LabeledAddressSet &) = delete;
+        LabeledAddressSet(const LabeledAddressSet &) = delete;
+
+        void build(const vector<uint32_t> & addresses) {
+            size_t cap = 16;
+            while (cap < 2 * addresses.size()) {
+                cap <<= 1;
+            }
+            slots.assign(cap, 0);
+            mask = cap - 1;
+            num = 0;
+            for (const auto a: addresses) {
+                if (a == 0) {
+                    num += has_zero ? 0 : 1;
+                    has_zero = true;
+                    continue;
+                }
+                size_t i = hash(a) & mask;
+                while (slots[i] != 0 && slots[i] != a) {
+                    i = (i + 1) & mask;
+                }
+                num += slots[i] == 0 ? 1 : 0;
+                slots[i] = a;
+            }
+        }
+
+        auto inline contains(uint32_t a) const -> bool {
+            if (a == 0 || slots.empty()) {
+                return a == 0 && has_zero;
+            }
+            // at most half full, an empty slot ends every probe
+            for (size_t i = hash(a) & mask; ; i = (i + 1) & mask) {
+                if (slots[i] == a) {
+                    return true;
+                }
+                if (slots[i] == 0) {
+                    return false;
+                }
+            }
+        }
+
+        auto inline size() const -> size_t {
+            return num;
+        }
+
+        // Addresses of one tag, or of every tag for "ALL"; entries that are not lists are skipped
+        auto static load(const string & file, const string & tag) -> shared_ptr<LabeledAddressSet> {
+            json j;
+            try {
+                ifstream fin(file, ios::in);
+                fin >> j;
+            } catch (exception & e) {
+                WARN(e.what());
+                return nullptr;
+            }
+            if (tag != "ALL" && !j.count(tag)) {
+                WARNF("Label tag %s not found in %s.", tag.c_str(), file.c_str());
+                return nullptr;
+            }
+            vector<uint32_t> addresses;
+            for (auto it = j.begin(); it != j.end(); ++ it) {
+                if (!it.value().is_array() || (tag != "ALL" && it.key() != tag)) {
+                    continue;
+                }
+                for (const auto & a: it.value()) {
+                    in_addr _addr;
+                    if (a.is_string() && inet_aton(static_cast<string>(a).c_str(), &_addr)) {
+                        addresses.push_back(ntohl(_addr.s_addr));
+                    }
+                }
+            }
+            const auto p_set = make_shared<LabeledAddressSet>();
+            p_set->build(addresses);
+            return p_set;
+        }
+};
+
+// Packet weighted score histograms of both classes, with the confusion counts at the threshold
+struct AccuracySnapshot final {
+    vector<double_t> pos, neg;
+    // tp, fp, tn, fn
+    array<double_t, 4> confusion = {0, 0, 0, 0};
+    uint64_t verdicts = 0;
+
+    void add(const AccuracySnapshot & other) {
+        if (pos.size() < other.pos.size()) {
+            pos.resize(other.pos.size(), 0);
+            neg.resize(other.neg.size(), 0);
+        }
+        for (size_t i = 0; i < other.pos.size(); i ++) {
+            pos[i] += other.pos[i];
+            neg[i] += other.neg[i];
+        }
+        for (size_t i = 0; i < confusion.size(); i ++) {
+            confusion[i] += other.confusion[i];
+        }
+        verdicts += other.verdicts;
+    }
+
+    void clear() {
+        fill(pos.begin(), pos.end(), 0);
+        fill(neg.begin(), neg.end(), 0);
+        confusion = {0, 0, 0, 0};
+        verdicts = 0;
+    }
+};
+
+// Live detection accuracy of one analyzer: every verdict is scored against the labels
+// into the slot of its emission time. Written and read by the analyzer only; the
+// merged view is taken after the worker is joined.
+class AccuracyMonitor final {
+
+    private:
+        AccuracyMonitorParam param;
+        shared_ptr<const LabeledAddressSet> p_labels;
+
+        vector<AccuracySnapshot> slots;
+        AccuracySnapshot total;
+        size_t cur_slot = 0;
+        double_t slot_start = 0;
+
+        auto inline bin_of(double_t score) const -> size_t {
+            const double_t x = log1p(max(score, 0.0)) / log1p(param.max_score);
+            return min(param.score_bins - 1, (size_t) (x * param.score_bins));
+        }
+
+        // Move to the slot of ts, clearing the slots skipped
+        void inline advance(double_t ts) {
+            const double_t slot_len = param.window / slots.size();
+            if (slot_start == 0) {
+                slot_start = ts;
+            }
+            for (size_t k = 0; ts - slot_start >= slot_len && k <= slots.size(); k ++) {
+                cur_slot = (cur_slot + 1) % slots.size();
+                slots[cur_slot].clear();
+                slot_start += slot_len;
+            }
+            if (ts - slot_start >= slot_len) {
+                slot_start = ts;
+            }
+        }
+
+    public:
+        AccuracyMonitor() = default;
+        virtual ~AccuracyMonitor() {}
+        AccuracyMonitor & operator=(const AccuracyMonitor &) = delete;
+        AccuracyMonitor(const AccuracyMonitor &) = delete;
+
+        void configure(const AccuracyMonitorParam & p, const shared_ptr<const LabeledAddressSet> _p_labels) {
+            param = p;
+            param.window_slots = max<size_t>(param.window_slots, 1);
+            param.score_bins = max<size_t>(param.score_bins, 2);
+            p_labels = _p_labels;
+            AccuracySnapshot _empty;
+            _empty.pos.assign(param.score_bins, 0);
+            _empty.neg.assign(param.score_bins, 0);
+            slots.assign(param.window_slots, _empty);
+            total = _empty;
+        }
+
+        auto inline is_enabled() const -> bool {
+            return p_labels != nullptr;
+        }
+
+        // One verdict, address in host byte order
+        void inline record(uint32_t address, double_t distance, size_t packet_num, double_t ts) {
+            if (p_labels == nullptr || std::isnan(distance) || packet_num == 0) {
+                return;
+            }
+            advance(ts);
+            const bool positive = p_labels->contains(address);
+            const size_t b = bin_of(distance);
+            // tp, fp, tn, fn
+            const size_t c = distance > param.threshold ? (positive ? 0 : 1) : (positive ? 3 : 2);
+            for (auto * p_s: {&slots[cur_slot], &total}) {
+                (positive ? p_s->pos : p_s->neg)[b] += packet_num;
+                p_s->confusion[c] += packet_num;
+                p_s->verdicts ++;
+            }
+        }
+
+        // Sliding window ending at ts, or the whole run
+        void merge_window_into(AccuracySnapshot & snap, double_t ts) {
+            if (p_labels == nullptr) {
+                return;
+            }
+            advance(ts);
+            for (const auto & s: slots) {
+                snap.add(s);
+            }
+        }
+
+        void merge_total_into(AccuracySnapshot & snap) const {
+            if (p_labels != nullptr) {
+                snap.add(total);
+            }
+        }
+
+        auto inline get_param() const -> const AccuracyMonitorParam & {
+            return param;
+        }
+
+        // Metrics of a (merged) snapshot, scores at the lower bound of their bin
+        auto static evaluate(const AccuracySnapshot & snap, const AccuracyMonitorParam & p) -> EvaluationResult {
+            EvaluationResult res;
+            res.records = snap.verdicts;
+            WeightedScoreAccumulator acc(p.threshold, snap.pos.size(), p.max_score);
+            for (size_t i = 0; i < snap.pos.size(); i ++) {
+                const double_t s = expm1(((double_t) i) / snap.pos.size() * log1p(p.max_score));
+                acc.add(s, true, snap.pos[i]);
+                acc.add(s, false, snap.neg[i]);
+            }
+            const auto & c = snap.confusion;
+            // the curve needs both classes in the window
+            if ((c[0] + c[3]) > 0 && (c[1] + c[2]) > 0) {
+                res = evaluate_scores(acc, p.threshold, p.at_fpr, 0.9);
+            }
+            // exact at the threshold, the bins only round the curve
+            res.pos_weight = c[0] + c[3];
+            res.neg_weight = c[1] + c[2];
+            res.precision = (c[0] + c[1]) > 0 ? c[0] / (c[0] + c[1]) : 0;
+            res.recall = (c[0] + c[3]) > 0 ? c[0] / (c[0] + c[3]) : 0;
+            res.f1 = f_beta(res.precision, res.recall, 1);
+            res.f2 = f_beta(res.precision, res.recall, 2);
+            return res;
+        }
+
+        // One line summary: AUC, TPR at the FPR, TPR and FPR at the threshold
+        auto static report(const AccuracySnapshot & snap, const AccuracyMonitorParam & p) -> string {
+            if (snap.verdicts == 0) {
+                return "no labeled verdicts";
+            }
+            const auto res = evaluate(snap, p);
+            const auto & c = snap.confusion;
+            const double_t fpr = (c[1] + c[2]) > 0 ? c[1] / (c[1] + c[2]) : 0;
+            char buf[256];
+            snprintf(buf, sizeof(buf),
+                     "%lu verdicts (%.0lf malicious / %.0lf benign pkts), AUC %.4lf, TPR@FPR=%.2lf %.4lf, "
+                     "at %.1lf: TPR %.4lf FPR %.4lf F1 %.4lf",
+                     snap.verdicts, res.pos_weight, res.neg_weight, res.roc_auc, p.at_fpr, res.tpr_at_fpr,
+                     p.threshold, res.recall, fpr, res.f1);
+            return buf;
+        }
+};
+
+}
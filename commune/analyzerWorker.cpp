@@ -15,9 +15,6 @@ void AnalyzerWorkerThread::stop() {
     sum_analysis_pkt_len += analysis_pkt_len;
 
     analysis_end_ts = __get_double_ts();
-    if (p_analyzer_conf->save_to_file) {
-        save_res_json();
-    }
 
     if (true) {
         printf("Analyzer on core # %2d: Runtime: %5.2lfs,\
@@ -43,19 +40,38 @@ bool AnalyzerWorkerThread::run(uint32_t coreId) {
         return false;
     }
 
-    meta_pkt_arr = shared_ptr<PktMetadata[]>(new PktMetadata[meta_pkt_arr_size](),
-												std::default_delete<PktMetadata[]>());
+    // per-worker buffers on the socket of this core, faulted in before the first batch
+    const int socket_id = socket_of_core(coreId);
+
+    meta_pkt_arr = make_socket_array<PktMetadata>(meta_pkt_arr_size, socket_id,
+                                                  "whisper_analyzer_meta");
     if (meta_pkt_arr == nullptr) {
         WARN("Meta packet array: bad allocation");
         return false;
     }
 
-    flow_records = shared_ptr<FlowRecord[]>(new FlowRecord[result_buffer_size](),
-											std::default_delete<FlowRecord[]>());
+    if (p_analyzer_conf->save_to_file && p_analyzer_conf->save_binary) {
+        const auto p_writer_config = make_shared<ResultWriterConfigParam>();
+        p_writer_config->save_dir = p_analyzer_conf->save_dir;
+        p_writer_config->save_file_prefix = p_analyzer_conf->save_file_prefix;
+        p_writer_config->fsync_interval = p_analyzer_conf->result_fsync_interval;
+        p_writer_config->rotate_size = p_analyzer_conf->result_rotate_size << 20;
+        p_writer_config->rotate_interval = p_analyzer_conf->result_rotate_interval;
+        p_writer_config->queue_size = result_buffer_size;
+
+        p_result_writer = make_shared<ResultWriter>(p_writer_config, coreId);
+        if (!p_result_writer->start()) {
+            WARN("Result writer: start failed");
+            return false;
+        }
+    } else if (p_analyzer_conf->save_to_file) {
+        flow_records = make_socket_array<FlowRecord>(result_buffer_size, socket_id,
+                                                     "whisper_analyzer_result");
 
-    if (flow_records == nullptr) {
-        WARN("Result buffer: bad allocation");
-        return false;
+        if (flow_records == nullptr) {
+            WARN("Result buffer: bad allocation");
+            return false;
+        }
     }
 
     if (p_analyzer_conf->init_verbose) {
@@ -65,16 +81,52 @@ bool AnalyzerWorkerThread::run(uint32_t coreId) {
     m_core_id = coreId;
     m_stop = false;
 
-    centers = torch::zeros({(long) p_learner->get_K(),
-                            (long) (p_analyzer_conf->n_fft / 2) + 1});
+    if (p_analyzer_conf->incremental_dft) {
+        p_spectrum_plan = make_shared<SpectrumPlan>(p_analyzer_conf->n_fft, p_analyzer_conf->mean_win_test);
+        if (p_analyzer_conf->init_verbose) {
+            LOGF("Analyzer on core # %2d: %s spectrum kernel for n_fft %ld (specialized: %s).", coreId,
+                 is_specialized_frame_kernel(p_analyzer_conf->n_fft) ? "compiled" : "generic",
+                 p_analyzer_conf->n_fft, SPECTRUM_SPECIALIZED_SIZES);
+        }
+        if (p_analyzer_conf->flow_idle_timeout <= 0) {
+            WARN("Incremental DFT keeps every flow until it expires, but flow_idle_timeout is 0.");
+        }
+        if (p_analyzer_conf->work_stealing) {
+            WARN("Work stealing covers the batch STFT only, no task pool with incremental DFT.");
+        }
+    }
+
+    if (p_analyzer_conf->flow_sample_cap > 0) {
+        // a cap below the analysis length would never let a flow reach it
+        const size_t cap = max(p_analyzer_conf->flow_sample_cap, 2 * p_analyzer_conf->n_fft);
+        flow_sampler.configure(p_analyzer_conf->flow_sampling, cap, m_shard_id + 1);
+    }
+
+    if (p_analyzer_conf->admission_rate > 0) {
+        admission_min = (uint32_t) max<double_t>(1, round(p_analyzer_conf->admission_rate
+                                                          * p_analyzer_conf->admission_window));
+        admission_sketch.configure(p_analyzer_conf->admission_sketch_width,
+                                   p_analyzer_conf->admission_window, __get_double_ts());
+        coarse_flows.resize(p_analyzer_conf->coarse_buckets);
+        if (p_analyzer_conf->save_to_file && !p_analyzer_conf->save_binary) {
+            WARN("Coarse verdicts of the light sources are written to binary results only, not to json.");
+        }
+    }
+
+    if (p_analyzer_conf->flow_idle_timeout > 0) {
+        flow_timers.configure(p_analyzer_conf->flow_timer_tick, __get_double_ts());
+    }
 
     analysis_pkt_num = 0;
     analysis_pkt_len = 0;
     double_t __s = __get_double_ts();
+    fetch_wait_since.assign(p_parser.size(), 0);
 
     while(!m_stop) {
-        // pause and wait data from ParserWorkers
-        usleep(pause_time);
+        // pause and wait data from ParserWorkers, no pause while draining
+        if (!m_drain.load(std::memory_order_acquire)) {
+            usleep(pause_time);
+        }
 
         // for performance statistic
         double_t __t = __get_double_ts();
@@ -96,169 +148,281 @@ bool AnalyzerWorkerThread::run(uint32_t coreId) {
             analysis_pkt_len = 0;
             __s = __t;
 
-            #ifdef DETAIL_TIME_ANALYZE
-                if (true) {
-                    LOGF("Analyzer on core # %2d: [Encoding: %4.2lf, Transfrom: %4.2lf,\
-                         Distance: %4.2lf, Aggregate: %4.2lf].",
-                         getCoreId(),
-                         sum_weight_time, sum_transform_time, sum_dist_time, sum_aggregate_time);
-
-                    #ifdef __DETAIL_TIME_ANALYZE
-                        LOGF("Analyzer on core # %2d: Averaged analysis time: %4.2lfs / call\
-                            (%ld calls).",
-                            getCoreId(),
-                            (sum_weight_time + sum_transform_time + sum_dist_time +
-                            sum_aggregate_time) / analyze_entrance, analyze_entrance);
-                        analyze_entrance = 0;
-                    #endif
-                    sum_weight_time = 0;
-                    sum_dist_time = 0;
-                    sum_transform_time = 0;
-                    sum_aggregate_time = 0;
-                }
-            #endif
+            // age out the tracked sources, flows still waiting in mp stay tracked
+            p_tracked_filter->advance();
+            for (const auto & ref: mp) {
+                p_tracked_filter->mark(htonl(ref.first));
+            }
+
+            if (p_analyzer_conf->center_validation && ! m_is_train) {
+                LOGF("Analyzer on core # %2d %s centers vs. double: %s", getCoreId(),
+                     center_precision_name(p_analyzer_conf->center_precision), center_validation.report().c_str());
+            }
+
+            if (p_analyzer_conf->flow_verbose) {
+                LOGF("Analyzer on core # %2d flows: %s", getCoreId(), flow_table_report().c_str());
+            }
+
+            if (p_analyzer_conf->stage_verbose && StageProfiler::is_enabled()) {
+                vector<HistogramSnapshot> _snapshots;
+                stage_profiler.merge_into(_snapshots);
+                printf("Analyzer on core # %2d stage latency:\n%s",
+                       getCoreId(), StageProfiler::report(_snapshots).c_str());
+            }
+
+            if (p_analyzer_conf->latency_verbose && ! m_is_train) {
+                HistogramSnapshot _snap;
+                latency_tracker.merge_into(_snap);
+                const auto _num = get_detection_latency_num();
+                LOGF("Analyzer on core # %2d detection latency: %s", getCoreId(),
+                     DetectionLatencyTracker::report(_snap, _num.first, _num.second,
+                                                     p_analyzer_conf->detection_latency.slo_ms).c_str());
+            }
+
+            if (p_analyzer_conf->accuracy_verbose && accuracy_monitor.is_enabled() && ! m_is_train) {
+                AccuracySnapshot _snap;
+                accuracy_monitor.merge_window_into(_snap, __get_double_ts());
+                LOGF("Analyzer on core # %2d accuracy (last %.0lfs): %s", getCoreId(),
+                     p_analyzer_conf->accuracy_monitor.window,
+                     AccuracyMonitor::report(_snap, p_analyzer_conf->accuracy_monitor).c_str());
+            }
         }
 
         // fetch pper-packets properties form ParserWorkers
+        const uint64_t _t_fetch = StageProfiler::begin();
+        const size_t _fetch_begin = m_index;
         size_t sum_fetch = 0;
-        for (const auto _p : p_parser) {
-            _p->acquire_semaphore();
-            sum_fetch += fetch_from_parser(_p);
-            _p->release_semaphore();
+        for (size_t i = 0; i < p_parser.size(); i ++) {
+            sum_fetch += fetch_from_parser(p_parser[i], fetch_wait_since[i], __t);
+        }
+        if (sum_fetch != 0) {
+            fetched_num.fetch_add(sum_fetch, std::memory_order_relaxed);
+            stage_profiler.end(STAGE_FETCH, _t_fetch);
+            calibrate_clock(_fetch_begin);
         }
 
         if (sum_fetch == 0) {
+            // the parsers are stopped and every ring of this shard is empty
+            if (m_drain.load(std::memory_order_acquire)) {
+                wave_analyze(true);
+                m_drained.store(true, std::memory_order_release);
+                break;
+            }
+            // no traffic: the idle flows still expire, and the others may need a hand
+            expire_idle_flows(__get_double_ts());
+            if (p_task_pool != nullptr) {
+                steal_flow_tasks();
+                collect_flow_tasks();
+            }
             continue;
         }
 
         // analyze action
-        double start = __get_double_ts();
         wave_analyze();
-        double end = __get_double_ts();
         analysis_pkt_num += sum_fetch;
     }
 
     return true;
 }
 
-auto AnalyzerWorkerThread::fetch_from_parser(const shared_ptr<ParserWorkerThread> pt)
-        const -> size_t {
-    size_t copy_len = 0;
-    size_t new_index = 0;
+void AnalyzerWorkerThread::calibrate_clock(size_t begin) {
+    // the newest record of the batch has the smallest host - switch delay
+    const auto raw_data = meta_pkt_arr.get();
+    double_t newest = 0;
+    for (size_t i = begin; i < m_index; i ++) {
+        newest = max(newest, raw_data[i].ts);
+    }
+    if (newest > 0) {
+        latency_tracker.observe_arrival(newest, __get_double_ts());
+    }
+}
 
-    if (pt->meta_index < 50) {
+auto AnalyzerWorkerThread::fetch_from_parser(const shared_ptr<ParserWorkerThread> pt, double_t & wait_since,
+                                             double_t now) const -> size_t {
+    if (m_shard_id >= pt->meta_rings.size()) {
         return 0;
     }
+    const auto & p_ring = pt->meta_rings[m_shard_id];
+
+    // a small batch waits for more records, but no longer than max_fetch_wait,
+    // a low-rate shard may never fill it
+    const size_t ring_len = p_ring->size();
+    if (ring_len < min_fetch && !m_drain.load(std::memory_order_relaxed)) {
+        if (ring_len == 0) {
+            wait_since = 0;
+            return 0;
+        }
+        if (wait_since == 0) {
+            wait_since = now;
+        }
+        if (now - wait_since < max_fetch_wait) {
+            return 0;
+        }
+    }
 
-    if (pt->meta_index + m_index < meta_pkt_arr_size) {
-        copy_len = pt->meta_index > max_fetch ? max_fetch : pt->meta_index;
-        LOGF("copied len: %lu", copy_len);
-    } else {
-        copy_len = min(meta_pkt_arr_size - m_index - 1, max_fetch);
-        WARNF("Analyzer on core # %2d: queue reach max.\n", getCoreId());
+    // records that do not fit stay in the ring until the next round
+    const size_t space = meta_pkt_arr_size - m_index;
+    if (space == 0) {
+        AWARNF("Analyzer on core # %2d: queue reach max.", getCoreId());
+        return 0;
     }
-    new_index = pt->meta_index - copy_len;
 
-    // memory copy from registed ParserWorker and reset the buffer
-    memcpy(meta_pkt_arr.get() + m_index, pt->meta_pkt_arr.get(), copy_len * sizeof(PktMetadata));
+    const size_t copy_len = p_ring->pop_bulk(meta_pkt_arr.get() + m_index, min(space, max_fetch));
+    ALOGF_DEBUG("copied len: %lu", copy_len);
     m_index += copy_len;
-    pt->meta_index = new_index;
+    wait_since = 0;
 
     return copy_len;
 }
 
-void AnalyzerWorkerThread::wave_analyze() {
+void AnalyzerWorkerThread::wave_analyze(bool final_pass) {
     const auto cur_len = m_index;
     const auto raw_data = meta_pkt_arr.get();
     static const double_t min_interval_time = 1e-5;
 
-    #ifdef DETAIL_TIME_ANALYZE
-        double_t s = __get_double_ts();
-        #ifdef __DETAIL_TIME_ANALYZE
-            ++ analyze_entrance;
-        #endif
-    #endif
+    const uint64_t _t_aggregate = StageProfiler::begin();
 
-    for (size_t i = 0; i < cur_len; i++) {
-        // the tag for aggregate
-        uint32_t ip_src = (ntohl(raw_data[i].ip_src));
-        analysis_pkt_len += raw_data[i].length;
-        if(mp.find(ip_src) == mp.end()){
-            mp.insert(pair<uint32_t, vector<size_t> >(
-                ip_src, vector<size_t>())
-            );
-        }
-        mp[ip_src].push_back(i);
+    batch_grouper.group(raw_data, cur_len, batch_groups);
+
+    // flows that reach the analysis length join the ready queue once, the others wait
+    // in mp for more packets or for the idle timer
+    const double_t now = __get_double_ts();
+    const size_t ready_len = 2 * p_analyzer_conf->n_fft;
+    if (admission_sketch.is_enabled()) {
+        admission_sketch.decay(now);
     }
+    analysis_pkt_len += accumulate_groups(raw_data, batch_groups, mp,
+                                          [this, now, ready_len] (uint32_t key, FlowState & state, bool is_new) -> void {
+        state.last_seen = now;
+        if (is_new) {
+            p_tracked_filter->mark(htonl(key));
+            state.gen = ++ flow_gen;
+            peak_flow_num = max(peak_flow_num, mp.size());
+            if (flow_timers.is_enabled()) {
+                flow_timers.schedule(key, state.gen, now + p_analyzer_conf->flow_idle_timeout);
+            }
+        }
+        flow_sampler.apply(state, is_incremental());
+        bool ready = state.values.size() >= ready_len;
+        if (is_incremental()) {
+            // transformed as the packets arrive: ready on a completed window, or at the
+            // analysis length for the first verdict of the flow
+            feed_spectrum(state);
+            ready = state.pending_dist >= 0 || (state.reported_num == 0 && state.packet_num >= ready_len);
+        }
+        if (!state.queued && ready) {
+            state.queued = true;
+            ready_flows.push_back(key);
+        }
+    }, [this, raw_data] (uint32_t key, size_t k, bool is_new) -> bool {
+        if (!admission_sketch.is_enabled()) {
+            return true;
+        }
+        // every packet counts toward the rate, the flows of mp stay admitted
+        const uint32_t est = admission_sketch.add(key, batch_groups.count[k]);
+        if (!is_new || est >= admission_min) {
+            return true;
+        }
+        add_coarse_packets(key, raw_data, k);
+        return false;
+    });
 
-    #ifdef DETAIL_TIME_ANALYZE
-        sum_aggregate_time +=  __get_double_ts() - s;
-    #endif
+    stage_profiler.end(STAGE_AGGREGATE, _t_aggregate);
 
     /* // clear the buffer */
     m_index = 0;
 
-    LOGF("cur len: %lu", cur_len);
+    ALOGF_DEBUG("cur len: %lu", cur_len);
     received_num += cur_len;
-    LOGF("Received num: %d", received_num);
-
-    decltype(mp)::const_iterator iter_mp;
-    for (iter_mp = mp.cbegin(); iter_mp != mp.cend();) {
-        const auto & _ve = iter_mp->second;
-        /* LOGF("ip src: %u", iter_mp->first); */
-        /* LOGF("mp.size: %lu", mp.size()); */
-        /* LOGF("ve.size: %lu", _ve.size()); */
-        /* LOGF("n_fft: %lu", p_analyzer_conf->n_fft); */
-        if(_ve.size() < 2 * p_analyzer_conf->n_fft) {
-            /* LOGF("TEST 4"); */
-            ++iter_mp;
-            continue;
-        }
+    ALOGF_DEBUG("Received num: %d", received_num);
 
-        // packet encoding
-        #ifdef DETAIL_TIME_ANALYZE
-            double_t _s0 = __get_double_ts();
-        #endif
+    if (!coarse_flows.empty()) {
+        score_coarse_flows(final_pass);
+    }
 
-        torch::Tensor ten = torch::zeros(_ve.size());
-        for (int i = 0; i < _ve.size(); i++) {
-            ten[i] = weight_transform(raw_data[_ve[i]]);
+    if (final_pass && m_is_train) {
+        LOGF("Analyzer on core # %2d: stopped in training mode, %ld flows not analyzed.",
+             getCoreId(), mp.size());
+        mp.clear();
+        ready_flows.clear();
+        flow_timers.clear();
+        return;
+    }
+
+    if (!final_pass) {
+        expire_idle_flows(now);
+    }
+
+    // flows shorter than one DFT window can not be scored even in the final pass
+    const size_t min_flow_len = final_pass ? p_analyzer_conf->n_fft : ready_len;
+    if (final_pass) {
+        for (auto & ref: mp) {
+            if (!ref.second.queued && ref.second.packet_num >= min_flow_len) {
+                ref.second.queued = true;
+                ready_flows.push_back(ref.first);
+            }
         }
+    }
 
-        #ifdef DETAIL_TIME_ANALYZE
-            sum_weight_time += __get_double_ts() - _s0;
-        #endif
+    for (size_t ready_pos = 0; ready_pos < ready_flows.size(); ready_pos ++) {
+        const auto iter_mp = mp.find(ready_flows[ready_pos]);
+        if (iter_mp == mp.end()) {
+            continue;
+        }
+        // the spectrum is up to date, the flow stays for its next window
+        if (is_incremental()) {
+            spectrum_verdict(iter_mp->first, iter_mp->second);
+            if (final_pass) {
+                mp.erase(iter_mp);
+            }
+            continue;
+        }
+        // a segment leaves the samples after it in the flow for another verdict
+        auto & state = iter_mp->second;
+        const size_t verdict_len = flow_sampler.verdict_len(state);
+        const uint64_t verdict_packets = flow_sampler.verdict_packets(state, verdict_len);
+        const bool segmented = verdict_len < state.values.size();
+
+        // the transform runs on this analyzer or on an idle one, the verdict comes back here
+        if (p_task_pool != nullptr && !m_is_train) {
+            FlowTask t;
+            t.address = iter_mp->first;
+            if (segmented) {
+                t.values.assign(state.values.begin(), state.values.begin() + verdict_len);
+            } else {
+                t.values.swap(state.values);
+            }
+            t.packet_num = verdict_packets;
+            t.last_ts = state.last_ts;
+            t.partial = verdict_len < 2 * p_analyzer_conf->n_fft;
+            t.p_centers = &center_store;
+            p_task_pool->push(m_shard_id, std::move(t));
+            // the whole flow went with the task, nothing is left to cut
+            if (segmented) {
+                next_segment(iter_mp, verdict_len, final_pass);
+            } else {
+                mp.erase(iter_mp);
+            }
+            continue;
+        }
 
-        // frequency domain analysis
-        #ifdef DETAIL_TIME_ANALYZE
-            double_t _s1 = __get_double_ts();
-        #endif
+        // packet encoding
+        const uint64_t _t_encode = StageProfiler::begin();
 
-        // DFT on flow vector
-        LOGF("DFT on flow vector");
-        torch::Tensor ten_fft = torch::stft(ten, p_analyzer_conf->n_fft);
+        const torch::Tensor ten = encode_flow(state, verdict_len);
 
-        // calculate the power
-        LOGF("Calculate the power");
-        torch::Tensor ten_power = ten_fft.permute({2, 0, 1})[0] * ten_fft.permute({2, 0, 1})[0] +
-                                  ten_fft.permute({2, 0, 1})[1] * ten_fft.permute({2, 0, 1})[1];
-        ten_power = ten_power.squeeze();
+        stage_profiler.end(STAGE_ENCODE, _t_encode);
 
-        // log linear transformation
-        LOGF("Log linear transformation");
-        torch::Tensor ten_res = ((ten_power + 1).log2()).permute({1, 0});
+        // frequency domain analysis
+        const uint64_t _t_transform = StageProfiler::begin();
 
-        // erase the inf and nan
-        LOGF("Erase the inf and nan");
-        ten_res = torch::where(torch::isnan(ten_res), torch::full_like(ten_res, 0), ten_res);
-        ten_res = torch::where(torch::isinf(ten_res), torch::full_like(ten_res, 0), ten_res);
+        // DFT, power and log linear transformation
+        const torch::Tensor ten_res = frequency_transform(ten, p_analyzer_conf->n_fft);
 
-        #ifdef DETAIL_TIME_ANALYZE
-            sum_transform_time += __get_double_ts() - _s1;
-        #endif
+        stage_profiler.end(STAGE_TRANSFORM, _t_transform);
 
         if (m_is_train) {
-            LOGF("Enter train");
+            ALOGF_DEBUG("Enter train");
             /* LOGF("Current packets: %ld", _ve.size()); */
             // feed data to learner
             torch::Tensor ten_temp;
@@ -273,31 +437,30 @@ void AnalyzerWorkerThread::wave_analyze() {
                         0, start_index,
                         start_index + p_analyzer_conf->mean_win_train).mean(0);
 
-                    vector<double_t> _dt;
-                    for(size_t j = 0; j < ten_temp.size(0); j ++) {
-                        _dt.push_back((double_t) ten_temp[j].item<double_t>());
-                    }
-                    data_to_add.push_back(_dt);
+                    const torch::Tensor _row = ten_temp.contiguous();
+                    const float * _p = _row.data_ptr<float>();
+                    data_to_add.emplace_back(_p, _p + _row.size(0));
                 }
 
                 /* LOGF("IF"); */
                 /* LOGF("Received packets: %lu", ten_res.size(0)); */
+                const uint64_t _t_learner = StageProfiler::begin();
                 p_learner->acquire_semaphore_data();
                 p_learner->add_train_data(data_to_add, cur_len);
                 p_learner->release_semaphore_data();
+                stage_profiler.end(STAGE_LEARNER, _t_learner);
             } else {
                 /* LOGF("ELSE"); */
                 /* LOGF("Received packets: %lu", ten_res.size(0)); */
-                ten_temp =  ten_res.mean(0);
-                vector<double_t> data_to_add;
-
-                for(size_t j = 0; j < ten_temp.size(0); j ++) {
-                    data_to_add.push_back((double_t) ten_temp[j].item<double_t>());
-                }
+                ten_temp =  ten_res.mean(0).contiguous();
+                const float * _p = ten_temp.data_ptr<float>();
+                vector<double_t> data_to_add(_p, _p + ten_temp.size(0));
 
+                const uint64_t _t_learner = StageProfiler::begin();
                 p_learner->acquire_semaphore_data();
                 p_learner->add_train_data(data_to_add, cur_len);
                 p_learner->release_semaphore_data();
+                stage_profiler.end(STAGE_LEARNER, _t_learner);
             }
 
             // can start train, but none start train
@@ -309,16 +472,16 @@ void AnalyzerWorkerThread::wave_analyze() {
                     LOGF("Analyer on core %2d: trigger the training of learner.", getCoreId());
                 }
                 p_learner->start_train();
-                LOGF("release semaphore learn: begin");
+                ALOGF_DEBUG("release semaphore learn: begin");
                 p_learner->release_semaphore_learn();
-                LOGF("release semaphore learn: end");
+                ALOGF_DEBUG("release semaphore learn: end");
             } else {
                 p_learner->release_semaphore_learn();
             }
 
             // train is finished, but still train
             if (p_learner->finish_learn && m_is_train) {
-                LOGF("additional training: start");
+                ALOGF_DEBUG("additional training: start");
 
                 m_is_train = false;
                 analysis_start_ts = __get_double_ts();
@@ -329,81 +492,378 @@ void AnalyzerWorkerThread::wave_analyze() {
 
                 // copy training results from learner (clustering centers)
                 const auto & train_res = p_learner->train_result;
+                center_store.load(train_res, p_analyzer_conf->center_precision,
+                                  p_analyzer_conf->center_validation);
 
                 if(p_analyzer_conf->mode_verbose) {
-                    LOGF("Analyer on core %2d: enter execution mode.", getCoreId());
+                    LOGF("Analyer on core %2d: enter execution mode, %ld centers of %ld features (%ld B).",
+                         getCoreId(), center_store.size(), center_store.dimension(),
+                         center_store.memory_bytes());
                 }
 
                 if(getCoreId() == p_analyzer_conf->verbose_center_core &&
                     p_analyzer_conf->center_verbose) {
+                    for (size_t i = 0; i < train_res.size(); i ++) {
+                        stringstream ss;
+                        for (const auto v: train_res[i]) {
+                            ss << ' ' << v;
+                        }
+                        LOGF("Center %2ld:%s", i, ss.str().c_str());
+                    }
                 }
             }
+            // the flow stays at the head of the queue for the next batch, its next segment
+            // if it has one
+            if (segmented) {
+                flow_sampler.cut(state, verdict_len);
+            }
+            ready_flows.erase(ready_flows.begin(), ready_flows.begin() + ready_pos);
             usleep(50000);
             return;
         }
 
         // In testing phase, calculate the min distance of the cluster centers
-        #ifdef DETAIL_TIME_ANALYZE
-            double_t _s2 = __get_double_ts();
-        #endif
-
-        double min_dist = max_cluster_dist;
-        if (ten_res.size(0) > p_analyzer_conf->mean_win_test) {
-            double_t _max_dist = 0;
-
-            for (size_t i = 0; i + p_analyzer_conf->mean_win_test < ten_res.size(0);
-                        i += p_analyzer_conf->mean_win_test) {
-                torch::Tensor tt =  ten_res.slice(
-                        0, i, i + p_analyzer_conf->mean_win_test).mean(0);
-                double_t _min_dist = max_cluster_dist;
-
-                for (size_t j = 0; j < centers.size(0); j ++) {
-                    double_t d = torch::norm(tt - centers[j]).item<double_t>();
-                    _min_dist = min(_min_dist, d);
-                }
-                _max_dist = max(_max_dist, _min_dist);
-            }
-            min_dist = _max_dist;
-        } else {
-            torch::Tensor tt = ten_res.mean(0);
+        const uint64_t _t_distance = StageProfiler::begin();
 
-            for (size_t j = 0; j < centers.size(0); j ++) {
-                double d = torch::norm(tt - centers[j]).item<double_t>();
-                min_dist = min(min_dist, d);
-            }
-        }
+        const torch::Tensor _means = window_means(ten_res, p_analyzer_conf->mean_win_test).contiguous();
+        const double_t min_dist = score_rows(_means.data_ptr<float>(), _means.size(0));
 
-        #ifdef DETAIL_TIME_ANALYZE
-            sum_dist_time += __get_double_ts() - _s2;
-        #endif
+        stage_profiler.end(STAGE_DISTANCE, _t_distance);
 
         if (p_analyzer_conf->ip_verbose) {
             if (p_analyzer_conf->verbose_ip_target.length() != 0 &&
                 pcpp::IPv4Address(htonl(iter_mp->first)) == pcpp::IPv4Address(
                     p_analyzer_conf->verbose_ip_target)) {
-                LOGF("Analyzer on core # %2d: %6ld abnormal packets, with loss: %6.3lf",
+                ALOGF("Analyzer on core # %2d: %6ld abnormal packets, with loss: %6.3lf",
                 getCoreId(),
-                iter_mp->second.size(),
+                verdict_packets,
                 min_dist);
             }
         }
 
-        if (p_analyzer_conf->save_to_file) {
-            auto & buf_loc = flow_records[flow_record_size % result_buffer_size];
-            buf_loc = {.address = iter_mp->first,
-                       .distence = min_dist,
-                       .packet_num = iter_mp->second.size()};
-            ++ flow_record_size;
+        // the packet that completed the window is the newest one of the flow
+        emit_result(iter_mp->first, min_dist, verdict_packets, verdict_len,
+                    verdict_len < 2 * p_analyzer_conf->n_fft, state.last_ts);
+
+        // Delete flow from mp, its timer entry is dropped when it comes due
+        next_segment(iter_mp, verdict_len, final_pass);
+    }
+    ready_flows.clear();
+    // segments left for the next batch, at most one verdict per flow and batch
+    ready_flows.swap(carried_flows);
+
+    if (p_task_pool != nullptr) {
+        run_flow_tasks(final_pass);
+    }
+
+    if (final_pass && mp.size()) {
+        LOGF("Analyzer on core # %2d: %ld flows shorter than %ld packets not analyzed.",
+             getCoreId(), mp.size(), min_flow_len);
+        mp.clear();
+        flow_timers.clear();
+    }
+    if (final_pass && p_analyzer_conf->center_validation) {
+        LOGF("Analyzer on core # %2d %s centers vs. double: %s", getCoreId(),
+             center_precision_name(p_analyzer_conf->center_precision), center_validation.report().c_str());
+    }
+    if (final_pass && p_task_pool != nullptr) {
+        LOGF("Analyzer on core # %2d: ran %lu flow tasks of other analyzers.", getCoreId(), stolen_task_num);
+    }
+    if (final_pass && flow_timers.is_enabled()) {
+        LOGF("Analyzer on core # %2d flows: %s", getCoreId(), flow_table_report().c_str());
+    }
+}
+
+void AnalyzerWorkerThread::expire_idle_flows(double_t now) {
+    if (!flow_timers.is_enabled()) {
+        return;
+    }
+    const double_t timeout = p_analyzer_conf->flow_idle_timeout;
+    flow_timers.advance(now, [this, now, timeout] (const FlowTimerWheel::Entry & e) -> void {
+        const auto it = mp.find(e.key);
+        if (it == mp.end() || it->second.gen != e.gen) {
+            return;
+        }
+        // active since it was scheduled, or waiting on the ready queue
+        const double_t deadline = it->second.last_seen + timeout;
+        if (deadline > now || it->second.queued) {
+            flow_timers.schedule(e.key, e.gen, deadline > now ? deadline : now + timeout);
+            return;
+        }
+
+        auto & state = it->second;
+        expired_flow_num ++;
+        if (is_incremental()) {
+            feed_spectrum(state);
+            state.spectrum.pad_frame(*p_spectrum_plan);
+        }
+        const size_t unreported = state.packet_num - state.reported_num;
+        if (unreported == 0) {
+            // every packet is covered by a verdict already
+            mp.erase(it);
+            return;
+        }
+        if (m_is_train || p_analyzer_conf->flow_expiry != FLOW_EXPIRY_FALLBACK
+                || unreported < p_analyzer_conf->fallback_min_packets
+                || (is_incremental() && state.spectrum.window_frames() == 0)) {
+            expired_drop_num ++;
+            mp.erase(it);
+            return;
+        }
+
+        double_t min_dist;
+        if (is_incremental()) {
+            // the window in progress, zero padded when the flow is shorter than n_fft
+            const uint64_t _t_distance = StageProfiler::begin();
+            spectrum_mean(state.spectrum.window_sum(), state.spectrum.window_frames(), mean_buf);
+            min_dist = score_rows(mean_buf.data(), 1);
+            stage_profiler.end(STAGE_DISTANCE, _t_distance);
+        } else {
+            // one DFT window of the zero padded flow, scored like any partial flow
+            const uint64_t _t_transform = StageProfiler::begin();
+            const torch::Tensor ten_res = frequency_transform(
+                    encode_padded_flow(state, p_analyzer_conf->n_fft), p_analyzer_conf->n_fft);
+            stage_profiler.end(STAGE_TRANSFORM, _t_transform);
+
+            const uint64_t _t_distance = StageProfiler::begin();
+            const torch::Tensor _means = window_means(ten_res, p_analyzer_conf->mean_win_test).contiguous();
+            min_dist = score_rows(_means.data_ptr<float>(), _means.size(0));
+            stage_profiler.end(STAGE_DISTANCE, _t_distance);
         }
 
-        // Delete flow from mp
-        iter_mp = mp.erase(iter_mp);
+        // the verdict waited for the timeout, not for a packet: no detection latency sample
+        emit_result(e.key, min_dist, unreported, state.sample_num, true, 0);
+        expired_fallback_num ++;
+        mp.erase(it);
+    });
+}
+
+void AnalyzerWorkerThread::add_coarse_packets(uint32_t key, const PktMetadata * raw_data, size_t k) {
+    auto & state = coarse_flows[(size_t) ((key * 0x9e3779b97f4a7c15ull) >> 32) % coarse_flows.size()];
+    const uint32_t * p_index = batch_groups.index.data() + batch_groups.offset[k];
+    for (size_t i = 0; i < batch_groups.count[k]; i ++) {
+        const auto & info = raw_data[p_index[i]];
+        state.values.push_back(weight_transform(info));
+        state.last_ts = max(state.last_ts, info.ts);
     }
+    state.packet_num += batch_groups.count[k];
+    coarse_pkt_num += batch_groups.count[k];
+    flow_sampler.apply(state, false);
 }
 
-// 2020.12.8
-auto inline AnalyzerWorkerThread::weight_transform(const PktMetadata & info) -> double_t {
-     return info.length * 10 + info.proto / 10 + -log2(info.ts) * 15.68;
+void AnalyzerWorkerThread::score_coarse_flows(bool final_pass) {
+    const size_t min_len = (final_pass ? 1 : 2) * p_analyzer_conf->n_fft;
+    // the bucket keeps its buffer for the next aggregate
+    const auto reset = [] (FlowState & state) -> void {
+        state.values.clear();
+        state.reported_num = state.packet_num;
+        state.sample_num = 0;
+        state.sample_stride = 1;
+        state.sample_skip = 0;
+    };
+    for (size_t b = 0; b < coarse_flows.size(); b ++) {
+        auto & state = coarse_flows[b];
+        // the learner only sees the traffic of single sources
+        if (m_is_train) {
+            reset(state);
+            continue;
+        }
+        // a segment per batch like the flows, every scorable one in the final pass
+        while (state.values.size() >= min_len) {
+            const size_t len = flow_sampler.verdict_len(state);
+
+            const uint64_t _t_transform = StageProfiler::begin();
+            const torch::Tensor ten_res = frequency_transform(encode_flow(state, len), p_analyzer_conf->n_fft);
+            stage_profiler.end(STAGE_TRANSFORM, _t_transform);
+
+            const uint64_t _t_distance = StageProfiler::begin();
+            const torch::Tensor _means = window_means(ten_res, p_analyzer_conf->mean_win_test).contiguous();
+            const double_t min_dist = score_rows(_means.data_ptr<float>(), _means.size(0));
+            stage_profiler.end(STAGE_DISTANCE, _t_distance);
+
+            emit_coarse_result(b, min_dist, flow_sampler.verdict_packets(state, len), len);
+            if (len == state.values.size()) {
+                reset(state);
+                break;
+            }
+            flow_sampler.cut(state, len);
+            if (!final_pass) {
+                break;
+            }
+        }
+    }
+}
+
+void AnalyzerWorkerThread::emit_coarse_result(uint32_t bucket, double_t distance,
+                                              size_t packet_num, size_t sample_num) {
+    coarse_verdict_num ++;
+    if (!p_analyzer_conf->save_to_file || p_result_writer == nullptr) {
+        return;
+    }
+    ResultRecord r;
+    r.address = bucket;
+    r.flags = make_result_flags(false, packet_num, sample_num) | (uint32_t) RESULT_FLAG_AGGREGATE;
+    r.distance = distance;
+    r.packet_num = packet_num;
+    r.ts = __get_double_ts();
+    p_result_writer->push(r);
+}
+
+void AnalyzerWorkerThread::next_segment(unordered_map<uint32_t, FlowState>::iterator iter_mp,
+                                        size_t verdict_len, bool final_pass) {
+    auto & state = iter_mp->second;
+    if (verdict_len == state.values.size()) {
+        mp.erase(iter_mp);
+        return;
+    }
+    flow_sampler.cut(state, verdict_len);
+    // the final pass takes every segment that can be scored, the others take the next
+    // one in the next batch, or wait for more packets
+    const size_t min_len = (final_pass ? 1 : 2) * p_analyzer_conf->n_fft;
+    if (state.values.size() < min_len) {
+        state.queued = false;
+    } else {
+        (final_pass ? ready_flows : carried_flows).push_back(iter_mp->first);
+    }
+}
+
+void AnalyzerWorkerThread::execute_flow_task(FlowTask & t) {
+    const torch::Tensor ten = torch::from_blob(t.values.data(), {(int64_t) t.values.size()},
+                                               torch::dtype(torch::kFloat32));
+
+    const uint64_t _t_transform = StageProfiler::begin();
+    const torch::Tensor ten_res = frequency_transform(ten, p_analyzer_conf->n_fft);
+    stage_profiler.end(STAGE_TRANSFORM, _t_transform);
+
+    const uint64_t _t_distance = StageProfiler::begin();
+    const torch::Tensor _means = window_means(ten_res, p_analyzer_conf->mean_win_test).contiguous();
+    t.distance = t.p_centers->max_nearest(_means.data_ptr<float>(), _means.size(0), max_cluster_dist);
+    if (t.p_centers->has_reference()) {
+        t.reference = t.p_centers->max_nearest_reference(_means.data_ptr<float>(), _means.size(0),
+                                                         max_cluster_dist);
+    }
+    stage_profiler.end(STAGE_DISTANCE, _t_distance);
+
+    // the packets are not needed on the way back
+    t.sample_num = t.values.size();
+    vector<float>().swap(t.values);
+}
+
+void AnalyzerWorkerThread::run_flow_tasks(bool wait_stolen) {
+    FlowTask t;
+    while (p_task_pool->pop(m_shard_id, t)) {
+        execute_flow_task(t);
+        p_task_pool->complete(m_shard_id, std::move(t));
+    }
+    collect_flow_tasks();
+    // the final pass waits for the tasks still running on other analyzers
+    while (wait_stolen && p_task_pool->outstanding(m_shard_id) != 0) {
+        usleep(100);
+        collect_flow_tasks();
+    }
+}
+
+void AnalyzerWorkerThread::steal_flow_tasks() {
+    FlowTask t;
+    size_t victim;
+    for (size_t i = 0; i < p_analyzer_conf->steal_batch && p_task_pool->steal(m_shard_id, t, victim); i ++) {
+        execute_flow_task(t);
+        p_task_pool->complete(victim, std::move(t));
+        stolen_task_num ++;
+    }
+}
+
+void AnalyzerWorkerThread::collect_flow_tasks() {
+    done_tasks.clear();
+    p_task_pool->collect(m_shard_id, done_tasks);
+    for (const auto & t: done_tasks) {
+        if (t.reference >= 0) {
+            center_validation.add(t.distance, t.reference, p_analyzer_conf->center_validation_threshold);
+        }
+        if (p_analyzer_conf->ip_verbose && p_analyzer_conf->verbose_ip_target.length() != 0 &&
+            pcpp::IPv4Address(htonl(t.address)) == pcpp::IPv4Address(p_analyzer_conf->verbose_ip_target)) {
+            ALOGF("Analyzer on core # %2d: %6ld abnormal packets, with loss: %6.3lf",
+                  getCoreId(), t.packet_num, t.distance);
+        }
+        emit_result(t.address, t.distance, t.packet_num, t.sample_num, t.partial, t.last_ts);
+    }
+}
+
+auto AnalyzerWorkerThread::score_rows(const float * rows, size_t n) -> double_t {
+    const double_t dist = center_store.max_nearest(rows, n, max_cluster_dist);
+    if (center_store.has_reference()) {
+        center_validation.add(dist, center_store.max_nearest_reference(rows, n, max_cluster_dist),
+                              p_analyzer_conf->center_validation_threshold);
+    }
+    return dist;
+}
+
+void AnalyzerWorkerThread::feed_spectrum(FlowState & state) {
+    if (state.values.empty()) {
+        return;
+    }
+    state.spectrum.push(*p_spectrum_plan, state.values.data(), state.values.size(),
+                        [this, &state] (const vector<float> & sum, size_t frames) -> void {
+        spectrum_mean(sum, frames, mean_buf);
+        state.pending_dist = max(state.pending_dist, score_rows(mean_buf.data(), 1));
+    });
+    state.values.clear();
+    // flows from the training phase held every packet
+    if (state.values.capacity() > 2 * p_analyzer_conf->n_fft) {
+        state.values.shrink_to_fit();
+    }
+}
+
+void AnalyzerWorkerThread::spectrum_verdict(uint32_t key, FlowState & state) {
+    const uint64_t _t_distance = StageProfiler::begin();
+    feed_spectrum(state);
+    double_t min_dist = state.pending_dist;
+    // the first verdict and the final pass take the window in progress
+    if (min_dist < 0 && state.spectrum.window_frames() > 0) {
+        spectrum_mean(state.spectrum.window_sum(), state.spectrum.window_frames(), mean_buf);
+        min_dist = score_rows(mean_buf.data(), 1);
+    }
+    stage_profiler.end(STAGE_DISTANCE, _t_distance);
+
+    if (min_dist >= 0 && state.packet_num > state.reported_num) {
+        if (p_analyzer_conf->ip_verbose && p_analyzer_conf->verbose_ip_target.length() != 0 &&
+            pcpp::IPv4Address(htonl(key)) == pcpp::IPv4Address(p_analyzer_conf->verbose_ip_target)) {
+            ALOGF("Analyzer on core # %2d: %6ld abnormal packets, with loss: %6.3lf",
+                  getCoreId(), state.packet_num - state.reported_num, min_dist);
+        }
+        emit_result(key, min_dist, state.packet_num - state.reported_num, state.sample_num,
+                    state.packet_num < 2 * p_analyzer_conf->n_fft, state.last_ts);
+        state.reported_num = state.packet_num;
+        state.sample_num = 0;
+    }
+    state.pending_dist = -1;
+    state.queued = false;
+}
+
+auto AnalyzerWorkerThread::flow_table_report() const -> string {
+    size_t value_bytes = 0;
+    for (const auto & ref: mp) {
+        value_bytes += ref.second.values.capacity() * sizeof(float) + ref.second.spectrum.memory_bytes();
+    }
+    for (const auto & state: coarse_flows) {
+        value_bytes += state.values.capacity() * sizeof(float);
+    }
+    // a node per flow with its cached hash, and the bucket array
+    const size_t map_bytes = mp.size() * (sizeof(decltype(mp)::value_type) + 2 * sizeof(void *))
+                           + mp.bucket_count() * sizeof(void *);
+    const size_t queue_bytes = (ready_flows.capacity() + carried_flows.capacity()) * sizeof(uint32_t);
+
+    char buf[384];
+    snprintf(buf, sizeof(buf),
+             "%lu live (peak %lu), %lu timers, expired %lu (%lu dropped / %lu fallback), %lu sampled verdicts, "
+             "%lu packets of light sources in %lu coarse verdicts, "
+             "memory: map %.2lfMB, flow buffers %.2lfMB, ready queue %.2lfMB, timers %.2lfMB, sketch %.2lfMB",
+             mp.size(), peak_flow_num, flow_timers.size(),
+             expired_flow_num, expired_drop_num, expired_fallback_num, sampled_verdict_num,
+             coarse_pkt_num, coarse_verdict_num,
+             map_bytes / 1048576.0, value_bytes / 1048576.0, queue_bytes / 1048576.0,
+             flow_timers.memory_bytes() / 1048576.0, admission_sketch.memory_bytes() / 1048576.0);
+    return buf;
 }
 
 auto AnalyzerWorkerThread::get_overall_performance() const -> pair<double_t, double_t> {
@@ -417,6 +877,71 @@ auto AnalyzerWorkerThread::get_overall_performance() const -> pair<double_t, dou
     };
 }
 
+void AnalyzerWorkerThread::merge_accuracy(AccuracySnapshot & window, AccuracySnapshot & total) {
+    accuracy_monitor.merge_window_into(window, __get_double_ts());
+    accuracy_monitor.merge_total_into(total);
+}
+
+void AnalyzerWorkerThread::emit_result(uint32_t address, double_t distance, size_t packet_num,
+                                       size_t sample_num, bool partial, double_t completion_ts) {
+    const double_t ts = __get_double_ts();
+    const uint32_t flags = make_result_flags(partial, packet_num, sample_num);
+    if (flags & RESULT_FLAG_SAMPLED) {
+        sampled_verdict_num ++;
+    }
+
+    if (completion_ts > 0) {
+        latency_tracker.record_verdict(completion_ts, ts);
+    }
+
+    accuracy_monitor.record(address, distance, packet_num, ts);
+
+    if (p_verdict_table != nullptr) {
+        p_verdict_table->update(address, distance, packet_num, ts, flags);
+    }
+
+    if (!p_analyzer_conf->save_to_file) {
+        return;
+    }
+
+    if (p_result_writer != nullptr) {
+        ResultRecord r;
+        r.address = address;
+        r.flags = flags;
+        r.distance = distance;
+        r.packet_num = packet_num;
+        r.ts = ts;
+        p_result_writer->push(r);
+        return;
+    }
+
+    auto & buf_loc = flow_records[flow_record_size % result_buffer_size];
+    buf_loc = {.address = address,
+               .distence = distance,
+               .packet_num = packet_num,
+               .partial = partial,
+               .sample_num = sample_num};
+    ++ flow_record_size;
+}
+
+auto AnalyzerWorkerThread::flush_results() -> bool {
+    if (!p_analyzer_conf->save_to_file) {
+        return true;
+    }
+    if (p_result_writer != nullptr) {
+        p_result_writer->stop();
+        printf("Analyzer on core # %d: %lu results streamed to %s%s_%d_*%s.\n",
+               (int) getCoreId(), p_result_writer->get_written_num(),
+               p_analyzer_conf->save_dir.c_str(), p_analyzer_conf->save_file_prefix.c_str(),
+               (int) getCoreId(), RESULT_FILE_SUFFIX);
+        return p_result_writer->get_drop_num() == 0;
+    }
+    if (flow_records == nullptr) {
+        return false;
+    }
+    return save_res_json();
+}
+
 auto AnalyzerWorkerThread::save_res_json() const -> bool {
 	if (access(p_analyzer_conf->save_dir.c_str(), 0) == -1) {
         system(("mkdir " + p_analyzer_conf->save_dir).c_str());
@@ -435,6 +960,8 @@ auto AnalyzerWorkerThread::save_res_json() const -> bool {
         _j.push_back(flow_records[i].address);
         _j.push_back(flow_records[i].distence);
         _j.push_back(flow_records[i].packet_num);
+        _j.push_back(flow_records[i].partial);
+        _j.push_back(flow_records[i].sample_num);
         j_array.push_back(_j);
     }
 
@@ -508,9 +1035,198 @@ auto AnalyzerWorkerThread::configure_via_json(const json & jin) -> bool {
             p_analyzer_conf->speed_verbose =
                 static_cast<decltype(p_analyzer_conf->speed_verbose)>(jin["speed_verbose"]);
         }
-        if (jin.count("speed_verbose")) {
-            p_analyzer_conf->speed_verbose =
-                static_cast<decltype(p_analyzer_conf->speed_verbose)>(jin["speed_verbose"]);
+        if (jin.count("stage_verbose")) {
+            p_analyzer_conf->stage_verbose =
+                static_cast<decltype(p_analyzer_conf->stage_verbose)>(jin["stage_verbose"]);
+        }
+        if (jin.count("stage_report_file")) {
+            p_analyzer_conf->stage_report_file =
+                static_cast<decltype(p_analyzer_conf->stage_report_file)>(jin["stage_report_file"]);
+        }
+        if (jin.count("stage_profile")) {
+            p_analyzer_conf->stage_profile =
+                static_cast<decltype(p_analyzer_conf->stage_profile)>(jin["stage_profile"]);
+            StageProfiler::set_enabled(p_analyzer_conf->stage_profile);
+        }
+
+        // detection latency
+        auto & _dl = p_analyzer_conf->detection_latency;
+        if (jin.count("switch_ts_unit")) {
+            _dl.switch_ts_unit = static_cast<decltype(_dl.switch_ts_unit)>(jin["switch_ts_unit"]);
+            if (_dl.switch_ts_unit <= 0) {
+                throw logic_error("Parse error Json tag: switch_ts_unit\n");
+            }
+        }
+        if (jin.count("clock_calibration")) {
+            const string _s = static_cast<string>(jin["clock_calibration"]);
+            if (clock_calibration_map.find(_s) == clock_calibration_map.end()) {
+                throw logic_error("Parse error Json tag: clock_calibration (none|fixed|min)\n");
+            }
+            _dl.calibration = clock_calibration_map.at(_s);
+        }
+        if (jin.count("clock_offset")) {
+            _dl.clock_offset = static_cast<decltype(_dl.clock_offset)>(jin["clock_offset"]);
+        }
+        if (jin.count("clock_calibration_window")) {
+            _dl.calibration_window =
+                static_cast<decltype(_dl.calibration_window)>(jin["clock_calibration_window"]);
+        }
+        if (jin.count("latency_slo_ms")) {
+            _dl.slo_ms = static_cast<decltype(_dl.slo_ms)>(jin["latency_slo_ms"]);
+        }
+        latency_tracker.configure(_dl);
+        if (jin.count("latency_slo_budget")) {
+            p_analyzer_conf->latency_slo_budget =
+                static_cast<decltype(p_analyzer_conf->latency_slo_budget)>(jin["latency_slo_budget"]);
+            if (p_analyzer_conf->latency_slo_budget < 0 || p_analyzer_conf->latency_slo_budget > 1) {
+                throw logic_error("Parse error Json tag: latency_slo_budget\n");
+            }
+        }
+        if (jin.count("latency_verbose")) {
+            p_analyzer_conf->latency_verbose =
+                static_cast<decltype(p_analyzer_conf->latency_verbose)>(jin["latency_verbose"]);
+        }
+        if (jin.count("latency_report_file")) {
+            p_analyzer_conf->latency_report_file =
+                static_cast<decltype(p_analyzer_conf->latency_report_file)>(jin["latency_report_file"]);
+        }
+
+        // precision of the centers in the distance stage, and its check against double
+        if (jin.count("center_precision")) {
+            const string _s = static_cast<string>(jin["center_precision"]);
+            if (center_precision_map.find(_s) == center_precision_map.end()) {
+                throw logic_error("Parse error Json tag: center_precision (fp32|bf16|int8)\n");
+            }
+            p_analyzer_conf->center_precision = center_precision_map.at(_s);
+        }
+        if (jin.count("center_validation")) {
+            p_analyzer_conf->center_validation =
+                static_cast<decltype(p_analyzer_conf->center_validation)>(jin["center_validation"]);
+        }
+        if (jin.count("center_validation_threshold")) {
+            p_analyzer_conf->center_validation_threshold =
+                static_cast<decltype(p_analyzer_conf->center_validation_threshold)>(jin["center_validation_threshold"]);
+        }
+        // ready flows of the batch STFT path as tasks other analyzers may take
+        if (jin.count("work_stealing")) {
+            p_analyzer_conf->work_stealing =
+                static_cast<decltype(p_analyzer_conf->work_stealing)>(jin["work_stealing"]);
+        }
+        if (jin.count("steal_batch")) {
+            p_analyzer_conf->steal_batch =
+                static_cast<decltype(p_analyzer_conf->steal_batch)>(jin["steal_batch"]);
+            if (p_analyzer_conf->steal_batch == 0) {
+                throw logic_error("Parse error Json tag: steal_batch\n");
+            }
+        }
+        if (jin.count("incremental_dft")) {
+            p_analyzer_conf->incremental_dft =
+                static_cast<decltype(p_analyzer_conf->incremental_dft)>(jin["incremental_dft"]);
+        }
+
+        // idle expiry of the flows that do not reach the analysis length
+        if (jin.count("flow_idle_timeout")) {
+            p_analyzer_conf->flow_idle_timeout =
+                static_cast<decltype(p_analyzer_conf->flow_idle_timeout)>(jin["flow_idle_timeout"]);
+            if (p_analyzer_conf->flow_idle_timeout < 0) {
+                throw logic_error("Parse error Json tag: flow_idle_timeout\n");
+            }
+        }
+        if (jin.count("flow_timer_tick")) {
+            p_analyzer_conf->flow_timer_tick =
+                static_cast<decltype(p_analyzer_conf->flow_timer_tick)>(jin["flow_timer_tick"]);
+            if (p_analyzer_conf->flow_timer_tick <= 0) {
+                throw logic_error("Parse error Json tag: flow_timer_tick\n");
+            }
+        }
+        if (jin.count("flow_expiry_policy")) {
+            const string _s = static_cast<string>(jin["flow_expiry_policy"]);
+            if (flow_expiry_map.find(_s) == flow_expiry_map.end()) {
+                throw logic_error("Parse error Json tag: flow_expiry_policy (drop|fallback)\n");
+            }
+            p_analyzer_conf->flow_expiry = flow_expiry_map.at(_s);
+        }
+        if (jin.count("flow_sample_cap")) {
+            p_analyzer_conf->flow_sample_cap =
+                static_cast<decltype(p_analyzer_conf->flow_sample_cap)>(jin["flow_sample_cap"]);
+        }
+        if (jin.count("flow_sampling")) {
+            const string _s = static_cast<string>(jin["flow_sampling"]);
+            if (flow_sampling_map.find(_s) == flow_sampling_map.end()) {
+                throw logic_error("Parse error Json tag: flow_sampling (systematic|reservoir|segment)\n");
+            }
+            p_analyzer_conf->flow_sampling = flow_sampling_map.at(_s);
+        }
+        if (jin.count("admission_rate")) {
+            p_analyzer_conf->admission_rate =
+                static_cast<decltype(p_analyzer_conf->admission_rate)>(jin["admission_rate"]);
+        }
+        if (jin.count("admission_window")) {
+            p_analyzer_conf->admission_window =
+                static_cast<decltype(p_analyzer_conf->admission_window)>(jin["admission_window"]);
+            if (p_analyzer_conf->admission_window <= 0) {
+                throw logic_error("Parse error Json tag: admission_window\n");
+            }
+        }
+        if (jin.count("admission_sketch_width")) {
+            p_analyzer_conf->admission_sketch_width =
+                static_cast<decltype(p_analyzer_conf->admission_sketch_width)>(jin["admission_sketch_width"]);
+            if (p_analyzer_conf->admission_sketch_width == 0) {
+                throw logic_error("Parse error Json tag: admission_sketch_width\n");
+            }
+        }
+        if (jin.count("coarse_buckets")) {
+            p_analyzer_conf->coarse_buckets =
+                static_cast<decltype(p_analyzer_conf->coarse_buckets)>(jin["coarse_buckets"]);
+            if (p_analyzer_conf->coarse_buckets == 0) {
+                throw logic_error("Parse error Json tag: coarse_buckets\n");
+            }
+        }
+        if (jin.count("fallback_min_packets")) {
+            p_analyzer_conf->fallback_min_packets =
+                static_cast<decltype(p_analyzer_conf->fallback_min_packets)>(jin["fallback_min_packets"]);
+        }
+        if (jin.count("flow_verbose")) {
+            p_analyzer_conf->flow_verbose =
+                static_cast<decltype(p_analyzer_conf->flow_verbose)>(jin["flow_verbose"]);
+        }
+
+        // online accuracy against labeled addresses
+        auto & _am = p_analyzer_conf->accuracy_monitor;
+        if (jin.count("label_file")) {
+            _am.label_file = static_cast<decltype(_am.label_file)>(jin["label_file"]);
+        }
+        if (jin.count("label_tag")) {
+            _am.label_tag = static_cast<decltype(_am.label_tag)>(jin["label_tag"]);
+        }
+        if (jin.count("accuracy_window")) {
+            _am.window = static_cast<decltype(_am.window)>(jin["accuracy_window"]);
+            if (_am.window <= 0) {
+                throw logic_error("Parse error Json tag: accuracy_window\n");
+            }
+        }
+        if (jin.count("accuracy_window_slots")) {
+            _am.window_slots = static_cast<decltype(_am.window_slots)>(jin["accuracy_window_slots"]);
+        }
+        if (jin.count("accuracy_score_bins")) {
+            _am.score_bins = static_cast<decltype(_am.score_bins)>(jin["accuracy_score_bins"]);
+        }
+        if (jin.count("accuracy_max_score")) {
+            _am.max_score = static_cast<decltype(_am.max_score)>(jin["accuracy_max_score"]);
+        }
+        if (jin.count("accuracy_threshold")) {
+            _am.threshold = static_cast<decltype(_am.threshold)>(jin["accuracy_threshold"]);
+        }
+        if (jin.count("accuracy_at_fpr")) {
+            _am.at_fpr = static_cast<decltype(_am.at_fpr)>(jin["accuracy_at_fpr"]);
+        }
+        if (jin.count("accuracy_verbose")) {
+            p_analyzer_conf->accuracy_verbose =
+                static_cast<decltype(p_analyzer_conf->accuracy_verbose)>(jin["accuracy_verbose"]);
+        }
+        if (jin.count("accuracy_report_file")) {
+            p_analyzer_conf->accuracy_report_file =
+                static_cast<decltype(p_analyzer_conf->accuracy_report_file)>(jin["accuracy_report_file"]);
         }
         if (jin.count("verbose_interval")) {
             p_analyzer_conf->verbose_interval =
@@ -551,6 +1267,29 @@ auto AnalyzerWorkerThread::configure_via_json(const json & jin) -> bool {
             p_analyzer_conf->save_file_prefix =
                 static_cast<decltype(p_analyzer_conf->save_file_prefix)>(jin["save_file_prefix"]);
         }
+        if (jin.count("save_format")) {
+            const string _format = jin["save_format"];
+            if (_format == "binary") {
+                p_analyzer_conf->save_binary = true;
+            } else if (_format == "json") {
+                p_analyzer_conf->save_binary = false;
+            } else {
+                WARNF("Unknown result format: %s", _format.c_str());
+                throw logic_error("Parse error Json tag: save_format\n");
+            }
+        }
+        if (jin.count("result_fsync_interval")) {
+            p_analyzer_conf->result_fsync_interval =
+                static_cast<decltype(p_analyzer_conf->result_fsync_interval)>(jin["result_fsync_interval"]);
+        }
+        if (jin.count("result_rotate_size")) {
+            p_analyzer_conf->result_rotate_size =
+                static_cast<decltype(p_analyzer_conf->result_rotate_size)>(jin["result_rotate_size"]);
+        }
+        if (jin.count("result_rotate_interval")) {
+            p_analyzer_conf->result_rotate_interval =
+                static_cast<decltype(p_analyzer_conf->result_rotate_interval)>(jin["result_rotate_interval"]);
+        }
 
         //basic behavior parameters
         if (jin.count("pause_time")) {
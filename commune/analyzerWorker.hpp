@@ -2,6 +2,19 @@
 
 #include "../common.hpp"
 #include "dpdkCommon.hpp"
+#include "asyncLogger.hpp"
+#include "socketAlloc.hpp"
+#include "overloadPolicy.hpp"
+#include "resultWriter.hpp"
+#include "verdictTable.hpp"
+#include "stageProfiler.hpp"
+#include "detectionLatency.hpp"
+#include "accuracyMonitor.hpp"
+#include "flowTimerWheel.hpp"
+#include "flowTaskPool.hpp"
+#include "flowSampler.hpp"
+#include "heavyHitterSketch.hpp"
+#include "waveKernels.hpp"
 #include "parserWorker.hpp"
 #include "kMeansLearner.hpp"
 
@@ -14,10 +27,56 @@ class ParserWorkerThread;
 class KMeansLearner;
 class DeviceConfig;
 
+// What an idle flow that never reached the analysis length turns into
+using flow_expiry_t = uint8_t;
+enum flow_expiry : flow_expiry_t {
+    // dropped, only counted
+    FLOW_EXPIRY_DROP     = 0,
+    // scored on its zero padded spectrum, reported as a partial verdict
+    FLOW_EXPIRY_FALLBACK = 1
+};
+
+static const map<string, flow_expiry_t> flow_expiry_map = {
+    {"drop",     FLOW_EXPIRY_DROP},
+    {"fallback", FLOW_EXPIRY_FALLBACK}
+};
+
 struct AnalyzerConfigParam final {
 
     // Number of fft
     size_t n_fft = 50;
+    // Testing mode: transform every flow as its packets arrive and keep it for a verdict
+    // per window of mean_win_test frames, instead of one STFT of the whole flow
+    bool incremental_dft = false;
+    // Batch STFT path: ready flows become tasks that idle analyzers take from the busy ones
+    bool work_stealing = false;
+    // Tasks taken per idle loop
+    size_t steal_batch = 4;
+    // Storage of the centers in the distance stage
+    center_precision_t center_precision = CENTER_FP32;
+    // Also score every verdict against the double centers and report the deviation
+    bool center_validation = false;
+    // Distance at which center validation counts a verdict flip
+    double_t center_validation_threshold = 6.0;
+    // Flows without packets for this long (s) expire, 0 keeps them until shutdown
+    double_t flow_idle_timeout = 0;
+    // Granularity of the idle timer (s)
+    double_t flow_timer_tick = 1.0;
+    flow_expiry_t flow_expiry = FLOW_EXPIRY_FALLBACK;
+    // Expired flows with fewer packets are dropped even with the fallback
+    size_t fallback_min_packets = 2;
+    // Samples a flow holds for one verdict, at least 2 * n_fft, 0 for no cap
+    size_t flow_sample_cap = 0;
+    flow_sampling_t flow_sampling = FLOW_SAMPLING_SYSTEMATIC;
+    // Sources below this rate (packets/s) get no flow state, only sketch counters and the
+    // coarse verdict of their bucket; 0 admits every source
+    double_t admission_rate = 0;
+    // Window of the rate estimate (s)
+    double_t admission_window = 1.0;
+    // Counters per row of the sketch, rounded up to a power of two
+    size_t admission_sketch_width = 1 << 16;
+    // Aggregates of the sources turned down
+    size_t coarse_buckets = 64;
 
     // Mean Window Train
     size_t mean_win_train = 50;
@@ -32,6 +91,12 @@ struct AnalyzerConfigParam final {
     string save_dir = "";
     // File tag
     string save_file_prefix = "";
+    // "binary": streamed by a ResultWriter, "json": legacy dump at shutdown
+    bool save_binary = true;
+    // Binary writer: fsync period (s), rotation size (MB) and age (s, 0 disables)
+    double_t result_fsync_interval = 1.0;
+    size_t result_rotate_size = 256;
+    double_t result_rotate_interval = 0;
 
     // Verbose configure
     double_t verbose_interval = 5.0;
@@ -39,6 +104,25 @@ struct AnalyzerConfigParam final {
     bool mode_verbose = false;
     bool center_verbose = false;
     bool speed_verbose = false;
+    // Flow table size, expiries and memory
+    bool flow_verbose = false;
+    // Stage latency histograms: record from start (toggle with SIGUSR1), print per interval
+    bool stage_profile = false;
+    bool stage_verbose = false;
+    // Merged stage percentiles written at shutdown (json), empty to skip
+    string stage_report_file = "";
+    // Wire-to-verdict latency: switch clock, calibration and objective
+    DetectionLatencyParam detection_latency;
+    // Allowed fraction of verdicts above the objective
+    double_t latency_slo_budget = 0.01;
+    bool latency_verbose = false;
+    // Per-analyzer and merged detection latency written at shutdown (json), empty to skip
+    string latency_report_file = "";
+    // Live accuracy against labeled addresses, disabled without a label file
+    AccuracyMonitorParam accuracy_monitor;
+    bool accuracy_verbose = false;
+    // Whole run and last window accuracy written at shutdown (json), empty to skip
+    string accuracy_report_file = "";
     bool ip_verbose = false;
     string verbose_ip_target = "";
     cpu_core_id_t verbose_center_core = 10;
@@ -51,12 +135,57 @@ struct AnalyzerConfigParam final {
         mean_win_train, mean_win_test, num_train_sample);
 
         printf("Frequency domain analysis realated param:\n");
-        printf("FFT component size: %ld\n", n_fft);
+        printf("FFT component size: %ld, Incremental: %s\n", n_fft, incremental_dft ? "yes" : "no");
+        printf("Center precision: %s", center_precision_name(center_precision));
+        if (center_validation) {
+            printf(", validated against double (flips at %4.2lf)", center_validation_threshold);
+        }
+        printf("\n");
+        if (work_stealing) {
+            printf("Work stealing: up to %ld flow tasks per idle loop%s\n", steal_batch,
+            incremental_dft ? " (off: incremental DFT)" : "");
+        }
+        if (flow_sample_cap > 0) {
+            printf("Flow sample cap: %ld, sampling: %s\n", flow_sample_cap, flow_sampling_name(flow_sampling));
+        }
+        if (admission_rate > 0) {
+            printf("Flow admission: %4.2lf pkt/s over %4.2lfs, sketch width %ld, coarse buckets %ld\n",
+            admission_rate, admission_window, admission_sketch_width, coarse_buckets);
+        }
+        if (flow_idle_timeout > 0) {
+            printf("Flow idle timeout: %4.2lfs (tick %4.2lfs), on expiry: %s\n", flow_idle_timeout, flow_timer_tick,
+            flow_expiry == FLOW_EXPIRY_FALLBACK ? "fallback verdict" : "drop");
+        }
 
         if (save_to_file) {
             printf("Saving related param:\n");
-            printf("Saving DIR: %s, Saving prefix: %s\n",
-            save_dir.c_str(), save_file_prefix.c_str());
+            printf("Saving DIR: %s, Saving prefix: %s, Format: %s\n",
+            save_dir.c_str(), save_file_prefix.c_str(), save_binary ? "binary" : "json");
+            if (save_binary) {
+                printf("Fsync interval: %4.2lfs, Rotate size: %ldMB, Rotate interval: %4.2lfs\n",
+                result_fsync_interval, result_rotate_size, result_rotate_interval);
+            }
+        }
+
+        printf("Detection latency: switch tick %.3les, calibration: %s",
+        detection_latency.switch_ts_unit,
+        detection_latency.calibration == CLOCK_CALIB_MIN ? "min" :
+        (detection_latency.calibration == CLOCK_CALIB_FIXED ? "fixed" : "none"));
+        if (detection_latency.calibration == CLOCK_CALIB_FIXED) {
+            printf(" (offset %.6lfs)", detection_latency.clock_offset);
+        } else if (detection_latency.calibration == CLOCK_CALIB_MIN) {
+            printf(" (window %4.2lfs)", detection_latency.calibration_window);
+        }
+        if (detection_latency.slo_ms > 0) {
+            printf(", SLO: %4.2lfms for %4.2lf%% of verdicts", detection_latency.slo_ms,
+            100.0 * (1 - latency_slo_budget));
+        }
+        printf("\n");
+
+        if (accuracy_monitor.label_file.length()) {
+            printf("Accuracy monitor: labels %s (tag %s), window %4.2lfs in %ld slots, threshold %4.2lf\n",
+            accuracy_monitor.label_file.c_str(), accuracy_monitor.label_tag.c_str(),
+            accuracy_monitor.window, accuracy_monitor.window_slots, accuracy_monitor.threshold);
         }
 
         stringstream ss;
@@ -65,6 +194,10 @@ struct AnalyzerConfigParam final {
         if (mode_verbose) ss << "Mode,";
         if (center_verbose) ss << "Center,";
         if (speed_verbose) ss << "Speed,";
+        if (flow_verbose) ss << "Flow,";
+        if (stage_verbose) ss << "Stage,";
+        if (latency_verbose) ss << "Latency,";
+        if (accuracy_verbose) ss << "Accuracy,";
         if (ip_verbose) ss << "IP: " << verbose_ip_target;
         ss << "}";
         printf("%s (Interval %4.2lfs)\n\n", ss.str().c_str(), verbose_interval);
@@ -82,10 +215,17 @@ class AnalyzerWorkerThread final : public pcpp::DpdkWorkerThread {
     private:
         // Indicator of stop
         volatile bool m_stop = false;
+        // Shutdown: empty the rings of the stopped parsers, then run the final pass
+        atomic<bool> m_drain;
+        atomic<bool> m_drained;
+        // Records fetched from the parsers since the start, read by other threads
+        atomic<uint64_t> fetched_num;
         // In training mode or testing mode
         bool m_is_train = true;
         // Core Id assigned by DPDK
         cpu_core_id_t m_core_id;
+        // Shard of the source address space owned by this analyzer
+        const size_t m_shard_id;
 
         int received_num = 0;
 
@@ -105,24 +245,54 @@ class AnalyzerWorkerThread final : public pcpp::DpdkWorkerThread {
         size_t meta_pkt_arr_size = 2000000;
         shared_ptr<PktMetadata[]> meta_pkt_arr;
 
-        // address aggregate
-        unordered_map<uint32_t, vector<size_t> > mp;
-
-        // #define DETAIL_TIME_ANALYZE
-        // #define __DETAIL_TIME_ANALYZE
-
-        #ifdef DETAIL_TIME_ANALYZE
-            double_t sum_weight_time = 0;
-            double_t sum_dist_time = 0;
-            double_t sum_transform_time = 0;
-            double_t sum_aggregate_time = 0;
-            #ifdef __DETAIL_TIME_ANALYZE
-                size_t analyze_entrance = 0;
-            #endif
-        #endif
+        // address aggregate: every batch is grouped, then appended to the state of its flows
+        BatchGrouper batch_grouper;
+        FlowGroups batch_groups;
+        unordered_map<uint32_t, FlowState> mp;
+        // Flows of mp long enough for the analysis, the only ones a batch looks at
+        vector<uint32_t> ready_flows;
+        // Flows with another segment to score in the next batch
+        vector<uint32_t> carried_flows;
+        FlowSampler flow_sampler;
+        uint64_t sampled_verdict_num = 0;
+        // Idle expiry of the flows of mp
+        FlowTimerWheel flow_timers;
+        // Twiddles of the incremental spectrum, null for the batch STFT
+        shared_ptr<const SpectrumPlan> p_spectrum_plan;
+        uint32_t flow_gen = 0;
+        // Expired flows, by outcome for those with packets not covered by a verdict,
+        // and the largest size of mp
+        uint64_t expired_flow_num = 0;
+        uint64_t expired_drop_num = 0;
+        uint64_t expired_fallback_num = 0;
+        size_t peak_flow_num = 0;
+        // Rate of every source, a new source gets a flow from admission_min packets per window
+        HeavyHitterSketch admission_sketch;
+        uint32_t admission_min = 0;
+        // Packets of the sources turned down, scored per bucket
+        vector<FlowState> coarse_flows;
+        uint64_t coarse_pkt_num = 0;
+        uint64_t coarse_verdict_num = 0;
+        // Sources holding state in mp, published to the overload guards of the parsers
+        const shared_ptr<TrackedSourceFilter> p_tracked_filter;
+
+        // Per-stage TSC latency histograms of this worker
+        StageProfiler stage_profiler;
+        // Switch timestamp of the last packet of a flow to verdict emission
+        DetectionLatencyTracker latency_tracker;
+        // Verdicts scored against the labeled addresses
+        AccuracyMonitor accuracy_monitor;
 
         // The result of train, i.e. the clustring centers
-        torch::Tensor centers;
+        CenterStore center_store;
+        CenterValidation center_validation;
+        // Window mean of an incremental spectrum
+        vector<float> mean_buf;
+
+        // Flow tasks shared by the analyzers, null without work stealing
+        shared_ptr<FlowTaskPool> p_task_pool;
+        vector<FlowTask> done_tasks;
+        uint64_t stolen_task_num = 0;
         // KMeans Learner
         shared_ptr<KMeansLearner> p_learner;
         // The registed ParserWorkers
@@ -135,31 +305,87 @@ class AnalyzerWorkerThread final : public pcpp::DpdkWorkerThread {
             uint32_t address;
             double distence;
             size_t packet_num;
+            // Scored at shutdown with fewer packets than a regular flow
+            bool partial;
+            // Packets analyzed, fewer than packet_num for a sampled flow
+            size_t sample_num;
         } FlowRecord;
 
-        // Memory to save results
+        // Memory to save results (json format only)
         #define MAX_RES_BUF_SIZE (1 << 24)
         size_t result_buffer_size = 500000;
         size_t flow_record_size = 0;
         shared_ptr<FlowRecord[]> flow_records;
 
+        // Streaming result output (binary format)
+        shared_ptr<ResultWriter> p_result_writer;
+        // Live per-source state for external readers, shared by all analyzers
+        shared_ptr<VerdictTable> p_verdict_table;
+
+        // Hand one verdict to the verdict table and the configured result output
+        void emit_result(uint32_t address, double_t distance, size_t packet_num, size_t sample_num,
+                         bool partial, double_t completion_ts);
+        // Clock offset sample from the records fetched since index begin
+        void calibrate_clock(size_t begin);
+
         const size_t max_fetch = 1 << 17;
+        const size_t min_fetch = 50;
+        // A ring below min_fetch is fetched anyway once it has waited this long (s)
+        const double_t max_fetch_wait = 0.1;
+        // Since when the ring of each parser holds records below min_fetch, 0 if not
+        vector<double_t> fetch_wait_since;
         const double_t max_cluster_dist = 1e12;
 
-        // Copy per-packet properties from registed ParserWorkers
-        auto fetch_from_parser(const shared_ptr<ParserWorkerThread> pt) const -> size_t;
-        // Extract Frequency Domain Representation from per-packet properties
-        void wave_analyze();
-        // Linear Tranformation of per-packet properties
-        auto static inline weight_transform(const PktMetadata & info) -> double_t;
+        // Copy per-packet properties of this shard from registed ParserWorkers
+        auto fetch_from_parser(const shared_ptr<ParserWorkerThread> pt, double_t & wait_since,
+                               double_t now) const -> size_t;
+        // Extract Frequency Domain Representation from per-packet properties,
+        // the final pass also scores the flows shorter than 2 * n_fft
+        void wave_analyze(bool final_pass = false);
+        // Fold a group of a source without a flow into the aggregate of its bucket
+        void add_coarse_packets(uint32_t key, const PktMetadata * raw_data, size_t k);
+        // Score the aggregates long enough for the analysis, any scorable one in the final pass
+        void score_coarse_flows(bool final_pass);
+        // Hand a coarse verdict to the binary result output, it has no source of its own
+        void emit_coarse_result(uint32_t bucket, double_t distance, size_t packet_num, size_t sample_num);
+        // Drop a flow after its verdict, or cut the segment and queue the next one
+        void next_segment(unordered_map<uint32_t, FlowState>::iterator iter_mp, size_t verdict_len,
+                          bool final_pass);
+        // Transform and distance of a task, on the thread of whichever analyzer runs it
+        void execute_flow_task(FlowTask & t);
+        // Own tasks, then their verdicts; the final pass also waits for the stolen ones
+        void run_flow_tasks(bool wait_stolen);
+        void steal_flow_tasks();
+        void collect_flow_tasks();
+        // Distance of the window means of a flow, checked against double under validation
+        auto score_rows(const float * rows, size_t n) -> double_t;
+        auto inline is_incremental() const -> bool {
+            return p_spectrum_plan != nullptr && !m_is_train;
+        }
+        // Move the pending packets of a flow into its spectrum, scoring the windows they complete
+        void feed_spectrum(FlowState & state);
+        // Verdict of the windows completed since the last one, or of the window in progress
+        void spectrum_verdict(uint32_t key, FlowState & state);
+        // Expire the flows of mp idle for flow_idle_timeout
+        void expire_idle_flows(double_t now);
+        // Flow count, expiries and the bytes held by mp, the ready queue and the timers
+        auto flow_table_report() const -> string;
 
     public:
         AnalyzerWorkerThread(const vector<shared_ptr<ParserWorkerThread> > & _vp,
-                             const shared_ptr<KMeansLearner> _pl) : p_parser(_vp), p_learner(_pl) {}
+                             const shared_ptr<KMeansLearner> _pl,
+                             size_t _shard = 0) :
+                                    m_drain(false), m_drained(false), fetched_num(0),
+                                    m_shard_id(_shard), p_tracked_filter(make_shared<TrackedSourceFilter>()),
+                                    p_learner(_pl), p_parser(_vp) {}
 
         AnalyzerWorkerThread(const vector<shared_ptr<ParserWorkerThread> > & _vp,
                              const shared_ptr<KMeansLearner> _pl,
-                             const json & _j) : p_parser(_vp), p_learner(_pl) {
+                             size_t _shard,
+                             const json & _j) :
+                                    m_drain(false), m_drained(false), fetched_num(0),
+                                    m_shard_id(_shard), p_tracked_filter(make_shared<TrackedSourceFilter>()),
+                                    p_learner(_pl), p_parser(_vp) {
                                     configure_via_json(_j);
                              }
 
@@ -181,7 +407,58 @@ class AnalyzerWorkerThread final : public pcpp::DpdkWorkerThread {
         // Save result to json file
         auto save_res_json() const -> bool;
 
+        void bind_verdict_table(const shared_ptr<VerdictTable> _p) {
+            p_verdict_table = _p;
+        }
+
+        // Labels of the accuracy monitor, loaded once and shared by all analyzers
+        void bind_label_set(const shared_ptr<const LabeledAddressSet> _p) {
+            accuracy_monitor.configure(p_analyzer_conf->accuracy_monitor, _p);
+        }
+
+        // The analyzer owns the deque of its shard index
+        void bind_task_pool(const shared_ptr<FlowTaskPool> _p) {
+            p_task_pool = _p;
+        }
+
+        // Shutdown step 2, call after every parser left its receive loop
+        void request_drain() {
+            m_drain.store(true, std::memory_order_release);
+        }
+
+        auto inline is_drained() const -> bool {
+            return m_drained.load(std::memory_order_acquire);
+        }
+
+        // Shutdown step 4, after the worker is joined
+        auto flush_results() -> bool;
+
         auto get_overall_performance() const -> pair<double_t, double_t>;
+
+        // Add the stage histograms of this worker to a merged view
+        void merge_stage_latency(vector<HistogramSnapshot> & snapshots) const {
+            stage_profiler.merge_into(snapshots);
+        }
+
+        // Add the detection latency histogram of this worker to a merged view
+        void merge_detection_latency(HistogramSnapshot & snap) const {
+            latency_tracker.merge_into(snap);
+        }
+
+        auto get_detection_latency_num() const -> pair<uint64_t, uint64_t> {
+            return {latency_tracker.get_verdict_num(), latency_tracker.get_slo_violation()};
+        }
+
+        // Labeled accuracy of the last window and of the whole run, after the worker is joined
+        void merge_accuracy(AccuracySnapshot & window, AccuracySnapshot & total);
+
+        auto inline get_fetched_num() const -> uint64_t {
+            return fetched_num.load(std::memory_order_relaxed);
+        }
+
+        auto inline get_tracked_filter() const -> shared_ptr<TrackedSourceFilter> {
+            return p_tracked_filter;
+        }
 };
 
 }
@@ -0,0 +1,219 @@
+#include "asyncLogger.hpp"
+
+#include <unistd.h>
+
+using namespace Whisper;
+
+atomic<log_level_t> AsyncLogger::runtime_level(LOG_LEVEL_INFO);
+
+auto AsyncLogger::local_ring() -> log_ring_t * {
+    thread_local shared_ptr<log_ring_t> p_local_ring = nullptr;
+    if (p_local_ring == nullptr) {
+        p_local_ring = make_shared<log_ring_t>(p_logger_config->ring_size);
+        std::lock_guard<std::mutex> _lock(ring_mutex);
+        ring_vec.push_back(p_local_ring);
+    }
+    return p_local_ring.get();
+}
+
+// Rebuild the printf result from the format string and the raw argument words
+void AsyncLogger::format_entry(const LogEntry & e, string & out) {
+    static const char * const _conversion = "diouxXcfFeEgGaAps";
+    char buf[128];
+
+    const LogSite * site = e.site;
+    const bool _is_warn = site->level >= LOG_LEVEL_WARN;
+
+    snprintf(buf, sizeof(buf), "%s[%s@%s:%d->%s() %.6lf]%s: ",
+             _is_warn ? HIGH_LIGHT_WARN : HIGH_LIGHT_LOG,
+             _is_warn ? "WARN_LOG" : "NORMAL_LOG",
+             site->file, site->line, site->func, e.ts, KNRM);
+    out.append(buf);
+
+    size_t arg_index = 0;
+    for (const char * p = site->fmt; *p != '\0'; p ++) {
+        if (*p != '%') {
+            out.push_back(*p);
+            continue;
+        }
+        if (*(p + 1) == '%') {
+            out.push_back('%');
+            p ++;
+            continue;
+        }
+
+        // collect flags, width and precision, drop the length modifiers
+        string spec = "%";
+        const char * q = p + 1;
+        while (*q != '\0' && strchr(_conversion, *q) == nullptr) {
+            if (strchr("hljztL", *q) == nullptr) {
+                spec.push_back(*q);
+            }
+            q ++;
+        }
+        if (*q == '\0') {
+            out.append(p);
+            break;
+        }
+
+        const char conv = *q;
+        const uint64_t raw = arg_index < e.n_arg ? e.args[arg_index] : 0;
+        ++ arg_index;
+
+        switch (conv) {
+            case 'd': case 'i':
+                spec += "lld";
+                snprintf(buf, sizeof(buf), spec.c_str(), (long long) (int64_t) raw);
+                break;
+            case 'o': case 'u': case 'x': case 'X':
+                spec += "ll";
+                spec.push_back(conv);
+                snprintf(buf, sizeof(buf), spec.c_str(), (unsigned long long) raw);
+                break;
+            case 'c':
+                spec.push_back(conv);
+                snprintf(buf, sizeof(buf), spec.c_str(), (int) raw);
+                break;
+            case 'p':
+                spec.push_back(conv);
+                snprintf(buf, sizeof(buf), spec.c_str(), (void *) (uintptr_t) raw);
+                break;
+            case 's':
+                // rejected at compile time by log_fmt_has_str
+                buf[0] = '\0';
+                break;
+            default: {
+                double_t d;
+                memcpy(&d, &raw, sizeof(d));
+                spec.push_back(conv);
+                snprintf(buf, sizeof(buf), spec.c_str(), d);
+                break;
+            }
+        }
+        out.append(buf);
+        p = q;
+    }
+    out.push_back('\n');
+}
+
+void AsyncLogger::write_entry(const LogEntry & e) {
+    string line;
+    format_entry(e, line);
+    fwrite(line.data(), 1, line.size(), p_out);
+}
+
+auto AsyncLogger::drain_once() -> size_t {
+    #define ASYNC_LOG_DRAIN_BURST 256
+    LogEntry _entries[ASYNC_LOG_DRAIN_BURST];
+
+    vector<shared_ptr<log_ring_t> > _rings;
+    {
+        std::lock_guard<std::mutex> _lock(ring_mutex);
+        _rings = ring_vec;
+    }
+
+    size_t sum = 0;
+    string text;
+    for (const auto & p_ring: _rings) {
+        size_t n = 0;
+        while ((n = p_ring->pop_bulk(_entries, ASYNC_LOG_DRAIN_BURST)) != 0) {
+            text.clear();
+            for (size_t i = 0; i < n; i ++) {
+                format_entry(_entries[i], text);
+            }
+            fwrite(text.data(), 1, text.size(), p_out);
+            sum += n;
+        }
+    }
+    return sum;
+}
+
+void AsyncLogger::writer_loop() {
+    uint64_t reported_drop = 0;
+    while (m_running.load(std::memory_order_acquire)) {
+        if (drain_once() == 0) {
+            fflush(p_out);
+            usleep((useconds_t) p_logger_config->flush_interval * 1000);
+        }
+
+        const uint64_t _drop = drop_num.load(std::memory_order_relaxed);
+        if (_drop != reported_drop) {
+            fprintf(p_out, "%s[WARN_LOG@%s]%s: %lu log entries dropped.\n",
+                    HIGH_LIGHT_WARN, __FUNCTION__, KNRM, _drop - reported_drop);
+            reported_drop = _drop;
+        }
+    }
+    drain_once();
+    fflush(p_out);
+}
+
+void AsyncLogger::start() {
+    if (m_running.load()) {
+        return;
+    }
+    if (p_logger_config->output_file.length() != 0) {
+        FILE * _f = fopen(p_logger_config->output_file.c_str(), "a");
+        if (_f == nullptr) {
+            WARNF("Open log file %s failed, use stdout.", p_logger_config->output_file.c_str());
+        } else {
+            p_out = _f;
+        }
+    }
+    m_running.store(true, std::memory_order_release);
+    writer_thread = thread(&AsyncLogger::writer_loop, this);
+}
+
+void AsyncLogger::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    if (writer_thread.joinable()) {
+        writer_thread.join();
+    }
+    if (p_out != stdout) {
+        fclose(p_out);
+        p_out = stdout;
+    }
+}
+
+auto AsyncLogger::configure_via_json(const json & jin) -> bool {
+    if (m_running.load()) {
+        WARN("Logger already running, configuration ignored.");
+        return false;
+    }
+
+    p_logger_config = make_shared<AsyncLoggerConfigParam>();
+    if (p_logger_config == nullptr) {
+        WARNF("Logger configuration paramerter bad allocation.");
+        return false;
+    }
+
+    try {
+        if (jin.count("level")) {
+            const string _level = jin["level"];
+            if (log_level_map.count(_level) == 0) {
+                WARNF("Unknown log level: %s", _level.c_str());
+                throw logic_error("Parse error Json tag: level\n");
+            }
+            p_logger_config->level = log_level_map.at(_level);
+        }
+        if (jin.count("ring_size")) {
+            p_logger_config->ring_size =
+                static_cast<decltype(p_logger_config->ring_size)>(jin["ring_size"]);
+        }
+        if (jin.count("flush_interval")) {
+            p_logger_config->flush_interval =
+                static_cast<decltype(p_logger_config->flush_interval)>(jin["flush_interval"]);
+        }
+        if (jin.count("output_file")) {
+            p_logger_config->output_file =
+                static_cast<decltype(p_logger_config->output_file)>(jin["output_file"]);
+        }
+    } catch (exception & e) {
+        WARN(e.what());
+        return false;
+    }
+
+    set_level(p_logger_config->level);
+    return true;
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include "../common.hpp"
+#include "spscRing.hpp"
+
+#include <atomic>
+#include <vector>
+#include <map>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+using namespace std;
+
+// Calls below this level are removed at compile time (0: debug, 1: info, 2: warn)
+#ifndef ASYNC_LOG_MIN_LEVEL
+    #define ASYNC_LOG_MIN_LEVEL 0
+#endif
+
+namespace Whisper {
+
+using log_level_t = uint8_t;
+enum log_level : log_level_t {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO  = 1,
+    LOG_LEVEL_WARN  = 2,
+    LOG_LEVEL_NONE  = 3
+};
+
+static const map<string, log_level_t> log_level_map = {
+    {"debug", LOG_LEVEL_DEBUG},
+    {"info",  LOG_LEVEL_INFO},
+    {"warn",  LOG_LEVEL_WARN},
+    {"none",  LOG_LEVEL_NONE}
+};
+
+// Static description of one call site, its address serves as the format id
+struct LogSite final {
+    log_level_t level;
+    const char * file;
+    int line;
+    const char * func;
+    const char * fmt;
+};
+
+// Binary log record: format id, enqueue time and the raw arguments
+#define ASYNC_LOG_MAX_ARGS 6
+struct LogEntry final {
+    const LogSite * site;
+    double_t ts;
+    uint64_t n_arg;
+    uint64_t args[ASYNC_LOG_MAX_ARGS];
+};
+
+// Arguments are stored as 64 bit words, strings are not supported because the
+// formatting happens after the caller may have released them.
+template <typename T, bool = std::is_floating_point<T>::value>
+struct LogArgCodec final {
+    static_assert(std::is_integral<T>::value || std::is_enum<T>::value,
+                  "async log only accepts arithmetic arguments, strings are not copied into the record");
+    static inline auto encode(T v) -> uint64_t {
+        return (uint64_t) (int64_t) v;
+    }
+};
+
+template <typename T>
+struct LogArgCodec<T, true> final {
+    static inline auto encode(T v) -> uint64_t {
+        const double_t d = v;
+        uint64_t u;
+        memcpy(&u, &d, sizeof(u));
+        return u;
+    }
+};
+
+// True when the format has a %s conversion, checked at compile time on every call site
+static constexpr auto log_fmt_has_str(const char * fmt) -> bool {
+    for (; *fmt != '\0'; fmt ++) {
+        if (*fmt != '%') {
+            continue;
+        }
+        if (*(fmt + 1) == '%') {
+            fmt ++;
+            continue;
+        }
+        // skip flags, width, precision and length modifiers up to the conversion
+        do {
+            fmt ++;
+        } while (*fmt != '\0' && (*fmt < 'a' || *fmt > 'z') && (*fmt < 'A' || *fmt > 'Z'));
+        while (*fmt == 'h' || *fmt == 'l' || *fmt == 'j' || *fmt == 'z' || *fmt == 't' || *fmt == 'L') {
+            fmt ++;
+        }
+        if (*fmt == 's') {
+            return true;
+        }
+        if (*fmt == '\0') {
+            return false;
+        }
+    }
+    return false;
+}
+
+struct AsyncLoggerConfigParam final {
+    log_level_t level = LOG_LEVEL_INFO;
+    // Entries of each per-thread ring
+    size_t ring_size = 1 << 14;
+    // Idle sleep of the writer thread (ms)
+    size_t flush_interval = 100;
+    // Empty for stdout
+    string output_file = "";
+
+    AsyncLoggerConfigParam() = default;
+    virtual ~AsyncLoggerConfigParam() {}
+    AsyncLoggerConfigParam & operator=(const AsyncLoggerConfigParam &) = delete;
+    AsyncLoggerConfigParam(const AsyncLoggerConfigParam &) = delete;
+};
+
+// Per-thread lock-free log rings drained and formatted by one background thread
+class AsyncLogger final {
+
+    private:
+        using log_ring_t = SpscRing<LogEntry>;
+
+        shared_ptr<AsyncLoggerConfigParam> p_logger_config;
+
+        // Runtime level, read by every call site
+        static atomic<log_level_t> runtime_level;
+
+        // Registry of the per-thread rings
+        mutable std::mutex ring_mutex;
+        vector<shared_ptr<log_ring_t> > ring_vec;
+
+        atomic<bool> m_running;
+        atomic<uint64_t> drop_num;
+        thread writer_thread;
+        FILE * p_out = stdout;
+
+        AsyncLogger(): m_running(false), drop_num(0) {
+            p_logger_config = make_shared<AsyncLoggerConfigParam>();
+        }
+
+        auto local_ring() -> log_ring_t *;
+        auto drain_once() -> size_t;
+        void writer_loop();
+        void write_entry(const LogEntry & e);
+
+        static void format_entry(const LogEntry & e, string & out);
+
+    public:
+        virtual ~AsyncLogger() {
+            stop();
+        }
+        AsyncLogger & operator=(const AsyncLogger &) = delete;
+        AsyncLogger(const AsyncLogger &) = delete;
+
+        static auto get_instance() -> AsyncLogger & {
+            static AsyncLogger _instance;
+            return _instance;
+        }
+
+        static auto inline enabled(log_level_t l) -> bool {
+            return l >= runtime_level.load(std::memory_order_relaxed);
+        }
+
+        static void set_level(log_level_t l) {
+            runtime_level.store(l, std::memory_order_relaxed);
+        }
+
+        static auto get_level() -> log_level_t {
+            return runtime_level.load(std::memory_order_relaxed);
+        }
+
+        template <typename... Args>
+        void log(const LogSite * site, Args... args) {
+            static_assert(sizeof...(Args) <= ASYNC_LOG_MAX_ARGS, "too many async log arguments");
+
+            LogEntry e;
+            e.site = site;
+            e.ts = get_time_spec();
+            e.n_arg = sizeof...(Args);
+            const uint64_t _encoded[] = {0, LogArgCodec<Args>::encode(args)...};
+            memcpy(e.args, _encoded + 1, sizeof...(Args) * sizeof(uint64_t));
+
+            // format in place when no writer is running (tools, early init)
+            if (!m_running.load(std::memory_order_acquire)) {
+                write_entry(e);
+                return;
+            }
+
+            if (!local_ring()->push(e)) {
+                drop_num.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+
+        // Config form json file
+        auto configure_via_json(const json & jin) -> bool;
+
+        // Start the background writer
+        void start();
+        // Drain all rings and join the writer
+        void stop();
+
+        auto get_drop_num() const -> uint64_t {
+            return drop_num.load(std::memory_order_relaxed);
+        }
+};
+
+}
+
+#define __ASYNC_LOG(__lvl__, __fmt__, ...) \
+    do { \
+        static_assert(!Whisper::log_fmt_has_str(__fmt__), "async log formats can not use %s"); \
+        if (Whisper::AsyncLogger::enabled(__lvl__)) { \
+            static const Whisper::LogSite ______log_site = \
+                {__lvl__, __FILE__, __LINE__, __FUNCTION__, __fmt__}; \
+            Whisper::AsyncLogger::get_instance().log(&______log_site, ##__VA_ARGS__); \
+        } \
+    } while(0)
+
+#if ASYNC_LOG_MIN_LEVEL <= 0
+    #define ALOGF_DEBUG(__fmt__, ...) __ASYNC_LOG(Whisper::LOG_LEVEL_DEBUG, __fmt__, ##__VA_ARGS__)
+#else
+    #define ALOGF_DEBUG(__fmt__, ...) do {} while(0)
+#endif
+
+#if ASYNC_LOG_MIN_LEVEL <= 1
+    #define ALOGF(__fmt__, ...) __ASYNC_LOG(Whisper::LOG_LEVEL_INFO, __fmt__, ##__VA_ARGS__)
+#else
+    #define ALOGF(__fmt__, ...) do {} while(0)
+#endif
+
+#define AWARNF(__fmt__, ...) __ASYNC_LOG(Whisper::LOG_LEVEL_WARN, __fmt__, ##__VA_ARGS__)
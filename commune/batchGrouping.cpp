@@ -0,0 +1,158 @@
+#include "batchGrouping.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <arpa/inet.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+using namespace Whisper;
+
+BatchGrouper::BatchGrouper() {
+#if defined(__x86_64__)
+    // the gather below needs the records on 4 B boundaries
+    use_avx2 = __builtin_cpu_supports("avx2") && sizeof(PktMetadata) % 4 == 0;
+#endif
+}
+
+auto BatchGrouper::partition_bits(size_t len) -> size_t {
+    size_t bits = 0;
+    while (bits < MAX_PARTITION_BITS && (len >> bits) > PARTITION_TARGET) {
+        bits ++;
+    }
+    return bits;
+}
+
+void BatchGrouper::histogram(const PktMetadata * raw_data, size_t len, size_t bits) {
+    const size_t num_part = (size_t) 1 << bits;
+    // four interleaved counters per partition break the increment dependency of repeated keys
+    for (size_t i = 0; i < len; i ++) {
+        const uint32_t key = ntohl(raw_data[i].ip_src);
+        const uint16_t p = partition_of(key, bits);
+        keys[i] = key;
+        parts[i] = p;
+        hist[(i & 3) * num_part + p] ++;
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+void BatchGrouper::histogram_avx2(const PktMetadata * raw_data, size_t len, size_t bits) {
+    const size_t num_part = (size_t) 1 << bits;
+    const int stride = (int) (sizeof(PktMetadata) / 4);
+    const __m256i v_index = _mm256_setr_epi32(0, stride, 2 * stride, 3 * stride,
+                                              4 * stride, 5 * stride, 6 * stride, 7 * stride);
+    const __m256i v_bswap = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                             3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i v_mul = _mm256_set1_epi32((int) 0x9E3779B1u);
+    const __m128i v_shift = _mm_cvtsi32_si128((int) (32 - bits));
+
+    size_t i = 0;
+    alignas(32) uint32_t p8[8];
+    for (; i + 8 <= len; i += 8) {
+        const int * p_base = reinterpret_cast<const int *>(&raw_data[i].ip_src);
+        const __m256i v_key = _mm256_shuffle_epi8(_mm256_i32gather_epi32(p_base, v_index, 4), v_bswap);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(&keys[i]), v_key);
+        const __m256i v_part = bits ? _mm256_srl_epi32(_mm256_mullo_epi32(v_key, v_mul), v_shift)
+                                    : _mm256_setzero_si256();
+        _mm256_store_si256(reinterpret_cast<__m256i *>(p8), v_part);
+        for (size_t j = 0; j < 8; j ++) {
+            parts[i + j] = (uint16_t) p8[j];
+            hist[(j & 3) * num_part + p8[j]] ++;
+        }
+    }
+    for (; i < len; i ++) {
+        const uint32_t key = ntohl(raw_data[i].ip_src);
+        const uint16_t p = partition_of(key, bits);
+        keys[i] = key;
+        parts[i] = p;
+        hist[(i & 3) * num_part + p] ++;
+    }
+}
+#else
+void BatchGrouper::histogram_avx2(const PktMetadata * raw_data, size_t len, size_t bits) {
+    histogram(raw_data, len, bits);
+}
+#endif
+
+void BatchGrouper::scatter_partitions(size_t len, size_t bits) {
+    const size_t num_part = (size_t) 1 << bits;
+
+    // entries go to a cache line buffer of their partition, full lines are copied out
+    // at once, so the scatter writes whole lines instead of one word per packet
+    for (size_t i = 0; i < len; i ++) {
+        const uint16_t p = parts[i];
+        uint64_t * p_line = &wc_buf[(size_t) p * WC_ENTRIES];
+        p_line[wc_fill[p] ++] = ((uint64_t) keys[i] << 32) | (uint32_t) i;
+        if (wc_fill[p] == WC_ENTRIES) {
+            memcpy(&scatter[cursor[p]], p_line, WC_ENTRIES * sizeof(uint64_t));
+            cursor[p] += WC_ENTRIES;
+            wc_fill[p] = 0;
+        }
+    }
+    for (size_t p = 0; p < num_part; p ++) {
+        if (wc_fill[p]) {
+            memcpy(&scatter[cursor[p]], &wc_buf[p * WC_ENTRIES], wc_fill[p] * sizeof(uint64_t));
+            cursor[p] += wc_fill[p];
+            wc_fill[p] = 0;
+        }
+    }
+}
+
+void BatchGrouper::group(const PktMetadata * raw_data, size_t len, FlowGroups & out) {
+    out.clear();
+    if (len == 0) {
+        return;
+    }
+
+    const size_t bits = partition_bits(len);
+    const size_t num_part = (size_t) 1 << bits;
+
+    keys.resize(len);
+    parts.resize(len);
+    scatter.resize(len);
+    hist.assign(4 * num_part, 0);
+    cursor.resize(num_part + 1);
+    wc_buf.resize(num_part * WC_ENTRIES);
+    wc_fill.assign(num_part, 0);
+
+    // 1. keys, partitions and their sizes
+    if (use_avx2) {
+        histogram_avx2(raw_data, len, bits);
+    } else {
+        histogram(raw_data, len, bits);
+    }
+
+    // 2. partition boundaries, cursor[num_part] keeps the end
+    size_t sum = 0;
+    for (size_t p = 0; p < num_part; p ++) {
+        cursor[p] = sum;
+        sum += hist[p] + hist[num_part + p] + hist[2 * num_part + p] + hist[3 * num_part + p];
+    }
+    cursor[num_part] = sum;
+    bounds.assign(cursor.begin(), cursor.end());
+
+    // 3. scatter, batch order is kept within a partition
+    scatter_partitions(len, bits);
+
+    // 4. every partition fits the cache: sort by key, then by position, and emit the CSR
+    out.index.resize(len);
+    size_t pos = 0;
+    for (size_t p = 0; p < num_part; p ++) {
+        const auto _begin = scatter.begin() + bounds[p], _end = scatter.begin() + bounds[p + 1];
+        sort(_begin, _end);
+        for (auto it = _begin; it != _end; ++ it) {
+            const uint32_t key = (uint32_t) (*it >> 32);
+            // a key lives in one partition only
+            if (out.key.empty() || out.key.back() != key) {
+                out.key.push_back(key);
+                out.offset.push_back((uint32_t) pos);
+                out.count.push_back(0);
+            }
+            out.index[pos ++] = (uint32_t) *it;
+            out.count.back() ++;
+        }
+    }
+}
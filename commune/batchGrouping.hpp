@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../common.hpp"
+#include "dpdkCommon.hpp"
+
+#include <vector>
+
+using namespace std;
+
+namespace Whisper {
+
+// One batch grouped by source address in CSR form: flow k owns
+// index[offset[k], offset[k] + count[k]), the batch positions of its packets in arrival order.
+struct FlowGroups final {
+    // Source address, host byte order
+    vector<uint32_t> key;
+    vector<uint32_t> offset;
+    vector<uint32_t> count;
+    vector<uint32_t> index;
+
+    auto inline size() const -> size_t {
+        return key.size();
+    }
+
+    void clear() {
+        key.clear();
+        offset.clear();
+        count.clear();
+        index.clear();
+    }
+};
+
+// Groups a batch of records by source with a radix partition pass instead of a hash
+// insert per packet: histogram of the partition of every key, scatter through
+// cache-line write-combining buffers, then each cache-resident partition is sorted.
+class BatchGrouper final {
+
+    public:
+        // Entries per partition the sort works on, 8 B each
+        static constexpr size_t PARTITION_TARGET = 4096;
+        static constexpr size_t MAX_PARTITION_BITS = 10;
+        // Entries of one write-combining buffer: one cache line
+        static constexpr size_t WC_ENTRIES = 8;
+
+    private:
+        // Keys in host byte order and their partitions, from the histogram pass
+        vector<uint32_t> keys;
+        vector<uint16_t> parts;
+        // key << 32 | batch index, partitioned
+        vector<uint64_t> scatter;
+        // Four interleaved histograms
+        vector<uint32_t> hist;
+        // Partition starts: fixed, and advanced by the scatter
+        vector<uint32_t> bounds, cursor;
+        vector<uint64_t> wc_buf;
+        vector<uint8_t> wc_fill;
+
+        bool use_avx2 = false;
+
+        auto static inline partition_of(uint32_t key, size_t bits) -> uint16_t {
+            return bits ? (uint16_t) ((key * 0x9E3779B1u) >> (32 - bits)) : 0;
+        }
+
+        void histogram(const PktMetadata * raw_data, size_t len, size_t bits);
+        void histogram_avx2(const PktMetadata * raw_data, size_t len, size_t bits);
+        void scatter_partitions(size_t len, size_t bits);
+
+    public:
+        BatchGrouper();
+        virtual ~BatchGrouper() {}
+        BatchGrouper & operator=(const BatchGrouper &) = delete;
+        BatchGrouper(const BatchGrouper &) = delete;
+
+        // Partition bits of a batch: partitions of about PARTITION_TARGET entries
+        auto static partition_bits(size_t len) -> size_t;
+
+        void group(const PktMetadata * raw_data, size_t len, FlowGroups & out);
+};
+
+}
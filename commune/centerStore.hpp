@@ -0,0 +1,216 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <vector>
+
+using namespace std;
+
+namespace Whisper {
+
+// Storage of the clustering centers in the distance stage
+using center_precision_t = uint8_t;
+enum center_precision : center_precision_t {
+    CENTER_FP32 = 0,
+    // upper half of the float32, round to nearest even
+    CENTER_BF16 = 1,
+    // per center offset and scale over the range of its features
+    CENTER_INT8 = 2
+};
+
+static const map<string, center_precision_t> center_precision_map = {
+    {"fp32", CENTER_FP32},
+    {"bf16", CENTER_BF16},
+    {"int8", CENTER_INT8}
+};
+
+auto static inline center_precision_name(center_precision_t p) -> const char * {
+    return p == CENTER_BF16 ? "bf16" : (p == CENTER_INT8 ? "int8" : "fp32");
+}
+
+// K centers of dim features, nearest center distance of float32 feature rows.
+// Filled once when the analyzer leaves the training mode, read only afterwards.
+class CenterStore final {
+
+    private:
+        center_precision_t precision = CENTER_FP32;
+        size_t num = 0, dim = 0;
+
+        vector<float> fp32;
+        vector<uint16_t> bf16;
+        vector<uint8_t> int8;
+        vector<float> int8_lo, int8_scale;
+        // The learner output, kept for the validation only
+        vector<double_t> reference;
+
+        auto static inline to_bf16(float f) -> uint16_t {
+            uint32_t u;
+            memcpy(&u, &f, sizeof(u));
+            if ((u & 0x7f800000u) == 0x7f800000u) {
+                // inf and nan keep their class
+                return (uint16_t) ((u >> 16) | ((u & 0xffffu) ? 0x40 : 0));
+            }
+            u += 0x7fffu + ((u >> 16) & 1);
+            return (uint16_t) (u >> 16);
+        }
+
+        auto static inline from_bf16(uint16_t h) -> float {
+            const uint32_t u = ((uint32_t) h) << 16;
+            float f;
+            memcpy(&f, &u, sizeof(f));
+            return f;
+        }
+
+        auto inline squared_distance(const float * x, size_t k) const -> float {
+            float sum = 0;
+            switch (precision) {
+                case CENTER_BF16: {
+                    const uint16_t * c = &bf16[k * dim];
+                    for (size_t j = 0; j < dim; j ++) {
+                        const float d = x[j] - from_bf16(c[j]);
+                        sum += d * d;
+                    }
+                    break;
+                }
+                case CENTER_INT8: {
+                    const uint8_t * c = &int8[k * dim];
+                    const float lo = int8_lo[k], scale = int8_scale[k];
+                    for (size_t j = 0; j < dim; j ++) {
+                        const float d = x[j] - (lo + c[j] * scale);
+                        sum += d * d;
+                    }
+                    break;
+                }
+                default: {
+                    const float * c = &fp32[k * dim];
+                    for (size_t j = 0; j < dim; j ++) {
+                        const float d = x[j] - c[j];
+                        sum += d * d;
+                    }
+                }
+            }
+            return sum;
+        }
+
+    public:
+        CenterStore() = default;
+        virtual ~CenterStore() {}
+        CenterStore & operator=(const CenterStore &) = delete;
+        CenterStore(const CenterStore &) = delete;
+
+        void load(const vector<vector<double_t> > & centers, center_precision_t _precision, bool keep_reference) {
+            precision = _precision;
+            num = centers.size();
+            dim = num ? centers[0].size() : 0;
+            fp32.clear();
+            bf16.clear();
+            int8.clear();
+            int8_lo.clear();
+            int8_scale.clear();
+            reference.clear();
+            for (const auto & c: centers) {
+                if (keep_reference) {
+                    reference.insert(reference.end(), c.begin(), c.end());
+                }
+                if (precision == CENTER_FP32) {
+                    fp32.insert(fp32.end(), c.begin(), c.end());
+                } else if (precision == CENTER_BF16) {
+                    for (const auto v: c) {
+                        bf16.push_back(to_bf16((float) v));
+                    }
+                } else {
+                    const double_t lo = *min_element(c.begin(), c.end());
+                    const double_t hi = *max_element(c.begin(), c.end());
+                    const double_t scale = hi > lo ? (hi - lo) / 255 : 1;
+                    int8_lo.push_back((float) lo);
+                    int8_scale.push_back((float) scale);
+                    for (const auto v: c) {
+                        int8.push_back((uint8_t) lround((v - lo) / scale));
+                    }
+                }
+            }
+        }
+
+        auto inline size() const -> size_t {
+            return num;
+        }
+
+        auto inline dimension() const -> size_t {
+            return dim;
+        }
+
+        auto inline has_reference() const -> bool {
+            return !reference.empty();
+        }
+
+        // Distance of one row to its nearest center, max_dist without centers
+        auto inline nearest(const float * x, double_t max_dist) const -> double_t {
+            float best = numeric_limits<float>::max();
+            for (size_t k = 0; k < num; k ++) {
+                best = min(best, squared_distance(x, k));
+            }
+            return num ? min((double_t) sqrt(best), max_dist) : max_dist;
+        }
+
+        // The same in double over the centers of the learner
+        auto nearest_reference(const float * x, double_t max_dist) const -> double_t {
+            double_t best = max_dist * max_dist;
+            for (size_t k = 0; k * dim < reference.size(); k ++) {
+                double_t sum = 0;
+                for (size_t j = 0; j < dim; j ++) {
+                    const double_t d = (double_t) x[j] - reference[k * dim + j];
+                    sum += d * d;
+                }
+                best = min(best, sum);
+            }
+            return sqrt(best);
+        }
+
+        // Distance of a flow: the largest over its window means of the nearest center distance
+        auto max_nearest(const float * rows, size_t n, double_t max_dist) const -> double_t {
+            double_t res = 0;
+            for (size_t i = 0; i < n; i ++) {
+                res = max(res, nearest(rows + i * dim, max_dist));
+            }
+            return res;
+        }
+
+        auto max_nearest_reference(const float * rows, size_t n, double_t max_dist) const -> double_t {
+            double_t res = 0;
+            for (size_t i = 0; i < n; i ++) {
+                res = max(res, nearest_reference(rows + i * dim, max_dist));
+            }
+            return res;
+        }
+
+        auto memory_bytes() const -> size_t {
+            return fp32.size() * sizeof(float) + bf16.size() * sizeof(uint16_t) + int8.size()
+                   + (int8_lo.size() + int8_scale.size()) * sizeof(float);
+        }
+};
+
+// Deviation of the verdicts of the distance stage from its double precision reference
+struct CenterValidation final {
+    uint64_t verdicts = 0;
+    // Verdicts on different sides of the alarm threshold
+    uint64_t flips = 0;
+    double_t sum_abs = 0, max_abs = 0, max_rel = 0;
+
+    void inline add(double_t dist, double_t ref, double_t threshold) {
+        const double_t err = fabs(dist - ref);
+        verdicts ++;
+        sum_abs += err;
+        max_abs = max(max_abs, err);
+        max_rel = max(max_rel, ref > 0 ? err / ref : 0);
+        flips += (dist > threshold) != (ref > threshold) ? 1 : 0;
+    }
+
+    auto report() const -> string {
+        char buf[192];
+        snprintf(buf, sizeof(buf), "%lu scores, abs. error mean %.3le max %.3le, rel. error max %.3le, %lu flipped",
+                 verdicts, verdicts ? sum_abs / verdicts : 0, max_abs, max_rel, flips);
+        return buf;
+    }
+};
+
+}
@@ -0,0 +1,148 @@
+#include "cpuTopology.hpp"
+
+#include <set>
+
+using namespace Whisper;
+
+auto CpuTopology::read_int_file(const string & path, int dft) -> int {
+    ifstream fin(path);
+    int v = dft;
+    if (!(fin >> v)) {
+        return dft;
+    }
+    return v;
+}
+
+auto CpuTopology::parse_cpu_list(const string & s) -> vector<cpu_core_id_t> {
+    vector<cpu_core_id_t> ret;
+    stringstream ss(s);
+    string item;
+    while (getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        const auto dash = item.find('-');
+        try {
+            if (dash == string::npos) {
+                ret.push_back((cpu_core_id_t) stoul(item));
+            } else {
+                const auto lo = stoul(item.substr(0, dash));
+                const auto hi = stoul(item.substr(dash + 1));
+                for (auto c = lo; c <= hi; c ++) {
+                    ret.push_back((cpu_core_id_t) c);
+                }
+            }
+        } catch (exception & e) {
+            WARNF("Invalid CPU list item: %s", item.c_str());
+        }
+    }
+    return ret;
+}
+
+auto CpuTopology::pci_numa_node(const string & pci_addr) -> int {
+    if (pci_addr.empty()) {
+        return -1;
+    }
+    return read_int_file("/sys/bus/pci/devices/" + pci_addr + "/numa_node", -1);
+}
+
+auto CpuTopology::load() -> bool {
+    cpu_vec.clear();
+
+    ifstream fin("/sys/devices/system/cpu/online");
+    string online;
+    if (!getline(fin, online)) {
+        WARN("Can not read online CPU list.");
+        return false;
+    }
+
+    for (const auto cpu: parse_cpu_list(online)) {
+        const string base = "/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/";
+        CpuInfo info;
+        info.cpu = cpu;
+        info.socket = max(read_int_file(base + "physical_package_id", 0), 0);
+        info.physical_core = read_int_file(base + "core_id", cpu);
+        cpu_vec.push_back(info);
+    }
+    return !cpu_vec.empty();
+}
+
+auto CpuTopology::socket_of(cpu_core_id_t cpu) const -> int {
+    for (const auto & info: cpu_vec) {
+        if (info.cpu == cpu) {
+            return info.socket;
+        }
+    }
+    return -1;
+}
+
+auto CpuTopology::physical_core_of(cpu_core_id_t cpu) const -> int {
+    for (const auto & info: cpu_vec) {
+        if (info.cpu == cpu) {
+            return info.physical_core;
+        }
+    }
+    return -1;
+}
+
+auto CpuTopology::place_workers(cpu_core_id_t master_core, int nic_socket,
+                                size_t num_parser, size_t num_analyzer,
+                                vector<cpu_core_id_t> & parser_cores,
+                                vector<cpu_core_id_t> & analyzer_cores) const -> bool {
+    using phy_key_t = pair<int, int>;
+
+    // candidates ordered by: NIC local socket first, then socket id, physical core, cpu
+    vector<CpuInfo> candidates;
+    for (const auto & info: cpu_vec) {
+        if (info.cpu != master_core && info.cpu < MAX_NUM_OF_CORES) {
+            candidates.push_back(info);
+        }
+    }
+    sort(candidates.begin(), candidates.end(), [nic_socket] (const CpuInfo & a, const CpuInfo & b) {
+        const bool _la = a.socket == nic_socket, _lb = b.socket == nic_socket;
+        if (_la != _lb) return _la;
+        if (a.socket != b.socket) return a.socket < b.socket;
+        if (a.physical_core != b.physical_core) return a.physical_core < b.physical_core;
+        return a.cpu < b.cpu;
+    });
+
+    set<phy_key_t> busy_physical = {{socket_of(master_core), physical_core_of(master_core)}};
+    set<cpu_core_id_t> taken;
+
+    const auto _f_pick = [&] (size_t n, vector<cpu_core_id_t> & out) -> void {
+        // first pass: one logical CPU of an idle physical core
+        for (const auto & info: candidates) {
+            if (out.size() == n) return;
+            const phy_key_t _k = {info.socket, info.physical_core};
+            if (taken.count(info.cpu) || busy_physical.count(_k)) continue;
+            out.push_back(info.cpu);
+            taken.insert(info.cpu);
+            busy_physical.insert(_k);
+        }
+        // second pass: hyperthread siblings of busy cores
+        for (const auto & info: candidates) {
+            if (out.size() == n) return;
+            if (taken.count(info.cpu)) continue;
+            WARNF("Core %d shares a physical core with another worker.", info.cpu);
+            out.push_back(info.cpu);
+            taken.insert(info.cpu);
+        }
+    };
+
+    parser_cores.clear();
+    analyzer_cores.clear();
+    _f_pick(num_parser, parser_cores);
+    _f_pick(num_analyzer, analyzer_cores);
+
+    if (parser_cores.size() != num_parser || analyzer_cores.size() != num_analyzer) {
+        WARN("Not enough cores for the requested workers.");
+        return false;
+    }
+
+    for (const auto c: parser_cores) {
+        if (socket_of(c) != nic_socket && nic_socket >= 0) {
+            WARNF("Parser on core %d is not on the NIC socket %d.", c, nic_socket);
+        }
+    }
+    return true;
+}
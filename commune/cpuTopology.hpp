@@ -0,0 +1,53 @@
+#pragma once
+
+#include "dpdkCommon.hpp"
+
+namespace Whisper {
+
+// One logical CPU as described by sysfs
+struct CpuInfo final {
+    cpu_core_id_t cpu;
+    int socket;
+    int physical_core;
+};
+
+// CPU and NIC topology read from /sys, used to place the worker threads
+class CpuTopology final {
+
+    private:
+        vector<CpuInfo> cpu_vec;
+
+        auto static read_int_file(const string & path, int dft) -> int;
+
+    public:
+        CpuTopology() = default;
+        virtual ~CpuTopology() {}
+        CpuTopology & operator=(const CpuTopology &) = delete;
+        CpuTopology(const CpuTopology &) = delete;
+
+        // Read the online CPUs and their socket / physical core ids
+        auto load() -> bool;
+
+        auto inline get_cpus() const -> const vector<CpuInfo> & {
+            return cpu_vec;
+        }
+
+        // -1 when the CPU is unknown
+        auto socket_of(cpu_core_id_t cpu) const -> int;
+        auto physical_core_of(cpu_core_id_t cpu) const -> int;
+
+        // Parse a kernel style CPU list, e.g. "0-3,8,10-11"
+        auto static parse_cpu_list(const string & s) -> vector<cpu_core_id_t>;
+
+        // NUMA node of a PCI device, -1 when unknown (virtual devices, single node)
+        auto static pci_numa_node(const string & pci_addr) -> int;
+
+        // Pick cores for parsers and analyzers: NIC local socket first, one logical CPU
+        // per physical core, hyperthread siblings only when the physical cores run out.
+        auto place_workers(cpu_core_id_t master_core, int nic_socket,
+                           size_t num_parser, size_t num_analyzer,
+                           vector<cpu_core_id_t> & parser_cores,
+                           vector<cpu_core_id_t> & analyzer_cores) const -> bool;
+};
+
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "../common.hpp"
+#include "stageProfiler.hpp"
+
+#include <atomic>
+#include <map>
+
+using namespace std;
+
+namespace Whisper {
+
+using clock_calibration_t = uint8_t;
+enum clock_calibration : clock_calibration_t {
+    // switch and host clocks are synchronized (PTP)
+    CLOCK_CALIB_NONE  = 0,
+    // constant offset given in the configuration
+    CLOCK_CALIB_FIXED = 1,
+    // running minimum of (host arrival - switch timestamp)
+    CLOCK_CALIB_MIN   = 2
+};
+
+static const map<string, clock_calibration_t> clock_calibration_map = {
+    {"none",  CLOCK_CALIB_NONE},
+    {"fixed", CLOCK_CALIB_FIXED},
+    {"min",   CLOCK_CALIB_MIN}
+};
+
+struct DetectionLatencyParam final {
+    // Seconds per tick of the Peregrine timestamp
+    double_t switch_ts_unit = 1e-9;
+    clock_calibration_t calibration = CLOCK_CALIB_MIN;
+    // Host clock minus switch clock (s), CLOCK_CALIB_FIXED only
+    double_t clock_offset = 0;
+    // Length of one minimum window (s), the estimate spans the last two windows
+    double_t calibration_window = 10.0;
+    // Detection latency objective (ms), 0 disables the violation counter
+    double_t slo_ms = 0;
+};
+
+// Wire-to-verdict latency of one analyzer: from the switch timestamp of the packet
+// that completed the analyzed window to the emission of the verdict.
+class DetectionLatencyTracker final {
+
+    private:
+        DetectionLatencyParam param;
+
+        // two-window running minimum of the observed one-way delay
+        double_t min_cur = 1e300, min_prev = 1e300;
+        double_t window_start = 0;
+
+        LatencyHistogram hist_ns;
+        atomic<uint64_t> verdict_num;
+        atomic<uint64_t> slo_violation;
+
+        void static inline bump(atomic<uint64_t> & c) {
+            c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+    public:
+        DetectionLatencyTracker(): verdict_num(0), slo_violation(0) {}
+        virtual ~DetectionLatencyTracker() {}
+        DetectionLatencyTracker & operator=(const DetectionLatencyTracker &) = delete;
+        DetectionLatencyTracker(const DetectionLatencyTracker &) = delete;
+
+        void configure(const DetectionLatencyParam & p) {
+            param = p;
+        }
+
+        // Calibration sample: host time at which a record with this switch timestamp arrived
+        void inline observe_arrival(double_t switch_ts, double_t host_ts) {
+            if (param.calibration != CLOCK_CALIB_MIN) {
+                return;
+            }
+            if (host_ts - window_start > param.calibration_window) {
+                min_prev = min_cur;
+                min_cur = 1e300;
+                window_start = host_ts;
+            }
+            min_cur = min(min_cur, host_ts - switch_ts * param.switch_ts_unit);
+        }
+
+        // Host clock minus switch clock
+        auto inline offset() const -> double_t {
+            switch (param.calibration) {
+                case CLOCK_CALIB_FIXED:
+                    return param.clock_offset;
+                case CLOCK_CALIB_MIN: {
+                    const double_t m = min(min_cur, min_prev);
+                    return m < 1e300 ? m : 0;
+                }
+                default:
+                    return 0;
+            }
+        }
+
+        // One verdict whose window was completed by a packet with this switch timestamp
+        void inline record_verdict(double_t switch_ts, double_t host_ts) {
+            const double_t latency = max(0.0, host_ts - (switch_ts * param.switch_ts_unit + offset()));
+            hist_ns.record((uint64_t) (latency * 1e9));
+            bump(verdict_num);
+            if (param.slo_ms > 0 && latency * 1e3 > param.slo_ms) {
+                bump(slo_violation);
+            }
+        }
+
+        void merge_into(HistogramSnapshot & snap) const {
+            hist_ns.merge_into(snap.counts, snap.max_value);
+        }
+
+        auto get_verdict_num() const -> uint64_t {
+            return verdict_num.load(std::memory_order_relaxed);
+        }
+
+        auto get_slo_violation() const -> uint64_t {
+            return slo_violation.load(std::memory_order_relaxed);
+        }
+
+        // One line summary of a (merged) latency histogram in ms
+        auto static report(const HistogramSnapshot & snap, uint64_t verdicts,
+                           uint64_t violations, double_t slo_ms) -> string {
+            char buf[256];
+            int n = snprintf(buf, sizeof(buf),
+                             "%lu verdicts, p50 %.3lf ms, p99 %.3lf ms, p999 %.3lf ms, max %.3lf ms",
+                             verdicts, snap.percentile(0.5) / 1e6, snap.percentile(0.99) / 1e6,
+                             snap.percentile(0.999) / 1e6, snap.max_value / 1e6);
+            if (slo_ms > 0 && n > 0 && (size_t) n < sizeof(buf)) {
+                snprintf(buf + n, sizeof(buf) - n, ", SLO %.1lf ms violated: %lu (%.3lf%%)",
+                         slo_ms, violations, verdicts ? 100.0 * violations / verdicts : 0.0);
+            }
+            return buf;
+        }
+};
+
+}
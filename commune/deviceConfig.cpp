@@ -1,6 +1,12 @@
 #include "deviceConfig.hpp"
 #include "parserWorker.hpp"
 
+#include <set>
+#include <functional>
+#include <csignal>
+#include <unistd.h>
+#include <rte_ethdev.h>
+
 using namespace Whisper;
 using namespace pcpp;
 
@@ -13,19 +19,11 @@ void DeviceConfig::list_dpdk_ports() const {
 	if (p_configure_param->core_num <= 1) {
 		core_mask_use = getCoreMaskForAllMachineCores();
 	} else {
-		core_mask_use = (1 << p_configure_param->core_num) - 1;
+		core_mask_use = used_core_mask();
 	}
 
 	printf("----- Display DPDK setting -----\n");
-	if (dpdk_init_once) {
-		LOGF("DPDK has init.");
-	} else {
-		if (!DpdkDeviceList::initDpdk(core_mask_use, p_configure_param->mbuf_pool_size)) {
-			FATAL_ERROR("couldn't initialize DPDK");
-		} else {
-			dpdk_init_once = true;
-		}
-	}
+	init_dpdk_once(core_mask_use);
 
 	printf("DPDK port list:\n");
 
@@ -141,25 +139,12 @@ auto DeviceConfig::create_worker_threads(const assign_queue_t & queue_assign,
 		}
 	#endif
 
-	size_t parser_per_analyzer = parser_thread_vec.size() /
-		(size_t) p_configure_param->core_use_for_analyze;
-
-	size_t parser_remain = parser_thread_vec.size() -
-		((size_t) p_configure_param->core_use_for_analyze * parser_per_analyzer);
-
-	using ptr_vec_for_parser = vector<shared_ptr<ParserWorkerThread> >;
-	vector<ptr_vec_for_parser> ve_all;
-
-	for (cpu_core_id_t i = 0; i < p_configure_param->core_use_for_analyze; i ++) {
-		ptr_vec_for_parser ve(parser_thread_vec.begin() + (i * parser_per_analyzer),
-							  parser_thread_vec.begin() + ((i + 1) * parser_per_analyzer));
-		ve_all.push_back(ve);
-	}
-
-	assert(parser_remain <= ve_all.size());
-
-	for (int i = 0; i < parser_remain; i ++) {
-		ve_all[i].push_back(parser_thread_vec[parser_thread_vec.size() - i - 1]);
+	// every parser keeps one handoff ring per analyzer and dispatches by source address,
+	// so that each analyzer owns a consistent shard of the address space
+	for (const auto & p_parser: parser_thread_vec) {
+		if (!p_parser->bind_analyzers(p_configure_param->core_use_for_analyze)) {
+			return false;
+		}
 	}
 
 	// Create KMeansLearner for Analyzer
@@ -177,9 +162,10 @@ auto DeviceConfig::create_worker_threads(const assign_queue_t & queue_assign,
 		}
 	#endif
 
-	// bind the KMeans Learner and the ParserWorkers to the AnalyzeWorker
+	// bind the KMeans Learner and all of the ParserWorkers to the AnalyzeWorker
 	for (cpu_core_id_t i = 0; i < p_configure_param->core_use_for_analyze; i ++) {
-		const auto p_new_analyzer = make_shared<AnalyzerWorkerThread>(ve_all[i], p_k_learner);
+		const auto p_new_analyzer = make_shared<AnalyzerWorkerThread>(
+			parser_thread_vec, p_k_learner, (size_t) i);
 
 		if (p_new_analyzer == nullptr) {
 			return false;
@@ -192,6 +178,59 @@ auto DeviceConfig::create_worker_threads(const assign_queue_t & queue_assign,
 		analyzer_thread_vec.push_back(p_new_analyzer);
 	}
 
+	// the labels of the accuracy monitor are parsed once for all analyzers
+	if (!analyzer_thread_vec.empty()) {
+		const auto & _am = analyzer_thread_vec.front()->p_analyzer_conf->accuracy_monitor;
+		if (_am.label_file.length() != 0) {
+			const auto p_labels = LabeledAddressSet::load(_am.label_file, _am.label_tag);
+			if (p_labels == nullptr) {
+				WARNF("Load labels from %s failed.", _am.label_file.c_str());
+				return false;
+			}
+			for (const auto & p_analyzer: analyzer_thread_vec) {
+				p_analyzer->bind_label_set(p_labels);
+			}
+		}
+	}
+
+	// idle analyzers take the ready flows of the busy ones, batch STFT path only
+	if (analyzer_thread_vec.size() > 1 && analyzer_thread_vec.front()->p_analyzer_conf->work_stealing
+		&& !analyzer_thread_vec.front()->p_analyzer_conf->incremental_dft) {
+		const auto p_task_pool = make_shared<FlowTaskPool>(analyzer_thread_vec.size());
+		for (const auto & p_analyzer: analyzer_thread_vec) {
+			p_analyzer->bind_task_pool(p_task_pool);
+		}
+	}
+
+	// the live verdict table is shared by all analyzers
+	if (j_cfg_verdict.size() != 0) {
+		const auto p_verdict_table = make_shared<VerdictTable>();
+		if (p_verdict_table->configure_via_json(j_cfg_verdict) && p_verdict_table->is_enabled()) {
+			#ifdef DISP_PARAM
+				if (verbose) {
+					p_verdict_table->get_config()->display_params();
+				}
+			#endif
+			if (!p_verdict_table->create()) {
+				return false;
+			}
+			for (const auto & p_analyzer: analyzer_thread_vec) {
+				p_analyzer->bind_verdict_table(p_verdict_table);
+			}
+		}
+	}
+
+	// the overload guards of each parser prefer the sources its analyzers already track
+	vector<shared_ptr<TrackedSourceFilter> > tracked_filters;
+	for (const auto & p_analyzer: analyzer_thread_vec) {
+		tracked_filters.push_back(p_analyzer->get_tracked_filter());
+	}
+	for (const auto & p_parser: parser_thread_vec) {
+		if (!p_parser->bind_tracked_filters(tracked_filters)) {
+			return false;
+		}
+	}
+
 	#ifdef DISP_PARAM
 		if (verbose) {
 			analyzer_thread_vec[0]->p_analyzer_conf->display_params();
@@ -204,20 +243,235 @@ auto DeviceConfig::create_worker_threads(const assign_queue_t & queue_assign,
 void DeviceConfig::interrupt_callback(void* cookie) {
 	ThreadStateManagement * args = (ThreadStateManagement *) cookie;
 
+	// signal context: only raise the flag, do_init runs the shutdown sequence
+	args->stop = true;
+}
+
+auto DeviceConfig::drain_and_shutdown(const ThreadStateManagement & args) const -> bool {
 	printf("\n ----- Whisper stopped ----- \n");
 
-	// stop worker threads
-	DpdkDeviceList::getInstance().stopDpdkWorkerThreads();
-	usleep(5000);
-	DpdkDeviceList::getInstance().stopDpdkWorkerThreads();
-	usleep(5000);
-	DpdkDeviceList::getInstance().stopDpdkWorkerThreads();
+	const double_t deadline = get_time_spec() + p_configure_param->shutdown_deadline;
+	const auto _f_wait_until = [deadline] (const function<bool()> & done) -> bool {
+		while (!done()) {
+			if (get_time_spec() > deadline) {
+				return false;
+			}
+			usleep(1000);
+		}
+		return true;
+	};
+
+	// 1. stop RX, every parser finishes its current burst
+	for (const auto & _p_thread: args.parser_worker_thread_vec) {
+		_p_thread->stop_rx();
+	}
+	bool in_time = _f_wait_until([&args] () -> bool {
+		for (const auto & _p_thread: args.parser_worker_thread_vec) {
+			if (!_p_thread->is_rx_exited()) return false;
+		}
+		return true;
+	});
+
+	// 2. drain the handoff rings, 3. final pass including the partial flows
+	#ifndef START_PARSER_ONLY
+		if (in_time) {
+			for (const auto & _p_thread: args.analyzer_worker_thread_vec) {
+				_p_thread->request_drain();
+			}
+			in_time = _f_wait_until([&args] () -> bool {
+				for (const auto & _p_thread: args.analyzer_worker_thread_vec) {
+					if (!_p_thread->is_drained()) return false;
+				}
+				return true;
+			});
+		}
+	#endif
+	if (!in_time) {
+		WARN("Shutdown deadline reached before the drain finished, the remaining records are dropped.");
+	}
+
+	// 4. join the workers, a worker blocked beyond the deadline aborts the flush
+	atomic<bool> joined(false);
+	thread _joiner([&joined] () -> void {
+		DpdkDeviceList::getInstance().stopDpdkWorkerThreads();
+		joined.store(true, std::memory_order_release);
+	});
+	if (!_f_wait_until([&joined] () -> bool {return joined.load(std::memory_order_acquire);})) {
+		WARN("Shutdown deadline exceeded while joining the workers, exit without flushing results.");
+		AsyncLogger::get_instance().stop();
+		fflush(stdout);
+		_exit(EXIT_FAILURE);
+	}
+	_joiner.join();
+
+	// 5. flush results off the signal path
+	for (const auto & _p_thread: args.analyzer_worker_thread_vec) {
+		if (!_p_thread->flush_results()) {
+			WARNF("Analyzer on core # %2d: flush results failed.", _p_thread->getCoreId());
+		}
+	}
+
+	print_overall_performance(args);
+	report_stage_latency(args);
+	const bool slo_met = report_detection_latency(args);
+	report_accuracy(args);
+
+	if (run_hooks.on_stop) {
+		run_hooks.on_stop(args);
+	}
+
+	// flush the hot path logs of the stopped workers
+	AsyncLogger::get_instance().stop();
+	return slo_met;
+}
+
+void DeviceConfig::report_stage_latency(const ThreadStateManagement & args) const {
+	if (args.analyzer_worker_thread_vec.empty()) {
+		return;
+	}
+
+	// merge the per-worker histograms of every analyzer
+	vector<HistogramSnapshot> merged;
+	for (const auto & _p_thread: args.analyzer_worker_thread_vec) {
+		_p_thread->merge_stage_latency(merged);
+	}
+	uint64_t _recorded = 0;
+	for (const auto & snap: merged) {
+		_recorded += snap.total();
+	}
+	if (_recorded == 0) {
+		return;
+	}
 
+	printf("[Stage Latency] All analyzers:\n%s", StageProfiler::report(merged).c_str());
+
+	const auto & report_file = args.analyzer_worker_thread_vec[0]->p_analyzer_conf->stage_report_file;
+	if (report_file.length() != 0) {
+		ofstream of(report_file);
+		if (of) {
+			of << StageProfiler::report_json(merged).dump(4) << endl;
+		} else {
+			WARNF("Write stage latency report to %s failed.", report_file.c_str());
+		}
+	}
+}
+
+auto DeviceConfig::report_detection_latency(const ThreadStateManagement & args) const -> bool {
+	if (args.analyzer_worker_thread_vec.empty()) {
+		return true;
+	}
+
+	const auto & _conf = args.analyzer_worker_thread_vec[0]->p_analyzer_conf;
+	const double_t slo_ms = _conf->detection_latency.slo_ms;
+
+	HistogramSnapshot merged;
+	uint64_t verdicts = 0, violations = 0;
+	json j;
+	for (const auto & _p_thread: args.analyzer_worker_thread_vec) {
+		HistogramSnapshot _snap;
+		_p_thread->merge_detection_latency(_snap);
+		_p_thread->merge_detection_latency(merged);
+		const auto _num = _p_thread->get_detection_latency_num();
+		verdicts += _num.first;
+		violations += _num.second;
+		if (_num.first == 0) {
+			continue;
+		}
+		printf("[Detection Latency] Analyzer on core # %2d: %s\n", _p_thread->getCoreId(),
+			   DetectionLatencyTracker::report(_snap, _num.first, _num.second, slo_ms).c_str());
+		json _j;
+		_j["verdicts"] = _num.first;
+		_j["slo_violations"] = _num.second;
+		_j["p50_ms"] = _snap.percentile(0.5) / 1e6;
+		_j["p99_ms"] = _snap.percentile(0.99) / 1e6;
+		_j["p999_ms"] = _snap.percentile(0.999) / 1e6;
+		_j["max_ms"] = _snap.max_value / 1e6;
+		j["core_" + to_string(_p_thread->getCoreId())] = _j;
+	}
+	if (verdicts == 0) {
+		return true;
+	}
+
+	printf("[Detection Latency] All analyzers: %s\n",
+		   DetectionLatencyTracker::report(merged, verdicts, violations, slo_ms).c_str());
+
+	// the objective holds when at most the budget fraction of verdicts exceeded it
+	bool slo_met = true;
+	if (slo_ms > 0) {
+		slo_met = violations <= _conf->latency_slo_budget * verdicts;
+		if (!slo_met) {
+			WARNF("Detection latency SLO missed: %.3lf%% of verdicts above %.2lf ms (budget %.3lf%%).",
+				  100.0 * violations / verdicts, slo_ms, 100.0 * _conf->latency_slo_budget);
+		}
+	}
+
+	if (_conf->latency_report_file.length() != 0) {
+		j["verdicts"] = verdicts;
+		j["slo_violations"] = violations;
+		j["slo_ms"] = slo_ms;
+		j["slo_budget"] = _conf->latency_slo_budget;
+		j["slo_met"] = slo_met;
+		j["p50_ms"] = merged.percentile(0.5) / 1e6;
+		j["p99_ms"] = merged.percentile(0.99) / 1e6;
+		j["p999_ms"] = merged.percentile(0.999) / 1e6;
+		j["max_ms"] = merged.max_value / 1e6;
+		ofstream of(_conf->latency_report_file);
+		if (of) {
+			of << j.dump(4) << endl;
+		} else {
+			WARNF("Write detection latency report to %s failed.", _conf->latency_report_file.c_str());
+		}
+	}
+	return slo_met;
+}
+
+void DeviceConfig::report_accuracy(const ThreadStateManagement & args) const {
+	if (args.analyzer_worker_thread_vec.empty()) {
+		return;
+	}
+
+	const auto & _conf = args.analyzer_worker_thread_vec[0]->p_analyzer_conf;
+	const auto & _am = _conf->accuracy_monitor;
+	if (_am.label_file.length() == 0) {
+		return;
+	}
+
+	AccuracySnapshot window, total;
+	json j;
+	for (const auto & _p_thread: args.analyzer_worker_thread_vec) {
+		AccuracySnapshot _window, _total;
+		_p_thread->merge_accuracy(_window, _total);
+		window.add(_window);
+		total.add(_total);
+		if (_total.verdicts) {
+			printf("[Accuracy] Analyzer on core # %2d: %s\n", _p_thread->getCoreId(),
+				   AccuracyMonitor::report(_total, _am).c_str());
+		}
+	}
+	printf("[Accuracy] All analyzers, whole run: %s\n", AccuracyMonitor::report(total, _am).c_str());
+	printf("[Accuracy] All analyzers, last %.0lfs: %s\n", _am.window, AccuracyMonitor::report(window, _am).c_str());
+
+	if (_conf->accuracy_report_file.length() != 0) {
+		j["label_file"] = _am.label_file;
+		j["label_tag"] = _am.label_tag;
+		j["total"] = AccuracyMonitor::evaluate(total, _am).to_json(100);
+		j["window"] = AccuracyMonitor::evaluate(window, _am).to_json(100);
+		j["window"]["length"] = _am.window;
+		ofstream of(_conf->accuracy_report_file);
+		if (of) {
+			of << j.dump(4) << endl;
+		} else {
+			WARNF("Write accuracy report to %s failed.", _conf->accuracy_report_file.c_str());
+		}
+	}
+}
+
+void DeviceConfig::print_overall_performance(const ThreadStateManagement & args) const {
 	// print stats for every worker thread plus sum of all threads and free worker threads memory
 	double_t overall_parser_num = 0, overall_parser_len = 0;
 	bool __is_print_parser = false;
 
-	for (auto & _p_thread: args->parser_worker_thread_vec) {
+	for (const auto & _p_thread: args.parser_worker_thread_vec) {
 		const auto ref = _p_thread->get_overall_performance();
 		overall_parser_num += ref.first;
 		overall_parser_len += ref.second;
@@ -235,7 +489,7 @@ void DeviceConfig::interrupt_callback(void* cookie) {
 	#ifndef START_PARSER_ONLY
 		double_t overall_analyzer_num = 0, overall_analyzer_len = 0;
 		bool __is_print_analyzer = false;
-		for (auto & _p_thread: args->analyzer_worker_thread_vec) {
+		for (const auto & _p_thread: args.analyzer_worker_thread_vec) {
 			const auto ref = _p_thread->get_overall_performance();
 			overall_analyzer_num += ref.first;
 			overall_analyzer_len += ref.second;
@@ -249,23 +503,34 @@ void DeviceConfig::interrupt_callback(void* cookie) {
 				 overall_analyzer_len);
 		}
 	#endif
+}
 
-	args->stop = true;
+void DeviceConfig::init_dpdk_once(const CoreMask mask) const {
+	if (dpdk_init_once) {
+		LOGF("DPDK has already init.");
+		return;
+	}
+
+	// appended by pcpp after the core mask and the master core, no spaces inside an argument
+	vector<string> _args(p_configure_param->eal_args);
+	vector<char *> _argv;
+	for (auto & a: _args) {
+		_argv.push_back(&a[0]);
+	}
+	_argv.push_back(nullptr);
+	if (!DpdkDeviceList::initDpdk(mask, p_configure_param->mbuf_pool_size,
+								  p_configure_param->master_core,
+								  _args.size(), _args.size() ? _argv.data() : nullptr, "whisper")) {
+		FATAL_ERROR("Couldn't initialize DPDK.");
+	}
+	dpdk_init_once = true;
 }
 
 auto DeviceConfig::configure_dpdk_nic(const CoreMask mask_all_used_core) const -> device_list_t {
 	LOGF("Init DPDK device.");
 
 	// initialize DPDK
-	if (dpdk_init_once) {
-		LOGF("DPDK has already init.");
-	} else {
-		if (!DpdkDeviceList::initDpdk(mask_all_used_core, p_configure_param->mbuf_pool_size)) {
-			FATAL_ERROR("Couldn't initialize DPDK.");
-		} else {
-			dpdk_init_once = true;
-		}
-	}
+	init_dpdk_once(mask_all_used_core);
 
 	// removing DPDK master core from core mask because worker threads cannot run on master core
 	CoreMask core_mask_remain =
@@ -320,7 +585,120 @@ auto DeviceConfig::configure_dpdk_nic(const CoreMask mask_all_used_core) const -
 	return device_to_use;
 }
 
-void DeviceConfig::do_init() {
+auto DeviceConfig::is_whisper_core(cpu_core_id_t id) const -> bool {
+	if (id >= MAX_NUM_OF_CORES) {
+		return false;
+	}
+	if (!p_configure_param->has_core_list() && p_configure_param->auto_placement) {
+		return id == p_configure_param->master_core;
+	}
+	return (used_core_mask() & SystemCores::IdToSystemCore[id].Mask) != 0;
+}
+
+auto DeviceConfig::used_core_mask() const -> CoreMask {
+	const auto _f_core_bit = [] (cpu_core_id_t id) -> CoreMask {
+		return id < MAX_NUM_OF_CORES ? SystemCores::IdToSystemCore[id].Mask : 0;
+	};
+
+	CoreMask mask = _f_core_bit(p_configure_param->master_core);
+
+	if (p_configure_param->has_core_list()) {
+		for (const auto id: p_configure_param->parser_core_list) {
+			mask |= _f_core_bit(id);
+		}
+		for (const auto id: p_configure_param->analyzer_core_list) {
+			mask |= _f_core_bit(id);
+		}
+	} else if (p_configure_param->auto_placement) {
+		// hand every core to DPDK, the workers are picked after the NIC is known
+		mask |= getCoreMaskForAllMachineCores();
+	} else {
+		for (cpu_core_id_t id = 0; id < p_configure_param->core_num; id ++) {
+			mask |= _f_core_bit(id);
+		}
+	}
+	return mask;
+}
+
+auto DeviceConfig::place_worker_cores(const device_list_t & dev_list,
+									  const CoreMask mask_all_used_core,
+									  vector<cpu_core_id_t> & parser_core_ids,
+									  vector<cpu_core_id_t> & analyzer_core_ids) const -> bool {
+	parser_core_ids.clear();
+	analyzer_core_ids.clear();
+
+	if (p_configure_param->has_core_list()) {
+		parser_core_ids = p_configure_param->parser_core_list;
+		analyzer_core_ids = p_configure_param->analyzer_core_list;
+	} else if (p_configure_param->auto_placement) {
+		CpuTopology topology;
+		if (!topology.load()) {
+			WARN("CPU topology not available.");
+			return false;
+		}
+
+		// socket of the NIC: sysfs first, DPDK for virtual devices
+		int nic_socket = CpuTopology::pci_numa_node(dev_list[0]->getPciAddress());
+		if (nic_socket < 0) {
+			nic_socket = rte_eth_dev_socket_id(dev_list[0]->getDeviceId());
+		}
+		if (nic_socket < 0) {
+			nic_socket = topology.socket_of(p_configure_param->master_core);
+		}
+		for (const auto p_dev: dev_list) {
+			const int _s = CpuTopology::pci_numa_node(p_dev->getPciAddress());
+			if (_s >= 0 && _s != nic_socket) {
+				WARNF("DPDK port %d is on socket %d, parsers follow socket %d.",
+					  p_dev->getDeviceId(), _s, nic_socket);
+			}
+		}
+		if (verbose) {
+			LOGF("NIC on socket %d, placing parsers on it first.", nic_socket);
+		}
+
+		if (!topology.place_workers(p_configure_param->master_core, nic_socket,
+									p_configure_param->core_use_for_parser,
+									p_configure_param->core_use_for_analyze,
+									parser_core_ids, analyzer_core_ids)) {
+			return false;
+		}
+	} else {
+		// contiguous cores: the lowest worker cores parse, the following ones analyze
+		vector<SystemCore> worker_cores;
+		createCoreVectorFromCoreMask(
+			mask_all_used_core & ~(DpdkDeviceList::getInstance().getDpdkMasterCore().Mask),
+			worker_cores);
+		if (worker_cores.size() <
+				(size_t) p_configure_param->core_use_for_parser + p_configure_param->core_use_for_analyze) {
+			WARN("Not enough cores for the requested workers.");
+			return false;
+		}
+		for (size_t i = 0; i < worker_cores.size(); i ++) {
+			if (i < p_configure_param->core_use_for_parser) {
+				parser_core_ids.push_back(worker_cores[i].Id);
+			} else if (analyzer_core_ids.size() < p_configure_param->core_use_for_analyze) {
+				analyzer_core_ids.push_back(worker_cores[i].Id);
+			}
+		}
+	}
+
+	// DPDK launches the workers of a mask in ascending core order
+	sort(parser_core_ids.begin(), parser_core_ids.end());
+	sort(analyzer_core_ids.begin(), analyzer_core_ids.end());
+
+	if (verbose) {
+		stringstream ss;
+		ss << "Parser cores: [";
+		for (const auto id: parser_core_ids) ss << id << ", ";
+		ss << "], Analyzer cores: [";
+		for (const auto id: analyzer_core_ids) ss << id << ", ";
+		ss << "]";
+		LOGF("%s", ss.str().c_str());
+	}
+	return true;
+}
+
+auto DeviceConfig::do_init() -> bool {
 	LOGF("Configure Whisper runtime environment.");
 
 	static const auto _f_check_device_configure_param =
@@ -339,6 +717,43 @@ void DeviceConfig::do_init() {
 		createCoreVectorFromCoreMask(all_core_mask, all_core);
 		size_t all_core_num = all_core.size();
 
+		if (p_param->core_use_for_analyze == 0 || p_param->core_use_for_parser == 0) {
+			WARN("Needed at least one parser and one analyzer core.");
+			return false;
+		}
+		if (p_param->master_core >= MAX_NUM_OF_CORES ||
+				(all_core_mask & SystemCores::IdToSystemCore[p_param->master_core].Mask) == 0) {
+			WARN("Invalid DPDK master core.");
+			return false;
+		}
+
+		if (p_param->has_core_list()) {
+			set<cpu_core_id_t> _used = {p_param->master_core};
+			for (const auto & _list: {p_param->parser_core_list, p_param->analyzer_core_list}) {
+				for (const auto id: _list) {
+					if (id >= MAX_NUM_OF_CORES ||
+							(all_core_mask & SystemCores::IdToSystemCore[id].Mask) == 0) {
+						WARNF("Core %d not available (Libpcapplusplus supports %d cores).",
+							  id, MAX_NUM_OF_CORES);
+						return false;
+					}
+					if (!_used.insert(id).second) {
+						WARNF("Core %d assigned twice.", id);
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		if (p_param->auto_placement) {
+			if (all_core_num < 1u + p_param->core_use_for_analyze + p_param->core_use_for_parser) {
+				WARN("Exceed all system core number.");
+				return false;
+			}
+			return true;
+		}
+
 		if (all_core_num < p_param->core_num) {
 			WARN("Exceed all system core number.");
 			return false;
@@ -351,12 +766,12 @@ void DeviceConfig::do_init() {
 			WARN("Needed minimum of 2 cores to start the application.");
 			return false;
 		}
-		if (p_param->core_num < p_param->core_use_for_analyze + p_param->core_use_for_parser) {
+		if (p_param->core_num < p_param->core_use_for_analyze + p_param->core_use_for_parser + 1) {
 			WARN("Core number conflicts.");
 			return false;
 		}
-		if (p_param->core_use_for_analyze % p_param->core_use_for_parser != 0) {
-			WARN("Imbalanced core numbers for analyzer and parser.");
+		if (p_param->master_core >= p_param->core_num) {
+			WARN("Master core out of the contiguous core range.");
 			return false;
 		}
 		return true;
@@ -369,29 +784,37 @@ void DeviceConfig::do_init() {
 	// configure PcapPlusPlus Log Error Level
 	Logger::getInstance().setAllModlesToLogLevel(Logger::LogLevel::Info);
 
-	// use 1 core for DPDK master and 17 cores for workers
-	vector<SystemCore> cores_to_use;
-	CoreMask core_mask_to_use = (1 << p_configure_param->core_num) - 1;
+	// start the background writer of the hot path logs
+	AsyncLogger::get_instance().start();
+
+	// cores handed to DPDK: the master core plus every candidate worker core
+	CoreMask core_mask_to_use = used_core_mask();
 
 	// configure DPDK
 	const auto device_list = this->configure_dpdk_nic(core_mask_to_use);
 
 	// prepare configuration for every core
-	CoreMask core_without_master =
-		core_mask_to_use & ~(DpdkDeviceList::getInstance().getDpdkMasterCore().Mask);
-	CoreMask core_mask_parser =
-		core_without_master & ((1 << (1 + p_configure_param->core_use_for_analyze)) - 1);
-	CoreMask core_mask_analyzer = core_without_master & ~core_mask_parser;
+	vector<cpu_core_id_t> parser_core_ids, analyzer_core_ids;
+	if (!place_worker_cores(device_list, core_mask_to_use, parser_core_ids, analyzer_core_ids)) {
+		FATAL_ERROR("Worker core placement failed.");
+	}
 
 	vector<SystemCore> core_parser;
-	createCoreVectorFromCoreMask(core_mask_parser, core_parser);
 	vector<SystemCore> core_analyzer;
-	createCoreVectorFromCoreMask(core_mask_analyzer, core_analyzer);
+	CoreMask core_mask_parser = 0, core_mask_analyzer = 0;
+	for (const auto id: parser_core_ids) {
+		core_parser.push_back(SystemCores::IdToSystemCore[id]);
+		core_mask_parser |= SystemCores::IdToSystemCore[id].Mask;
+	}
+	for (const auto id: analyzer_core_ids) {
+		core_analyzer.push_back(SystemCores::IdToSystemCore[id]);
+		core_mask_analyzer |= SystemCores::IdToSystemCore[id].Mask;
+	}
+	CoreMask core_without_master = core_mask_parser | core_mask_analyzer;
 
 	assert((core_mask_analyzer & core_mask_parser) == 0);
-	assert(core_mask_analyzer | core_mask_parser == core_without_master);
-	assert(core_mask_analyzer | core_mask_parser |
-		   DpdkDeviceList::getInstance().getDpdkMasterCore().Mask == core_mask_to_use);
+	assert((core_without_master & DpdkDeviceList::getInstance().getDpdkMasterCore().Mask) == 0);
+	assert((core_without_master & ~core_mask_to_use) == 0);
 
 	assign_queue_t nic_queue_assign = assign_queue_to_parser(device_list, core_parser);
 
@@ -456,21 +879,24 @@ void DeviceConfig::do_init() {
 			}
 
 		#else
-			vector<DpdkWorkerThread *> _thread_vec_all;
-
-			transform(
-				parser_thread_vec.cbegin(),
-				parser_thread_vec.cend(),
-				back_inserter(_thread_vec_all),
-				[] (decltype(parser_thread_vec)::value_type _p) ->
-					DpdkWorkerThread * {return _p.get(); });
+			// DPDK assigns the threads to the cores of the mask in ascending order,
+			// parser and analyzer cores may interleave
+			vector<pair<cpu_core_id_t, DpdkWorkerThread *> > _thread_core_vec;
+			for (size_t i = 0; i < parser_thread_vec.size(); i ++) {
+				_thread_core_vec.push_back({core_parser[i].Id, parser_thread_vec[i].get()});
+			}
+			for (size_t i = 0; i < analyzer_thread_vec.size(); i ++) {
+				_thread_core_vec.push_back({core_analyzer[i].Id, analyzer_thread_vec[i].get()});
+			}
+			sort(_thread_core_vec.begin(), _thread_core_vec.end(),
+				 [] (const pair<cpu_core_id_t, DpdkWorkerThread *> & a,
+					 const pair<cpu_core_id_t, DpdkWorkerThread *> & b) {
+					return a.first < b.first; });
 
-			transform(
-				analyzer_thread_vec.cbegin(),
-				analyzer_thread_vec.cend(),
-				back_inserter(_thread_vec_all),
-				[] (decltype(analyzer_thread_vec)::value_type _p) ->
-					DpdkWorkerThread * {return _p.get(); });
+			vector<DpdkWorkerThread *> _thread_vec_all;
+			for (const auto & ref: _thread_core_vec) {
+				_thread_vec_all.push_back(ref.second);
+			}
 
 			assert(core_parser.size() + core_analyzer.size() == _thread_vec_all.size());
 
@@ -485,9 +911,23 @@ void DeviceConfig::do_init() {
 	ThreadStateManagement args(parser_thread_vec, analyzer_thread_vec);
 	ApplicationEventHandler::getInstance().onApplicationInterrupted(interrupt_callback, &args);
 
+	// SIGUSR1 toggles the stage latency histograms of every worker
+	signal(SIGUSR1, [] (int) -> void {
+		StageProfiler::set_enabled(!StageProfiler::is_enabled());
+	});
+
+	if (run_hooks.on_start) {
+		run_hooks.on_start(args);
+	}
+
 	while (!args.stop) {
-		multiPlatformSleep(5);
+		usleep(100000);
+		if (run_hooks.on_tick && !run_hooks.on_tick(args)) {
+			args.stop = true;
+		}
 	}
+
+	return drain_and_shutdown(args);
 }
 
 auto DeviceConfig::configure_via_json(const json & jin) -> bool {
@@ -523,6 +963,15 @@ auto DeviceConfig::configure_via_json(const json & jin) -> bool {
 		} else {
 			WARN("Parser configuration not found, use default.");
 		}
+		if (jin.find("Verdict") != jin.end()) {
+			j_cfg_verdict = jin["Verdict"];
+		}
+		if (jin.find("Logger") != jin.end()) {
+			j_cfg_logger = jin["Logger"];
+			if (!AsyncLogger::get_instance().configure_via_json(j_cfg_logger)) {
+				WARN("Logger configuration invalid, use default.");
+			}
+		}
 
 		const auto & dpdk_config = jin["DPDK"];
 		if (dpdk_config.count("number_rx_queue")) {
@@ -547,6 +996,47 @@ auto DeviceConfig::configure_via_json(const json & jin) -> bool {
 				static_cast<cpu_core_id_t>(dpdk_config["core_num"]);
 		}
 
+		// core placement
+		const auto _f_core_list = [] (const json & _j) -> vector<cpu_core_id_t> {
+			if (_j.is_string()) {
+				return CpuTopology::parse_cpu_list(_j);
+			}
+			vector<cpu_core_id_t> ret;
+			for (const auto & id: _j) {
+				ret.push_back(static_cast<cpu_core_id_t>(id));
+			}
+			return ret;
+		};
+		if (dpdk_config.count("master_core")) {
+			_device_param->master_core =
+				static_cast<cpu_core_id_t>(dpdk_config["master_core"]);
+		}
+		if (dpdk_config.count("parser_cores") && dpdk_config.count("analyzer_cores")) {
+			_device_param->parser_core_list = _f_core_list(dpdk_config["parser_cores"]);
+			_device_param->analyzer_core_list = _f_core_list(dpdk_config["analyzer_cores"]);
+			_device_param->core_use_for_parser = _device_param->parser_core_list.size();
+			_device_param->core_use_for_analyze = _device_param->analyzer_core_list.size();
+		} else if (dpdk_config.count("parser_cores") || dpdk_config.count("analyzer_cores")) {
+			WARN("Both parser_cores and analyzer_cores are needed, ignore the core lists.");
+		}
+		if (dpdk_config.count("auto_placement")) {
+			_device_param->auto_placement = dpdk_config["auto_placement"];
+		}
+		if (dpdk_config.count("shutdown_deadline")) {
+			_device_param->shutdown_deadline =
+				static_cast<decltype(_device_param->shutdown_deadline)>(dpdk_config["shutdown_deadline"]);
+			if (_device_param->shutdown_deadline <= 0) {
+				throw logic_error("Parse error Json tag: shutdown_deadline\n");
+			}
+		}
+
+		if (dpdk_config.count("eal_args")) {
+			_device_param->eal_args.clear();
+			for (const auto & a: dpdk_config["eal_args"]) {
+				_device_param->eal_args.push_back(static_cast<string>(a));
+			}
+		}
+
 		if (dpdk_config.count("verbose")) {
 			verbose = dpdk_config["verbose"];
 		}
@@ -3,6 +3,8 @@
 #include "parserWorker.hpp"
 #include "kMeansLearner.hpp"
 #include "analyzerWorker.hpp"
+#include "asyncLogger.hpp"
+#include "cpuTopology.hpp"
 #include "dpdkCommon.hpp"
 
 #define DISP_PARAM
@@ -24,6 +26,20 @@ struct DeviceConfigParam final {
     cpu_core_id_t core_use_for_parser = 2;
     cpu_core_id_t core_num = 5;
 
+    // DPDK master core, never runs a worker
+    cpu_core_id_t master_core = 0;
+    // Explicit placement, the list sizes override core_use_for_*
+    vector<cpu_core_id_t> parser_core_list;
+    vector<cpu_core_id_t> analyzer_core_list;
+    // Place the workers from the CPU and NIC topology in sysfs
+    bool auto_placement = false;
+
+    // Upper bound of the drain-and-flush shutdown (s)
+    double_t shutdown_deadline = 10.0;
+
+    // Extra EAL arguments, e.g. --no-huge, --no-pci, --vdev=net_ring0
+    vector<string> eal_args;
+
     vector<nic_port_id_t> dpdk_port_vec;
 
     auto inline display_params() const -> void {
@@ -40,8 +56,29 @@ struct DeviceConfigParam final {
         ss << "]";
         printf("%s\n", ss.str().c_str());
 
-        printf("Num. Core packet parsing: %d, Num. Core analyze: %d. [Sum core used: %d]\n\n"
-        , core_use_for_analyze, core_use_for_parser, core_num);
+        printf("Num. Core packet parsing: %d, Num. Core analyze: %d. [Sum core used: %d]\n"
+        , core_use_for_parser, core_use_for_analyze, core_num);
+
+        if (parser_core_list.size()) {
+            printf("Core placement: explicit, master core: %d\n", master_core);
+        } else if (auto_placement) {
+            printf("Core placement: topology aware, master core: %d\n", master_core);
+        } else {
+            printf("Core placement: contiguous, master core: %d\n", master_core);
+        }
+        if (eal_args.size()) {
+            stringstream ss_eal;
+            for (const auto & a: eal_args) {
+                ss_eal << a << " ";
+            }
+            printf("EAL arguments: %s\n", ss_eal.str().c_str());
+        }
+        printf("Shutdown deadline: %4.2lfs\n\n", shutdown_deadline);
+    }
+
+    // Explicit placement is given
+    auto inline has_core_list() const -> bool {
+        return parser_core_list.size() != 0 && analyzer_core_list.size() != 0;
     }
 
     DeviceConfigParam() {}
@@ -52,7 +89,8 @@ struct DeviceConfigParam final {
 
 struct ThreadStateManagement final {
 
-	bool stop = true;
+	// Set by the interrupt callback, the shutdown itself runs on the main thread
+	volatile bool stop = true;
 
 	vector<shared_ptr<ParserWorkerThread> > parser_worker_thread_vec;
     vector<shared_ptr<AnalyzerWorkerThread> > analyzer_worker_thread_vec;
@@ -68,6 +106,16 @@ struct ThreadStateManagement final {
                                   analyzer_worker_thread_vec(_a_vec), stop(false) {}
 };
 
+// Callbacks of a program embedding Whisper (e.g. the throughput harness), run on the master core
+struct RunHooks final {
+    // Every worker is started
+    function<void(const ThreadStateManagement &)> on_start;
+    // Every 100 ms while running, false starts the shutdown
+    function<bool(const ThreadStateManagement &)> on_tick;
+    // Workers drained and joined, results flushed
+    function<void(const ThreadStateManagement &)> on_stop;
+};
+
 class DeviceConfig final {
 
     private:
@@ -81,9 +129,20 @@ class DeviceConfig final {
         bool verbose = true;
         mutable bool dpdk_init_once = false;
 
-        // 3 helper for do_init
+        RunHooks run_hooks;
+
+        // 5 helper for do_init
+        auto used_core_mask() const -> CoreMask;
+        // DPDK EAL with the configured extra arguments, once per process
+        void init_dpdk_once(const CoreMask mask) const;
+
         auto configure_dpdk_nic(const CoreMask mask_all_used_core) const -> device_list_t;
 
+        auto place_worker_cores(const device_list_t & dev_list,
+                                const CoreMask mask_all_used_core,
+                                vector<cpu_core_id_t> & parser_core_ids,
+                                vector<cpu_core_id_t> & analyzer_core_ids) const -> bool;
+
         auto assign_queue_to_parser(const device_list_t & dev_list,
                                     const vector<SystemCore> & cores_parser) const ->
                                         assign_queue_t;
@@ -95,9 +154,21 @@ class DeviceConfig final {
 
         static void interrupt_callback(void* cookie);
 
+        // Stop RX, drain the rings, final pass, join and flush, bounded by shutdown_deadline
+        // False when the run missed its detection latency objective
+        auto drain_and_shutdown(const ThreadStateManagement & args) const -> bool;
+        void print_overall_performance(const ThreadStateManagement & args) const;
+        void report_stage_latency(const ThreadStateManagement & args) const;
+        // Wire-to-verdict latency per analyzer and merged, false when the SLO is missed
+        auto report_detection_latency(const ThreadStateManagement & args) const -> bool;
+        // Labeled accuracy, whole run and last window
+        void report_accuracy(const ThreadStateManagement & args) const;
+
         json j_cfg_analyzer;
         json j_cfg_kmeans;
         json j_cfg_parser;
+        json j_cfg_logger;
+        json j_cfg_verdict;
 
     public:
         // Default constructor
@@ -124,8 +195,18 @@ class DeviceConfig final {
         // List all of avaliable DPDK ports
         void list_dpdk_ports() const;
 
-        // Do init after all configures are done
-        void do_init();
+        // Do init after all configures are done, false when the run missed its
+        // detection latency objective
+        auto do_init() -> bool;
+
+        // A core of the master or of a worker after configure_via_json. The workers of a
+        // topology aware placement are only known in do_init: the master core only then.
+        auto is_whisper_core(cpu_core_id_t id) const -> bool;
+
+        // Install before do_init
+        void set_run_hooks(const RunHooks & hooks) {
+            run_hooks = hooks;
+        }
 
         // Config form json file
         auto configure_via_json(const json & jin) -> bool;
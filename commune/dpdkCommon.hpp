@@ -80,4 +80,10 @@ struct PktMetadata final {
     PktMetadata(const PktMetadata &) = default;
 };
 
+// Map a source address to one of n analyzers, every parser must agree on it
+static inline auto flow_shard_of(uint32_t ip_src, size_t n) -> size_t {
+	const uint32_t h = ip_src * 0x9E3779B1u;
+	return (size_t) (((uint64_t) h * (uint64_t) n) >> 32);
+}
+
 }
@@ -0,0 +1,282 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace std;
+
+namespace Whisper {
+
+// Packet weighted detection metrics over flow verdicts. A flow of packet_num packets
+// counts as packet_num samples of its distance, without expanding it.
+
+// Weight of the benign (neg) and malicious (pos) packets at one score
+struct WeightedScore final {
+    double_t score;
+    double_t pos;
+    double_t neg;
+};
+
+// Collects weighted scores in one pass. Exact mode keeps one entry per distinct
+// score, binned mode (num_bins > 0) log-spaced bins over [0, max_score] in O(num_bins).
+class WeightedScoreAccumulator final {
+
+    private:
+        const size_t num_bins;
+        const double_t max_score;
+        const double_t threshold;
+
+        vector<WeightedScore> scores;
+        size_t compacted_size = 0;
+        bool binned_sorted = false;
+        // Confusion matrix at threshold, exact in both modes
+        double_t tp = 0, fp = 0, tn = 0, fn = 0;
+        uint64_t record_num = 0, invalid_num = 0;
+
+        auto inline bin_of(double_t score) const -> size_t {
+            const double_t x = log1p(max(score, 0.0)) / log1p(max_score);
+            return min(num_bins - 1, (size_t) (x * num_bins));
+        }
+
+        auto inline bin_score(size_t i) const -> double_t {
+            return expm1(((double_t) i) / num_bins * log1p(max_score));
+        }
+
+    public:
+        WeightedScoreAccumulator(double_t _threshold, size_t _bins = 0, double_t _max = 1e12):
+                num_bins(_bins), max_score(max(_max, 1.0)), threshold(_threshold) {
+            if (num_bins) {
+                scores.resize(num_bins);
+                for (size_t i = 0; i < num_bins; i ++) {
+                    scores[i] = {bin_score(i), 0, 0};
+                }
+            }
+        }
+
+        virtual ~WeightedScoreAccumulator() {}
+        WeightedScoreAccumulator & operator=(const WeightedScoreAccumulator &) = delete;
+        WeightedScoreAccumulator(const WeightedScoreAccumulator &) = delete;
+        WeightedScoreAccumulator(WeightedScoreAccumulator &&) = default;
+
+        void add(double_t score, bool positive, double_t weight) {
+            if (std::isnan(score) || weight <= 0) {
+                ++ invalid_num;
+                return;
+            }
+            ++ record_num;
+            const bool alarm = score > threshold;
+            if (positive) {
+                (alarm ? tp : fn) += weight;
+            } else {
+                (alarm ? fp : tn) += weight;
+            }
+
+            if (num_bins) {
+                auto & b = scores[bin_of(score)];
+                (positive ? b.pos : b.neg) += weight;
+                return;
+            }
+            scores.push_back({score, positive ? weight : 0, positive ? 0 : weight});
+            // bound the memory of repeated scores
+            if (scores.size() >= max<size_t>(2 * compacted_size, 1 << 20)) {
+                compact();
+            }
+        }
+
+        // Sort by descending score and merge equal scores
+        void compact() {
+            if (num_bins) {
+                return;
+            }
+            sort(scores.begin(), scores.end(), [] (const WeightedScore & a, const WeightedScore & b) -> bool {
+                return a.score > b.score;
+            });
+            size_t j = 0;
+            for (size_t i = 0; i < scores.size(); i ++) {
+                if (j && scores[j - 1].score == scores[i].score) {
+                    scores[j - 1].pos += scores[i].pos;
+                    scores[j - 1].neg += scores[i].neg;
+                } else {
+                    scores[j ++] = scores[i];
+                }
+            }
+            scores.resize(j);
+            compacted_size = j;
+        }
+
+        // Accumulators of the other threads, with the same mode
+        void merge(const WeightedScoreAccumulator & other) {
+            if (num_bins) {
+                for (size_t i = 0; i < num_bins && i < other.scores.size(); i ++) {
+                    scores[i].pos += other.scores[i].pos;
+                    scores[i].neg += other.scores[i].neg;
+                }
+            } else {
+                scores.insert(scores.end(), other.scores.begin(), other.scores.end());
+            }
+            tp += other.tp, fp += other.fp, tn += other.tn, fn += other.fn;
+            record_num += other.record_num;
+            invalid_num += other.invalid_num;
+        }
+
+        // Descending scores, every entry a distinct threshold
+        auto sorted() -> const vector<WeightedScore> & {
+            if (num_bins && !binned_sorted) {
+                binned_sorted = true;
+                reverse(scores.begin(), scores.end());
+                scores.erase(remove_if(scores.begin(), scores.end(), [] (const WeightedScore & s) -> bool {
+                    return s.pos == 0 && s.neg == 0;
+                }), scores.end());
+            } else if (!num_bins) {
+                compact();
+            }
+            return scores;
+        }
+
+        auto inline get_confusion() const -> array<double_t, 4> {
+            return {tp, fp, tn, fn};
+        }
+        auto inline get_record_num() const -> uint64_t {
+            return record_num;
+        }
+        auto inline get_invalid_num() const -> uint64_t {
+            return invalid_num;
+        }
+};
+
+struct EvaluationResult final {
+    uint64_t records = 0;
+    double_t pos_weight = 0, neg_weight = 0;
+    double_t roc_auc = 0, pr_auc = 0;
+    // Rate where FPR equals FNR, linearly interpolated
+    double_t eer = 0;
+    double_t at_fpr = 0.1, tpr_at_fpr = 0;
+    double_t at_tpr = 0.9, fpr_at_tpr = 0;
+    // At the alarm threshold: malicious class, and the macro average of both classes
+    double_t threshold = 6;
+    double_t precision = 0, recall = 0, f1 = 0, f2 = 0;
+    double_t f1_macro = 0, f2_macro = 0;
+    // (fpr, tpr) of every threshold
+    vector<pair<double_t, double_t> > roc;
+
+    auto to_json(size_t max_roc_points = 1000) const -> json {
+        json j;
+        j["records"] = records;
+        j["malicious_packets"] = pos_weight;
+        j["benign_packets"] = neg_weight;
+        j["roc_auc"] = roc_auc;
+        j["pr_auc"] = pr_auc;
+        j["eer"] = eer;
+        j["tpr_at_fpr"] = {{"fpr", at_fpr}, {"tpr", tpr_at_fpr}};
+        j["fpr_at_tpr"] = {{"tpr", at_tpr}, {"fpr", fpr_at_tpr}};
+        j["threshold"] = threshold;
+        j["precision"] = precision;
+        j["recall"] = recall;
+        j["f1"] = f1;
+        j["f2"] = f2;
+        j["f1_macro"] = f1_macro;
+        j["f2_macro"] = f2_macro;
+        // thinned for plotting
+        const size_t step = max<size_t>(1, roc.size() / max<size_t>(max_roc_points, 1));
+        json j_roc = json::array();
+        for (size_t i = 0; i < roc.size(); i += step) {
+            j_roc.push_back({roc[i].first, roc[i].second});
+        }
+        if (roc.size() && (roc.size() - 1) % step) {
+            j_roc.push_back({roc.back().first, roc.back().second});
+        }
+        j["roc"] = j_roc;
+        return j;
+    }
+};
+
+static inline auto f_beta(double_t p, double_t r, double_t beta) -> double_t {
+    const double_t b2 = beta * beta;
+    return (p + r) > 0 ? (1 + b2) * p * r / (b2 * p + r) : 0;
+}
+
+// Linear interpolation of y at x on a curve of ascending x
+static inline auto interpolate_at(const vector<pair<double_t, double_t> > & curve, double_t x,
+                                  bool swap_axes = false) -> double_t {
+    auto _x = [swap_axes] (const pair<double_t, double_t> & p) { return swap_axes ? p.second : p.first; };
+    auto _y = [swap_axes] (const pair<double_t, double_t> & p) { return swap_axes ? p.first : p.second; };
+    for (size_t i = 1; i < curve.size(); i ++) {
+        if (_x(curve[i]) >= x) {
+            const double_t dx = _x(curve[i]) - _x(curve[i - 1]);
+            if (dx <= 0) {
+                return _y(curve[i]);
+            }
+            return _y(curve[i - 1]) + (_y(curve[i]) - _y(curve[i - 1])) * (x - _x(curve[i - 1])) / dx;
+        }
+    }
+    return curve.empty() ? 0 : _y(curve.back());
+}
+
+// One pass over the descending scores
+static inline auto evaluate_scores(WeightedScoreAccumulator & acc, double_t threshold,
+                                   double_t at_fpr, double_t at_tpr) -> EvaluationResult {
+    EvaluationResult res;
+    res.threshold = threshold;
+    res.at_fpr = at_fpr;
+    res.at_tpr = at_tpr;
+    res.records = acc.get_record_num();
+
+    const auto & scores = acc.sorted();
+    for (const auto & s: scores) {
+        res.pos_weight += s.pos;
+        res.neg_weight += s.neg;
+    }
+    if (res.pos_weight == 0 || res.neg_weight == 0) {
+        WARN("Evaluation: only one class present, ROC undefined.");
+    }
+    const double_t _p = max(res.pos_weight, 1e-300), _n = max(res.neg_weight, 1e-300);
+
+    // ties advance both rates at once: trapezoids give the Mann-Whitney statistic
+    double_t tp = 0, fp = 0;
+    res.roc.reserve(scores.size() + 1);
+    res.roc.emplace_back(0, 0);
+    for (const auto & s: scores) {
+        const double_t _tpr0 = tp / _p, _fpr0 = fp / _n;
+        tp += s.pos;
+        fp += s.neg;
+        const double_t _tpr = tp / _p, _fpr = fp / _n;
+        res.roc_auc += (_fpr - _fpr0) * (_tpr + _tpr0) / 2;
+        // average precision: precision at every recall step
+        if (s.pos > 0) {
+            res.pr_auc += (_tpr - _tpr0) * tp / (tp + fp);
+        }
+        res.roc.emplace_back(_fpr, _tpr);
+    }
+
+    res.tpr_at_fpr = interpolate_at(res.roc, at_fpr);
+    res.fpr_at_tpr = interpolate_at(res.roc, at_tpr, true);
+
+    // EER where fpr + tpr crosses 1
+    for (size_t i = 1; i < res.roc.size(); i ++) {
+        const double_t d0 = res.roc[i - 1].first + res.roc[i - 1].second - 1;
+        const double_t d1 = res.roc[i].first + res.roc[i].second - 1;
+        if (d0 <= 0 && d1 >= 0) {
+            const double_t t = d1 > d0 ? -d0 / (d1 - d0) : 0;
+            res.eer = res.roc[i - 1].first + t * (res.roc[i].first - res.roc[i - 1].first);
+            break;
+        }
+    }
+
+    const auto c = acc.get_confusion();
+    const double_t tp_t = c[0], fp_t = c[1], tn_t = c[2], fn_t = c[3];
+    res.precision = (tp_t + fp_t) > 0 ? tp_t / (tp_t + fp_t) : 0;
+    res.recall = (tp_t + fn_t) > 0 ? tp_t / (tp_t + fn_t) : 0;
+    const double_t _neg_precision = (tn_t + fn_t) > 0 ? tn_t / (tn_t + fn_t) : 0;
+    const double_t _neg_recall = (tn_t + fp_t) > 0 ? tn_t / (tn_t + fp_t) : 0;
+    res.f1 = f_beta(res.precision, res.recall, 1);
+    res.f2 = f_beta(res.precision, res.recall, 2);
+    res.f1_macro = (res.f1 + f_beta(_neg_precision, _neg_recall, 1)) / 2;
+    res.f2_macro = (res.f2 + f_beta(_neg_precision, _neg_recall, 2)) / 2;
+    return res;
+}
+
+}
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "../common.hpp"
+#include "waveKernels.hpp"
+
+#include <random>
+#include <vector>
+
+using namespace std;
+
+namespace Whisper {
+
+// Bound of the samples a flow holds for one verdict
+using flow_sampling_t = uint8_t;
+enum flow_sampling : flow_sampling_t {
+    // every stride-th packet, the stride doubles each time the cap is reached
+    FLOW_SAMPLING_SYSTEMATIC = 0,
+    // uniform over the packets since the last verdict, in arrival order
+    FLOW_SAMPLING_RESERVOIR = 1,
+    // every packet, a verdict per cap packets; a backlog over one more segment is dropped
+    FLOW_SAMPLING_SEGMENT = 2
+};
+
+static const map<string, flow_sampling_t> flow_sampling_map = {
+    {"systematic", FLOW_SAMPLING_SYSTEMATIC},
+    {"reservoir", FLOW_SAMPLING_RESERVOIR},
+    {"segment", FLOW_SAMPLING_SEGMENT}
+};
+
+auto static inline flow_sampling_name(flow_sampling_t p) -> const char * {
+    return p == FLOW_SAMPLING_RESERVOIR ? "reservoir" : (p == FLOW_SAMPLING_SEGMENT ? "segment" : "systematic");
+}
+
+// Applied to the packets a batch appended to a flow, before they are transformed. The
+// batch transform holds every packet of a flow until its verdict, the incremental one
+// the packets of the batch only: the cap bounds either, so the work per flow and batch
+// stays O(cap) however many packets a source sends.
+class FlowSampler final {
+
+    private:
+        flow_sampling_t policy = FLOW_SAMPLING_SYSTEMATIC;
+        // 0 for no cap
+        size_t cap = 0;
+        mt19937_64 gen;
+        vector<float> arrivals;
+
+        // Systematic: the arrivals off the stride are skipped, and the samples are halved
+        // with a doubled stride until they fit
+        void decimate(FlowState & state, size_t first) {
+            size_t w = first;
+            for (size_t i = first; i < state.values.size(); i ++) {
+                if (state.sample_skip == 0) {
+                    state.values[w ++] = state.values[i];
+                    state.sample_skip = state.sample_stride - 1;
+                } else {
+                    state.sample_skip --;
+                }
+            }
+            state.values.resize(w);
+            while (state.values.size() > cap) {
+                // the next sample is one new stride after the last one kept
+                if (state.values.size() % 2 == 1) {
+                    state.sample_skip += state.sample_stride;
+                }
+                size_t h = 0;
+                for (size_t i = 0; i < state.values.size(); i += 2) {
+                    state.values[h ++] = state.values[i];
+                }
+                state.values.resize(h);
+                state.sample_stride *= 2;
+            }
+        }
+
+        // Reservoir: the i-th packet since the verdict replaces a random sample with
+        // probability cap / i, the others move up to keep the arrival order
+        void reservoir(FlowState & state, size_t first, uint64_t seen) {
+            arrivals.assign(state.values.begin() + first, state.values.end());
+            state.values.resize(first);
+            for (const auto v: arrivals) {
+                seen ++;
+                if (state.values.size() < cap) {
+                    state.values.push_back(v);
+                    continue;
+                }
+                const uint64_t r = gen() % seen;
+                if (r < cap) {
+                    state.values.erase(state.values.begin() + r);
+                    state.values.push_back(v);
+                }
+            }
+        }
+
+    public:
+        FlowSampler() = default;
+        virtual ~FlowSampler() {}
+        FlowSampler & operator=(const FlowSampler &) = delete;
+        FlowSampler(const FlowSampler &) = delete;
+
+        void configure(flow_sampling_t _policy, size_t _cap, uint64_t seed) {
+            policy = _policy;
+            cap = _cap;
+            gen.seed(seed);
+        }
+
+        auto inline is_enabled() const -> bool {
+            return cap != 0;
+        }
+
+        // The packets appended since the last call are the tail of the flow; with
+        // incremental set the samples before them were transformed already
+        void apply(FlowState & state, bool incremental) {
+            const size_t new_num = state.packet_num - state.sampled_num;
+            const size_t first = state.values.size() - new_num;
+            const uint64_t seen = state.sampled_num - state.reported_num;
+            state.sampled_num = state.packet_num;
+            if (cap != 0 && state.values.size() > cap) {
+                // the earlier samples of an incremental flow are transformed already
+                if (incremental || policy == FLOW_SAMPLING_SYSTEMATIC) {
+                    decimate(state, first);
+                } else if (policy == FLOW_SAMPLING_RESERVOIR) {
+                    reservoir(state, first, seen);
+                } else if (state.values.size() > 2 * cap) {
+                    state.values.resize(2 * cap);
+                }
+            } else if (state.sample_stride > 1) {
+                decimate(state, first);
+            }
+            state.sample_num = state.sample_num - first + state.values.size();
+        }
+
+        // Samples of the next verdict of a flow, the first segment under the segment policy
+        auto inline verdict_len(const FlowState & state) const -> size_t {
+            if (cap != 0 && policy == FLOW_SAMPLING_SEGMENT) {
+                return min(state.values.size(), cap);
+            }
+            return state.values.size();
+        }
+
+        // Packets the verdict on the first len samples covers: a segment leaves the packets
+        // of its successors, the others cover every packet since the last verdict
+        auto inline verdict_packets(const FlowState & state, size_t len) const -> uint64_t {
+            return state.packet_num - state.reported_num - (state.values.size() - len);
+        }
+
+        // After the verdict on the first len samples, the rest waits for the next one
+        void cut(FlowState & state, size_t len) {
+            state.values.erase(state.values.begin(), state.values.begin() + len);
+            state.reported_num = state.packet_num - state.values.size();
+            state.sample_num = state.values.size();
+        }
+};
+
+}
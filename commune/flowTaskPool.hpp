@@ -0,0 +1,143 @@
+#pragma once
+
+#include "../common.hpp"
+#include "centerStore.hpp"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace Whisper {
+
+// One ready flow of the batch STFT path, moved out of the flow map of its analyzer
+struct FlowTask final {
+    // Host byte order
+    uint32_t address = 0;
+    vector<float> values;
+    // Packets the verdict covers, and the samples of them analyzed
+    size_t packet_num = 0;
+    size_t sample_num = 0;
+    double_t last_ts = 0;
+    bool partial = false;
+    // Centers of the owner, read only once it left the training mode
+    const CenterStore * p_centers = nullptr;
+
+    // Filled by whichever analyzer ran the task, reference < 0 without validation
+    double_t distance = 0;
+    double_t reference = -1;
+
+    // Position in the deque of the owner, and done by some analyzer
+    uint64_t seq = 0;
+    bool finished = false;
+};
+
+// Per-analyzer deques of flow tasks. The owner takes its tasks from the front in the
+// order it queued them; an analyzer without work takes from the back of another deque.
+// The verdict of every task goes back to its owner, which alone emits results, in the
+// order it queued the tasks: a finished task waits for the stolen ones queued before it.
+class FlowTaskPool final {
+
+    private:
+        struct TaskQueue {
+            mutex lock;
+            deque<FlowTask> tasks;
+            // A slot per task queued and not collected yet, from seq release_seq on
+            deque<FlowTask> done;
+            uint64_t push_seq = 0;
+            uint64_t release_seq = 0;
+        };
+
+        vector<unique_ptr<TaskQueue> > queues;
+        atomic<uint64_t> stolen_num;
+
+    public:
+        explicit FlowTaskPool(size_t n) : stolen_num(0) {
+            for (size_t i = 0; i < n; i ++) {
+                queues.emplace_back(new TaskQueue());
+            }
+        }
+
+        virtual ~FlowTaskPool() {}
+        FlowTaskPool & operator=(const FlowTaskPool &) = delete;
+        FlowTaskPool(const FlowTaskPool &) = delete;
+
+        auto inline size() const -> size_t {
+            return queues.size();
+        }
+
+        void push(size_t owner, FlowTask && t) {
+            auto & q = *queues[owner];
+            lock_guard<mutex> guard(q.lock);
+            t.seq = q.push_seq ++;
+            t.finished = false;
+            q.tasks.push_back(std::move(t));
+            q.done.emplace_back();
+        }
+
+        auto pop(size_t owner, FlowTask & t) -> bool {
+            auto & q = *queues[owner];
+            lock_guard<mutex> guard(q.lock);
+            if (q.tasks.empty()) {
+                return false;
+            }
+            t = std::move(q.tasks.front());
+            q.tasks.pop_front();
+            return true;
+        }
+
+        // Newest task of the first busy analyzer after the thief, a busy deque is skipped
+        auto steal(size_t thief, FlowTask & t, size_t & victim) -> bool {
+            for (size_t k = 1; k < queues.size(); k ++) {
+                victim = (thief + k) % queues.size();
+                auto & q = *queues[victim];
+                unique_lock<mutex> guard(q.lock, try_to_lock);
+                if (!guard.owns_lock() || q.tasks.empty()) {
+                    continue;
+                }
+                t = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                stolen_num.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        void complete(size_t owner, FlowTask && t) {
+            auto & q = *queues[owner];
+            lock_guard<mutex> guard(q.lock);
+            const size_t pos = t.seq - q.release_seq;
+            t.finished = true;
+            q.done[pos] = std::move(t);
+        }
+
+        // Finished tasks of the owner up to the first one still queued or running,
+        // appended to out in the order they were queued
+        auto collect(size_t owner, vector<FlowTask> & out) -> size_t {
+            auto & q = *queues[owner];
+            lock_guard<mutex> guard(q.lock);
+            size_t n = 0;
+            while (!q.done.empty() && q.done.front().finished) {
+                out.push_back(std::move(q.done.front()));
+                q.done.pop_front();
+                q.release_seq ++;
+                n ++;
+            }
+            return n;
+        }
+
+        // Queued and not collected yet, the tasks running on a thief included
+        auto outstanding(size_t owner) -> size_t {
+            auto & q = *queues[owner];
+            lock_guard<mutex> guard(q.lock);
+            return q.done.size();
+        }
+
+        auto inline get_stolen_num() const -> uint64_t {
+            return stolen_num.load(std::memory_order_relaxed);
+        }
+};
+
+}
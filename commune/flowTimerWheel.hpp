@@ -0,0 +1,137 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <vector>
+
+using namespace std;
+
+namespace Whisper {
+
+// Idle expiry of the flows in the analyzer map, a hierarchical timer wheel: level i has
+// WHEEL_SLOTS slots of WHEEL_SLOTS^i ticks, and the entries of a higher level
+// slot are moved down when the lower levels wrap to it. Scheduling is O(1), and an entry
+// moves down at most WHEEL_LEVELS - 1 times before it fires.
+//
+// A flow is scheduled once when it is created and is never moved on a packet: the owner
+// checks its last activity when the entry fires and schedules it again if it was active,
+// so a packet costs nothing here and every flow is touched about once per timeout.
+class FlowTimerWheel final {
+
+    public:
+        static constexpr size_t WHEEL_BITS = 6;
+        static constexpr size_t WHEEL_SLOTS = (size_t) 1 << WHEEL_BITS;
+        // 2^24 ticks of horizon, later deadlines fire at the horizon and are rescheduled
+        static constexpr size_t WHEEL_LEVELS = 4;
+
+        // A flow and the generation it was created with, stale entries are skipped by the owner
+        struct Entry {
+            uint32_t key;
+            uint32_t gen;
+            // Absolute tick the entry fires at
+            uint64_t expire;
+        };
+
+    private:
+        vector<vector<Entry> > slots;
+        double_t tick = 1.0;
+        // Time of tick 0, and the last tick fired
+        double_t origin = 0;
+        uint64_t now_tick = 0;
+        size_t num = 0;
+
+        auto static inline slot_of(uint64_t t, size_t level) -> size_t {
+            return level * WHEEL_SLOTS + ((t >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1));
+        }
+
+        void inline insert(const Entry & e) {
+            const uint64_t d = e.expire - now_tick;
+            size_t level = 0;
+            while (level + 1 < WHEEL_LEVELS && d >= ((uint64_t) 1 << ((level + 1) * WHEEL_BITS))) {
+                level ++;
+            }
+            slots[slot_of(e.expire, level)].push_back(e);
+        }
+
+    public:
+        FlowTimerWheel() = default;
+        virtual ~FlowTimerWheel() {}
+        FlowTimerWheel & operator=(const FlowTimerWheel &) = delete;
+        FlowTimerWheel(const FlowTimerWheel &) = delete;
+
+        void configure(double_t _tick, double_t now) {
+            tick = _tick;
+            slots.assign(WHEEL_LEVELS * WHEEL_SLOTS, vector<Entry>());
+            origin = now;
+            now_tick = 0;
+            num = 0;
+        }
+
+        auto inline is_enabled() const -> bool {
+            return !slots.empty();
+        }
+
+        void inline schedule(uint32_t key, uint32_t gen, double_t deadline) {
+            const double_t ahead = ceil((deadline - origin) / tick);
+            const uint64_t max_ahead = ((uint64_t) 1 << (WHEEL_LEVELS * WHEEL_BITS)) - 1;
+            uint64_t expire = ahead > (double_t) now_tick ? (uint64_t) ahead : now_tick + 1;
+            expire = min(expire, now_tick + max_ahead);
+            insert({key, gen, expire});
+            num ++;
+        }
+
+        // Fire every entry that came due up to now, on_due(entry) may schedule again
+        template <typename F>
+        auto advance(double_t now, F on_due) -> size_t {
+            if (slots.empty()) {
+                return 0;
+            }
+            size_t fired = 0;
+            vector<Entry> due;
+            while (now - origin >= (now_tick + 1) * tick) {
+                now_tick ++;
+                // the slots of the higher levels that start at this tick move down first
+                for (size_t level = WHEEL_LEVELS - 1; level > 0; level --) {
+                    if ((now_tick & (((uint64_t) 1 << (level * WHEEL_BITS)) - 1)) != 0) {
+                        continue;
+                    }
+                    due.swap(slots[slot_of(now_tick, level)]);
+                    for (const auto & e: due) {
+                        insert(e);
+                    }
+                    due.clear();
+                }
+                // fired last: the moves above may land here, the callback never does
+                due.swap(slots[slot_of(now_tick, 0)]);
+                num -= due.size();
+                for (const auto & e: due) {
+                    on_due(e);
+                }
+                fired += due.size();
+                due.clear();
+            }
+            return fired;
+        }
+
+        void clear() {
+            for (auto & s: slots) {
+                s.clear();
+            }
+            num = 0;
+        }
+
+        auto inline size() const -> size_t {
+            return num;
+        }
+
+        // Bytes held by the slots, including the unused capacity
+        auto memory_bytes() const -> size_t {
+            size_t sum = slots.capacity() * sizeof(vector<Entry>);
+            for (const auto & s: slots) {
+                sum += s.capacity() * sizeof(Entry);
+            }
+            return sum;
+        }
+};
+
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <vector>
+
+using namespace std;
+
+namespace Whisper {
+
+// Packet rate of every source in a fixed amount of memory: a Count-Min sketch of
+// DEPTH rows with conservative update, so a source is never under-counted
+// and the estimate of a light source only grows with the counters it shares. The
+// counters are halved once per window: a source of r packets/s is estimated at between
+// r and 2r packets per window in steady state, a burst fades out in a few windows.
+class HeavyHitterSketch final {
+
+    public:
+        static constexpr size_t DEPTH = 4;
+
+    private:
+        vector<uint32_t> counters;
+        size_t width_bits = 0;
+        double_t window = 1.0;
+        double_t window_start = 0;
+
+        // Multiply-shift hash of one row, odd multipliers
+        auto inline cell(uint32_t key, size_t row) const -> size_t {
+            static const uint64_t seed[DEPTH] = {
+                0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full, 0x165667b19e3779f9ull, 0xd6e8feb86659fd93ull
+            };
+            const uint64_t h = (((uint64_t) key + 1) * seed[row]) >> (64 - width_bits);
+            return (row << width_bits) + (size_t) h;
+        }
+
+    public:
+        HeavyHitterSketch() = default;
+        virtual ~HeavyHitterSketch() {}
+        HeavyHitterSketch & operator=(const HeavyHitterSketch &) = delete;
+        HeavyHitterSketch(const HeavyHitterSketch &) = delete;
+
+        // width counters per row, rounded up to a power of two
+        void configure(size_t width, double_t _window, double_t now) {
+            width_bits = 1;
+            while (((size_t) 1 << width_bits) < width) {
+                width_bits ++;
+            }
+            counters.assign(DEPTH << width_bits, 0);
+            window = _window;
+            window_start = now;
+        }
+
+        auto inline is_enabled() const -> bool {
+            return !counters.empty();
+        }
+
+        // Count n packets of a source, returns its estimate including them
+        auto inline add(uint32_t key, uint32_t n) -> uint32_t {
+            size_t pos[DEPTH];
+            uint32_t est = numeric_limits<uint32_t>::max();
+            for (size_t row = 0; row < DEPTH; row ++) {
+                pos[row] = cell(key, row);
+                est = min(est, counters[pos[row]]);
+            }
+            est = est > numeric_limits<uint32_t>::max() - n ? numeric_limits<uint32_t>::max() : est + n;
+            // conservative update: the counters above the new estimate stay
+            for (size_t row = 0; row < DEPTH; row ++) {
+                counters[pos[row]] = max(counters[pos[row]], est);
+            }
+            return est;
+        }
+
+        auto inline estimate(uint32_t key) const -> uint32_t {
+            uint32_t est = numeric_limits<uint32_t>::max();
+            for (size_t row = 0; row < DEPTH; row ++) {
+                est = min(est, counters[cell(key, row)]);
+            }
+            return est;
+        }
+
+        // Halve the counters once per window that passed, returns the windows
+        auto decay(double_t now) -> size_t {
+            if (now - window_start < window) {
+                return 0;
+            }
+            const size_t n = (size_t) ((now - window_start) / window);
+            window_start += n * window;
+            const uint32_t shift = (uint32_t) min<size_t>(n, 31);
+            for (auto & c: counters) {
+                c >>= shift;
+            }
+            return n;
+        }
+
+        auto inline memory_bytes() const -> size_t {
+            return counters.capacity() * sizeof(uint32_t);
+        }
+};
+
+}
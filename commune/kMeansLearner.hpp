@@ -1,6 +1,7 @@
 #pragma once
 
 #include "../common.hpp"
+#include "./asyncLogger.hpp"
 #include "./analyzerWorker.hpp"
 #include "./deviceConfig.hpp"
 
@@ -192,7 +193,7 @@ class KMeansLearner final {
         void add_train_data(feature_t & ve, int pkt_num) {
             train_set.push_back(ve);
             train_packets += pkt_num;
-            LOGF("Training single. Currently: %ld records. %d packets.",
+            ALOGF_DEBUG("Training single. Currently: %ld records. %d packets.",
                     train_set.size(), train_packets);
         }
 
@@ -200,7 +201,7 @@ class KMeansLearner final {
         void add_train_data(vector<feature_t> & vve, int pkt_num) {
             train_set.insert(train_set.end(), vve.begin(), vve.end());
             train_packets += pkt_num;
-            LOGF("Training batch. Currently: %ld records. %d packets.",
+            ALOGF_DEBUG("Training batch. Currently: %ld records. %d packets.",
                     train_set.size(), train_packets);
         }
 
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <atomic>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+namespace Whisper {
+
+using overload_policy_t = uint8_t;
+enum overload_policy : overload_policy_t {
+    // drop only when the ring is full
+    OVERLOAD_NONE             = 0,
+    // drop every new record while overloaded
+    OVERLOAD_DROP_NEWEST      = 1,
+    // keep whole sources selected by address hash, the kept sequences stay intact
+    OVERLOAD_SOURCE_SAMPLING  = 2,
+    // keep sources already tracked by the analyzer, sample the others
+    OVERLOAD_TRACKED_PRIORITY = 3
+};
+
+static const map<string, overload_policy_t> overload_policy_map = {
+    {"none",             OVERLOAD_NONE},
+    {"drop_newest",      OVERLOAD_DROP_NEWEST},
+    {"source_sampling",  OVERLOAD_SOURCE_SAMPLING},
+    {"tracked_priority", OVERLOAD_TRACKED_PRIORITY}
+};
+
+// Sources that currently hold flow state in one analyzer, approximate (hash slots).
+// The analyzer stamps a slot when it creates state, parsers only read.
+class TrackedSourceFilter final {
+
+    private:
+        static constexpr size_t FILTER_BITS = 16;
+        static constexpr uint32_t FILTER_EPOCHS = 2;
+
+        atomic<uint32_t> epoch;
+        vector<atomic<uint32_t> > stamps;
+
+        auto static inline slot_of(uint32_t ip_src) -> size_t {
+            return (size_t) ((ip_src * 0xC2B2AE35u) >> (32 - FILTER_BITS));
+        }
+
+    public:
+        TrackedSourceFilter(): epoch(1), stamps((size_t) 1 << FILTER_BITS) {
+            for (auto & s: stamps) {
+                s.store(0, std::memory_order_relaxed);
+            }
+        }
+
+        virtual ~TrackedSourceFilter() {}
+        TrackedSourceFilter & operator=(const TrackedSourceFilter &) = delete;
+        TrackedSourceFilter(const TrackedSourceFilter &) = delete;
+
+        // Analyzer: the source holds flow state
+        void inline mark(uint32_t ip_src) {
+            stamps[slot_of(ip_src)].store(epoch.load(std::memory_order_relaxed),
+                                          std::memory_order_relaxed);
+        }
+
+        // Analyzer: age out the stamps of the oldest epoch
+        void inline advance() {
+            epoch.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        // Parser: the source was marked in the recent epochs
+        auto inline is_tracked(uint32_t ip_src) const -> bool {
+            const uint32_t s = stamps[slot_of(ip_src)].load(std::memory_order_relaxed);
+            return s != 0 && s + FILTER_EPOCHS > epoch.load(std::memory_order_relaxed);
+        }
+};
+
+// Drop counters of one guard, written by the owning parser only
+struct OverloadStats final {
+    atomic<uint64_t> drop_newest;
+    atomic<uint64_t> drop_sampled;
+    atomic<uint64_t> drop_untracked;
+    atomic<uint64_t> drop_full;
+    atomic<uint64_t> activation;
+    atomic<bool> active;
+
+    OverloadStats(): drop_newest(0), drop_sampled(0), drop_untracked(0),
+                     drop_full(0), activation(0), active(false) {}
+    OverloadStats & operator=(const OverloadStats &) = delete;
+    OverloadStats(const OverloadStats &) = delete;
+
+    void static inline bump(atomic<uint64_t> & c) {
+        c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+};
+
+// Watermark driven admission for one parser -> analyzer ring
+class OverloadGuard final {
+
+    private:
+        overload_policy_t policy;
+        size_t high_mark;
+        size_t low_mark;
+        uint32_t sample_rate;
+
+        bool is_active = false;
+        const TrackedSourceFilter * p_tracked = nullptr;
+
+        auto inline sampled_in(uint32_t ip_src) const -> bool {
+            if (sample_rate == 0) {
+                return false;
+            }
+            return ((ip_src * 0x85EBCA6Bu) >> 8) % sample_rate == 0;
+        }
+
+    public:
+        OverloadStats stats;
+
+        OverloadGuard(overload_policy_t _p, size_t capacity,
+                      double_t high_watermark, double_t low_watermark, uint32_t _rate):
+                policy(_p),
+                high_mark((size_t) (capacity * high_watermark)),
+                low_mark((size_t) (capacity * low_watermark)),
+                sample_rate(_rate) {}
+
+        virtual ~OverloadGuard() {}
+        OverloadGuard & operator=(const OverloadGuard &) = delete;
+        OverloadGuard(const OverloadGuard &) = delete;
+
+        void set_tracked_filter(const TrackedSourceFilter * _p) {
+            p_tracked = _p;
+        }
+
+        // Re-evaluate the watermarks, once per receive burst
+        void inline update(size_t occupancy) {
+            if (policy == OVERLOAD_NONE) {
+                return;
+            }
+            if (!is_active && occupancy >= high_mark) {
+                is_active = true;
+                OverloadStats::bump(stats.activation);
+                stats.active.store(true, std::memory_order_relaxed);
+            } else if (is_active && occupancy <= low_mark) {
+                is_active = false;
+                stats.active.store(false, std::memory_order_relaxed);
+            }
+        }
+
+        // Decide whether a record may enter the ring
+        auto inline admit(uint32_t ip_src) -> bool {
+            if (!is_active) {
+                return true;
+            }
+            switch (policy) {
+                case OVERLOAD_DROP_NEWEST:
+                    OverloadStats::bump(stats.drop_newest);
+                    return false;
+                case OVERLOAD_SOURCE_SAMPLING:
+                    if (sampled_in(ip_src)) {
+                        return true;
+                    }
+                    OverloadStats::bump(stats.drop_sampled);
+                    return false;
+                case OVERLOAD_TRACKED_PRIORITY:
+                    if ((p_tracked != nullptr && p_tracked->is_tracked(ip_src)) || sampled_in(ip_src)) {
+                        return true;
+                    }
+                    OverloadStats::bump(stats.drop_untracked);
+                    return false;
+                default:
+                    return true;
+            }
+        }
+
+        void inline count_full() {
+            OverloadStats::bump(stats.drop_full);
+        }
+};
+
+}
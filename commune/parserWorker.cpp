@@ -6,6 +6,29 @@
 
 using namespace Whisper;
 
+auto ParserWorkerThread::decode_peregrine(pcpp::RawPacket * p_raw, PktMetadata & meta) -> bool {
+	pcpp::Packet parsedPacket(p_raw);
+
+	if (!parsedPacket.isPacketOfType(pcpp::IPv4)) {
+		return false;
+	}
+	pcpp::IPv4Layer * IPlay = parsedPacket.getLayerOfType<pcpp::IPv4Layer>();
+	if (IPlay->getIPv4Header()->protocol != pcpp::PACKETPP_IPPROTO_PEREGRINE) {
+		return false;
+	}
+	pcpp::PeregrineLayer * peregrine =
+		parsedPacket.getLayerOfType<pcpp::PeregrineLayer>();
+	if (peregrine == nullptr) {
+		return false;
+	}
+
+	meta.ip_src = peregrine->getIpSrcAddr().toInt();
+	meta.proto = peregrine->getIpProto();
+	meta.length = ntohl(peregrine->getLength());
+	meta.ts = be64toh(peregrine->getTimestamp());
+	return true;
+}
+
 bool ParserWorkerThread::run(uint32_t core_id) {
 
 	uint16_t peregrinePkts = 0;
@@ -17,14 +40,12 @@ bool ParserWorkerThread::run(uint32_t core_id) {
 	// if no DPDK devices were assigned to this worker/core don't enter the main loop and exit
 	if (p_dpdk_config->nic_queue_list.size() == 0) {
 		WARN("NO NIC queue bind for parser on core %2d.", core_id);
+		m_rx_exited.store(true, std::memory_order_release);
 		return false;
 	}
 
-	meta_pkt_arr = shared_ptr<PktMetadata[]>(new PktMetadata[p_parser_config->meta_pkt_arr_size](),
-												std::default_delete<PktMetadata[]>());
-
-	if (meta_pkt_arr == nullptr) {
-		FATAL_ERROR("Meta data array: bad allocation.");
+	if (meta_rings.size() == 0) {
+		FATAL_ERROR("No analyzer bind for parser.");
 	}
 
 	// the size of receive burst, must be smaller than 2 << 16
@@ -33,6 +54,7 @@ bool ParserWorkerThread::run(uint32_t core_id) {
 
 	if (packet_arr == nullptr) {
 		WARN("Packet receving buffer allocation error.");
+		m_rx_exited.store(true, std::memory_order_release);
 		return false;
 	}
 	// LOGF("Parser on core # %2d start.", core_id);
@@ -41,86 +63,74 @@ bool ParserWorkerThread::run(uint32_t core_id) {
 		LOGF("Parser on core # %2d start.", core_id);
 	}
 	m_stop = false;
+	m_rx_exited.store(false, std::memory_order_release);
 
     thread verbose_stat(&ParserWorkerThread::verbose_tracing_thread, this);
     verbose_stat.detach();
 
-	const auto _f_get_meta_pkt_info = [packet_arr, this]
-			(const size_t i, const DpdkDevice* dev) -> shared_ptr<PktMetadata> {
-		pcpp::Packet parsedPacket(packet_arr[i]);
-
-		if (parsedPacket.isPacketOfType(pcpp::IPv4)) {
-			pcpp::IPv4Layer * IPlay = parsedPacket.getLayerOfType<pcpp::IPv4Layer>();
-			uint8_t protocol = IPlay->getIPv4Header()->protocol;
-
-			if (protocol == pcpp::PACKETPP_IPPROTO_PEREGRINE) {
-				pcpp::PeregrineLayer * peregrine =
-					parsedPacket.getLayerOfType<pcpp::PeregrineLayer>();
-
-				uint32_t ip_src = peregrine->getIpSrcAddr().toInt();
-				uint8_t proto = peregrine->getIpProto();
-				uint32_t length = ntohl(peregrine->getLength());
-				double ts = be64toh(peregrine->getTimestamp());
-
-				++ parsed_pkt_num[dev->getDeviceId()];
-				parsed_pkt_len[dev->getDeviceId()] += length;
-
-				return make_shared<PktMetadata>(ip_src, proto, length, ts);
-			} else {
-				return nullptr;
-			}
-		} else {
-			return nullptr;
-		}
-	};
-
 	parser_start_time = get_time_spec();
+	start_snapshot = p_queue_stats->snapshot();
 
 	// main loop, runs until be told to stop
 	while (!m_stop) {
 		// go over all DPDK devices configured for this worker/core
+		size_t stats_index = 0;
 		for (parser_queue_assign_t::iterator iter = p_dpdk_config->nic_queue_list.begin();
 			 								 iter != p_dpdk_config->nic_queue_list.end();
 											 iter++) {
 			// for each DPDK device go over all RX queues configured for this worker/core
 			for (vector<nic_queue_id_t>::iterator iter2 = iter->second.begin();
 					iter2 != iter->second.end();
-					iter2++) {
+					iter2++, stats_index++) {
 				DpdkDevice* dev = iter->first;
 
 				// receive packets from network on the specified DPDK device and RX queue
 				uint16_t packetsReceived = dev->receivePackets(
 					packet_arr, p_parser_config->max_receive_burts, *iter2);
 
+				if (packetsReceived == 0) {
+					continue;
+				}
+
+				// watermarks are checked once per burst, not per record
+				for (size_t k = 0; k < meta_rings.size(); k ++) {
+					overload_guards[k]->update(meta_rings[k]->size());
+				}
+
+				uint64_t burst_pkt_num = 0, burst_pkt_len = 0;
 
 				// iterate all of the packets and parse the metadata
 				for (uint16_t i = 0; i < packetsReceived; i++) {
 
-					const auto p_meta = _f_get_meta_pkt_info(i, dev);
-
-					if (p_meta == nullptr) {
+					PktMetadata meta;
+					if (!decode_peregrine(packet_arr[i], meta)) {
 						continue;
 					} else {
 						peregrinePkts += 1;
+						++ burst_pkt_num;
+						burst_pkt_len += meta.length;
 					}
 
-					assert(meta_index <= p_parser_config->meta_pkt_arr_size);
-					acquire_semaphore();
-					meta_pkt_arr[meta_index] = *p_meta;
-					meta_index ++;
-					release_semaphore();
-
-					// the array of parsed queue reach its max
-					if (meta_index == p_parser_config->meta_pkt_arr_size) {
-						WARNF("Parser on core # %2d: parse queue reach max.",
-							  (int) this->getCoreId());
-						// clear the meta data buffer, just for testing
-						acquire_semaphore();
-						acquire_semaphore();
-						meta_index = 0;
-						release_semaphore();
+					// dispatch to the analyzer owning this source address
+					const size_t shard = flow_shard_of(meta.ip_src, meta_rings.size());
+					if (!overload_guards[shard]->admit(meta.ip_src)) {
+						continue;
+					}
+					if (meta_rings[shard]->push(meta)) {
+						ring_full_state[shard] = false;
+					} else {
+						overload_guards[shard]->count_full();
+						// the ring of this analyzer reach its max, warn once per episode
+						if (!ring_full_state[shard]) {
+							ring_full_state[shard] = true;
+							AWARNF("Parser on core # %2d: parse queue to analyzer %ld reach max.",
+								   (int) this->getCoreId(), shard);
+						}
 					}
 				}
+
+				// publish the counters once per burst
+				p_queue_stats->at(stats_index).add_burst(burst_pkt_num, burst_pkt_len);
 			}
 		}
 	}
@@ -132,50 +142,52 @@ bool ParserWorkerThread::run(uint32_t core_id) {
 	}
 	delete packet_arr;
 
+	// every record of this parser is in the rings now
+	m_rx_exited.store(true, std::memory_order_release);
+
 	return true;
 }
 
+void ParserWorkerThread::init_queue_stats() {
+	stats_queue_index.clear();
+	for (const auto & ref: p_dpdk_config->nic_queue_list) {
+		for (const auto q: ref.second) {
+			stats_queue_index.push_back({ref.first, q});
+		}
+	}
+	p_queue_stats = make_shared<QueueCounterBlock>(stats_queue_index.size());
+}
+
 void ParserWorkerThread::verbose_tracing_thread() const {
+	// rates are computed from the deltas of monotonic snapshots, counters are never reset
+	StatsSnapshot last_snapshot = p_queue_stats->snapshot();
+
 	while (! m_stop) {
+		usleep((useconds_t) (p_parser_config->verbose_interval * 1e6));
+		if (m_stop) {
+			break;
+		}
+
+		const StatsSnapshot cur_snapshot = p_queue_stats->snapshot();
+
 		if (p_parser_config->verbose_mode & ParserConfigParam::verbose_type::TRACING) {
 			stringstream ss;
 			ss << "Parser on core # " << setw(2) << m_core_id << ": ";
-			size_t index = 0;
-
-			for (parser_queue_assign_t::const_iterator ite = cbegin(p_dpdk_config->nic_queue_list);
-					ite != cend(p_dpdk_config->nic_queue_list); ite ++) {
 
-				ss << "DPDK Port" << setw(2) << ite->first->getDeviceId();
-				ss << " [" << setw(5) << setprecision(3) << ((double) parsed_pkt_num[index] / 1e6)
-					/ p_parser_config->verbose_interval << " Mpps / ";
+			for (size_t index = 0; index < stats_queue_index.size(); index ++) {
+				const auto _rate = cur_snapshot.rate_since(last_snapshot, index);
 
-				ss << setw(5) << setprecision(3) << ((double) parsed_pkt_len[index] / (1e9 / 8))
-					/ p_parser_config->verbose_interval << " Gbps]\t";
-
-
-				sum_parsed_pkt_num[index] += parsed_pkt_num[index];
-				sum_parsed_pkt_len[index] += parsed_pkt_len[index];
-
-				parsed_pkt_num[index] = 0;
-				parsed_pkt_len[index] = 0;
-				index ++;
+				ss << "DPDK Port" << setw(2) << stats_queue_index[index].first->getDeviceId();
+				ss << " Queue" << setw(2) << stats_queue_index[index].second;
+				ss << " [" << setw(5) << setprecision(3) << _rate.first / 1e6 << " Mpps / ";
+				ss << setw(5) << setprecision(3) << _rate.second / 1e9 << " Gbps]\t";
 			}
 
-			ss << endl;
+			ss << endl << overload_summary();
 			printf("%s", ss.str().c_str());
-		} else {
-			size_t index = 0;
-			for (parser_queue_assign_t::const_iterator ite = cbegin(p_dpdk_config->nic_queue_list);
-					ite != cend(p_dpdk_config->nic_queue_list); ite ++) {
-				sum_parsed_pkt_num[index] += parsed_pkt_num[index];
-				sum_parsed_pkt_len[index] += parsed_pkt_len[index];
-
-				parsed_pkt_num[index] = 0;
-				parsed_pkt_len[index] = 0;
-				index ++;
-			}
 		}
-		sleep(p_parser_config->verbose_interval);
+
+		last_snapshot = cur_snapshot;
 	}
 }
 
@@ -186,39 +198,55 @@ void ParserWorkerThread::verbose_final() const {
 		ss << " Runtime: " << setw(5) << setprecision(3)
 		   << (parser_end_time - parser_start_time) << "s\n";
 
-		size_t index = 0;
+		for (size_t index = 0; index < stats_queue_index.size(); index ++) {
+			const auto _rate = final_snapshot.rate_since(start_snapshot, index);
 
-		for (parser_queue_assign_t::const_iterator ite = cbegin(p_dpdk_config->nic_queue_list);
-				ite != cend(p_dpdk_config->nic_queue_list); ite ++) {
-			double_t _device_overall_packet_speed =
-				((double) sum_parsed_pkt_num[index] / 1e6) / (parser_end_time - parser_start_time);
-
-			double_t _device_overall_byte_speed = ((double) sum_parsed_pkt_len[index] / (1e9 / 8))
-				/ (parser_end_time - parser_start_time);
-
-			ss << "DPDK Port" << setw(2) << ite->first->getDeviceId();
-			ss << " [" << setw(5) << setprecision(3) << _device_overall_packet_speed << " Mpps / ";
-			ss << setw(5) << setprecision(3) << _device_overall_byte_speed << " Gbps]\t";
-
-			index ++;
+			ss << "DPDK Port" << setw(2) << stats_queue_index[index].first->getDeviceId();
+			ss << " Queue" << setw(2) << stats_queue_index[index].second;
+			ss << " [" << setw(5) << setprecision(3) << _rate.first / 1e6 << " Mpps / ";
+			ss << setw(5) << setprecision(3) << _rate.second / 1e9 << " Gbps]\t";
 		}
 
-		ss << endl;
+		ss << endl << overload_summary();
 		printf("%s", ss.str().c_str());
-	} else {
-		size_t index = 0;
+	}
+}
 
-		for (parser_queue_assign_t::const_iterator ite = cbegin(p_dpdk_config->nic_queue_list);
-				ite != cend(p_dpdk_config->nic_queue_list); ite ++) {
-			double_t _device_overall_packet_speed = ((double) sum_parsed_pkt_num[index] / 1e6)
-				/ (parser_end_time - parser_start_time);
+auto ParserWorkerThread::overload_summary() const -> string {
+	uint64_t drop_newest = 0, drop_sampled = 0, drop_untracked = 0, drop_full = 0, activation = 0;
+	size_t num_active = 0;
+	for (const auto & p_guard: overload_guards) {
+		const auto & st = p_guard->stats;
+		drop_newest += st.drop_newest.load(std::memory_order_relaxed);
+		drop_sampled += st.drop_sampled.load(std::memory_order_relaxed);
+		drop_untracked += st.drop_untracked.load(std::memory_order_relaxed);
+		drop_full += st.drop_full.load(std::memory_order_relaxed);
+		activation += st.activation.load(std::memory_order_relaxed);
+		num_active += st.active.load(std::memory_order_relaxed) ? 1 : 0;
+	}
 
-			double_t _device_overall_byte_speed = ((double) sum_parsed_pkt_len[index] / (1e9 / 8))
-				/ (parser_end_time - parser_start_time);
+	stringstream ss;
+	ss << "Parser on core # " << setw(2) << m_core_id << " overload: ";
+	ss << (num_active ? "ACTIVE" : "idle") << " (" << num_active << "/" << overload_guards.size() << " rings)";
+	ss << ", activations: " << activation;
+	ss << ", dropped [newest: " << drop_newest << ", sampled: " << drop_sampled;
+	ss << ", untracked: " << drop_untracked << ", ring full: " << drop_full << "]" << endl;
+	return ss.str();
+}
 
-			index ++;
-		}
+auto ParserWorkerThread::get_counters() const -> Counters {
+	Counters ret;
+	for (const auto & q: p_queue_stats->snapshot().queues) {
+		ret.received += q.pkt_num;
 	}
+	for (const auto & p_guard: overload_guards) {
+		const auto & st = p_guard->stats;
+		ret.drop_overload += st.drop_newest.load(std::memory_order_relaxed)
+						   + st.drop_sampled.load(std::memory_order_relaxed)
+						   + st.drop_untracked.load(std::memory_order_relaxed);
+		ret.drop_full += st.drop_full.load(std::memory_order_relaxed);
+	}
+	return ret;
 }
 
 auto ParserWorkerThread::get_overall_performance() const -> pair<double_t, double_t> {
@@ -227,22 +255,62 @@ auto ParserWorkerThread::get_overall_performance() const -> pair<double_t, doubl
 		return {0, 0};
 	}
 
-	size_t index = 0;
 	double_t thread_overall_num = 0, thread_overall_len = 0;
 
-	for (parser_queue_assign_t::const_iterator ite = cbegin(p_dpdk_config->nic_queue_list);
-			ite != cend(p_dpdk_config->nic_queue_list); ite ++) {
-		double_t _device_overall_packet_speed = ((double) sum_parsed_pkt_num[index] / 1e6)
-			/ (parser_end_time - parser_start_time);
+	for (size_t index = 0; index < stats_queue_index.size(); index ++) {
+		const auto _rate = final_snapshot.rate_since(start_snapshot, index);
+		thread_overall_num += _rate.first / 1e6;
+		thread_overall_len += _rate.second / 1e9;
+	}
+	return {thread_overall_num, thread_overall_len};
+}
+
+auto ParserWorkerThread::bind_analyzers(size_t num_analyzer) -> bool {
+	if (p_parser_config == nullptr) {
+		WARN("Parser configuration not found, can not bind analyzers.");
+		return false;
+	}
+	if (num_analyzer == 0) {
+		WARN("None analyzer to bind.");
+		return false;
+	}
+
+	// the metadata budget of one parser is shared by all of its rings
+	const size_t ring_size = max<size_t>(p_parser_config->meta_pkt_arr_size / num_analyzer, 1 << 10);
+	// rings live on the socket of the producing parser (close to the NIC)
+	const int socket_id = socket_of_core(m_core_id);
+
+	meta_rings.clear();
+	overload_guards.clear();
+	for (size_t i = 0; i < num_analyzer; i ++) {
+		const auto storage = make_socket_array<PktMetadata>(
+			meta_ring_t::capacity_for(ring_size), socket_id, "whisper_parser_ring");
+		if (storage == nullptr) {
+			WARN("Handoff ring: bad allocation.");
+			return false;
+		}
+		meta_rings.push_back(make_shared<meta_ring_t>(ring_size, storage));
+		overload_guards.push_back(make_shared<OverloadGuard>(
+			p_parser_config->overload_policy, meta_rings.back()->get_capacity(),
+			p_parser_config->high_watermark, p_parser_config->low_watermark,
+			p_parser_config->overload_sample_rate));
+	}
+	ring_full_state.assign(num_analyzer, false);
 
-		double_t _device_overall_byte_speed = ((double) sum_parsed_pkt_len[index] / (1e9 / 8))
-			/ (parser_end_time - parser_start_time);
+	return true;
+}
 
-		thread_overall_num += _device_overall_packet_speed;
-		thread_overall_len += _device_overall_byte_speed;
-		index ++;
+auto ParserWorkerThread::bind_tracked_filters(const vector<shared_ptr<TrackedSourceFilter> > & filters) -> bool {
+	if (filters.size() != overload_guards.size()) {
+		WARNF("Tracked source filters (%ld) do not match the handoff rings (%ld).",
+			  filters.size(), overload_guards.size());
+		return false;
 	}
-	return {thread_overall_num, thread_overall_len};
+	tracked_filters = filters;
+	for (size_t i = 0; i < filters.size(); i ++) {
+		overload_guards[i]->set_tracked_filter(filters[i].get());
+	}
+	return true;
 }
 
 auto ParserWorkerThread::configure_via_json(const json & jin) -> bool {
@@ -286,6 +354,32 @@ auto ParserWorkerThread::configure_via_json(const json & jin) -> bool {
 			p_parser_config->verbose_interval =
 				static_cast<decltype(p_parser_config->verbose_interval)>(jin["verbose_interval"]);
 		}
+
+		if (jin.count("overload_policy")) {
+			json _j_policy = jin["overload_policy"];
+			if (overload_policy_map.count(_j_policy) != 0) {
+				p_parser_config->overload_policy = overload_policy_map.at(_j_policy);
+			} else {
+				WARNF("Unknown overload policy: %s", static_cast<string>(_j_policy).c_str());
+				throw logic_error("Parse error Json tag: overload_policy\n");
+			}
+		}
+		if (jin.count("high_watermark")) {
+			p_parser_config->high_watermark =
+				static_cast<decltype(p_parser_config->high_watermark)>(jin["high_watermark"]);
+		}
+		if (jin.count("low_watermark")) {
+			p_parser_config->low_watermark =
+				static_cast<decltype(p_parser_config->low_watermark)>(jin["low_watermark"]);
+		}
+		if (p_parser_config->low_watermark < 0 || p_parser_config->high_watermark > 1 ||
+			p_parser_config->low_watermark >= p_parser_config->high_watermark) {
+			throw logic_error("Watermarks must satisfy 0 <= low_watermark < high_watermark <= 1\n");
+		}
+		if (jin.count("overload_sample_rate")) {
+			p_parser_config->overload_sample_rate =
+				static_cast<decltype(p_parser_config->overload_sample_rate)>(jin["overload_sample_rate"]);
+		}
 	} catch (exception & e) {
 		WARN(e.what());
 		return false;
@@ -1,6 +1,10 @@
 #pragma once
 
 #include "dpdkCommon.hpp"
+#include "spscRing.hpp"
+#include "perCoreStats.hpp"
+#include "socketAlloc.hpp"
+#include "overloadPolicy.hpp"
 #include "deviceConfig.hpp"
 #include "analyzerWorker.hpp"
 
@@ -30,6 +34,14 @@ struct ParserConfigParam final {
 	#define RECEIVE_BURST_LIM (1 << 16)
 	size_t max_receive_burts = 64;
 
+	// load shedding in front of the analyzer rings, see overloadPolicy.hpp
+	overload_policy_t overload_policy = OVERLOAD_TRACKED_PRIORITY;
+	// ring occupancy (fraction of capacity) that turns shedding on / off
+	double_t high_watermark = 0.8;
+	double_t low_watermark = 0.5;
+	// keep 1 of every N sources while shedding, 0 keeps none
+	uint32_t overload_sample_rate = 4;
+
 	ParserConfigParam() = default;
     virtual ~ParserConfigParam() {}
     ParserConfigParam & operator=(const ParserConfigParam &) = delete;
@@ -42,6 +54,13 @@ struct ParserConfigParam final {
         printf("Maximum receive burst: %ld, Meta data buffer size: %ld\n",
         max_receive_burts, meta_pkt_arr_size);
 
+        string _policy = "unknown";
+        for (const auto & ref: overload_policy_map) {
+            if (ref.second == overload_policy) _policy = ref.first;
+        }
+        printf("Overload policy: %s, Watermark: [%4.2lf, %4.2lf], Source sampling: 1/%u\n",
+        _policy.c_str(), low_watermark, high_watermark, overload_sample_rate);
+
         stringstream ss;
         ss << "Verbose mode: {";
         if (verbose_mode & INIT) ss << "Init,";
@@ -70,28 +89,22 @@ class ParserWorkerThread final : public DpdkWorkerThread {
 		shared_ptr<ParserConfigParam> p_parser_config;
 
 		mutable bool m_stop = false;
+		// The receive loop has returned, the handoff rings only shrink from now on
+		atomic<bool> m_rx_exited;
 
 		const cpu_core_id_t m_core_id;
 
-		// statistical variables
-		mutable vector<uint64_t> parsed_pkt_len;
-		mutable vector<uint64_t> parsed_pkt_num;
-		mutable vector<uint64_t> sum_parsed_pkt_num;
-		mutable vector<uint64_t> sum_parsed_pkt_len;
+		// statistical variables, one cache line isolated counter per NIC queue of this core
+		shared_ptr<QueueCounterBlock> p_queue_stats;
+		// (device, queue) pairs in the order of p_queue_stats
+		vector<pair<DpdkDevice *, nic_queue_id_t> > stats_queue_index;
+		mutable StatsSnapshot start_snapshot, final_snapshot;
 		mutable double_t parser_start_time, parser_end_time;
 
+		void init_queue_stats();
 		void verbose_final() const;
 		void verbose_tracing_thread() const;
 
-		// Read-Write exclution for per-packet Metadata
-		mutable sem_t semaphore;
-		void inline acquire_semaphore() const {
-			sem_wait(&semaphore);
-		}
-		void inline release_semaphore() const {
-			sem_post(&semaphore);
-		}
-
 		enum type_identify_mp : uint16_t {
 			TYPE_TCP_SYN 	= 1,
 			TYPE_TCP_FIN 	= 40,
@@ -104,47 +117,44 @@ class ParserWorkerThread final : public DpdkWorkerThread {
 			TYPE_UNKNOWN 	= 10,
 		};
 
-		// Index of metadata array
-		volatile size_t meta_index = 0;
+		// Watermark admission of each handoff ring, also holds the drop counters
+		vector<shared_ptr<OverloadGuard> > overload_guards;
+		// Tracked sources published by each analyzer, read by the guards
+		vector<shared_ptr<TrackedSourceFilter> > tracked_filters;
+		vector<bool> ring_full_state;
+
+		auto overload_summary() const -> string;
 
 	public:
 
-		// Collect the per-packets metadata
-		shared_ptr<PktMetadata[]> meta_pkt_arr;
+		// Per-analyzer handoff rings of per-packet metadata, indexed by flow_shard_of(ip_src)
+		using meta_ring_t = SpscRing<PktMetadata>;
+		vector<shared_ptr<meta_ring_t> > meta_rings;
 
 		ParserWorkerThread(const shared_ptr<DpdkConfig> p_d, const json & j_p):
-				p_dpdk_config(p_d), m_core_id(p_d != nullptr ? p_d->core_id : MAX_NUM_OF_CORES + 1) {
+				p_dpdk_config(p_d), m_rx_exited(false),
+				m_core_id(p_d != nullptr ? p_d->core_id : MAX_NUM_OF_CORES + 1) {
 			if (p_dpdk_config == nullptr) {
 				FATAL_ERROR("NULL dpdk configuration for parser.");
 			}
 
-			sem_init(&semaphore, 0, 1);
-
 			if (j_p.size()) {
 				configure_via_json(j_p);
 			}
 
-			sum_parsed_pkt_num.resize(p_d->nic_queue_list.size(), 0);
-			sum_parsed_pkt_len.resize(p_d->nic_queue_list.size(), 0);
-			parsed_pkt_len.resize(p_d->nic_queue_list.size(), 0);
-			parsed_pkt_num.resize(p_d->nic_queue_list.size(), 0);
+			init_queue_stats();
 		}
 
 		ParserWorkerThread(const shared_ptr<DpdkConfig> p_d = nullptr,
 						   const shared_ptr<ParserConfigParam> p_p = nullptr):
-				p_dpdk_config(p_d), p_parser_config(p_p),
+				p_dpdk_config(p_d), p_parser_config(p_p), m_rx_exited(false),
 				m_core_id(p_d != nullptr ? p_d->core_id : MAX_NUM_OF_CORES + 1) {
 
 			if (p_dpdk_config == nullptr) {
 				FATAL_ERROR("dpdk configuration not found for parser.");
 			}
 
-			sem_init(&semaphore, 0, 1);
-
-			sum_parsed_pkt_num.resize(p_d->nic_queue_list.size(), 0);
-			sum_parsed_pkt_len.resize(p_d->nic_queue_list.size(), 0);
-			parsed_pkt_len.resize(p_d->nic_queue_list.size(), 0);
-			parsed_pkt_num.resize(p_d->nic_queue_list.size(), 0);
+			init_queue_stats();
 		}
 
 		virtual ~ParserWorkerThread() {}
@@ -153,22 +163,42 @@ class ParserWorkerThread final : public DpdkWorkerThread {
 
 		auto get_overall_performance() const -> pair<double_t, double_t>;
 
+		// Running totals, safe to read from any thread while the worker runs
+		struct Counters final {
+			// Peregrine records decoded
+			uint64_t received = 0;
+			// Refused by the overload guards, and lost on a full ring
+			uint64_t drop_overload = 0;
+			uint64_t drop_full = 0;
+		};
+		auto get_counters() const -> Counters;
+
+		// Allocate one handoff ring per analyzer, call before the worker starts
+		auto bind_analyzers(size_t num_analyzer) -> bool;
+		// Let the guards prefer the sources the analyzers already track, after bind_analyzers
+		auto bind_tracked_filters(const vector<shared_ptr<TrackedSourceFilter> > & filters) -> bool;
+
 		virtual bool run(uint32_t coreId) override;
 
+		// Extract the per-packet metadata of a Peregrine record, false for other packets
+		auto static decode_peregrine(pcpp::RawPacket * p_raw, PktMetadata & meta) -> bool;
+
+		// Stop receiving, the loop returns after the current burst (shutdown step 1)
+		void stop_rx() {
+			if (!m_stop) {
+				m_stop = true;
+				parser_end_time = get_time_spec();
+			}
+		}
+
+		auto inline is_rx_exited() const -> bool {
+			return m_rx_exited.load(std::memory_order_acquire);
+		}
+
 		virtual void stop() override {
 			LOGF("Parser on core # %d stop.", getCoreId());
-			m_stop = true;
-			parser_end_time = get_time_spec();
-			size_t index = 0;
-			for (parser_queue_assign_t::const_iterator ite = cbegin(p_dpdk_config->nic_queue_list);
-				ite != cend(p_dpdk_config->nic_queue_list); ite ++) {
-					sum_parsed_pkt_num[index] += parsed_pkt_num[index];
-					sum_parsed_pkt_len[index] += parsed_pkt_len[index];
-
-					parsed_pkt_num[index] = 0;
-					parsed_pkt_len[index] = 0;
-					index ++;
-			}
+			stop_rx();
+			final_snapshot = p_queue_stats->snapshot();
 			verbose_final();
 		}
 
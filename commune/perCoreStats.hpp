@@ -0,0 +1,121 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <atomic>
+#include <vector>
+
+using namespace std;
+
+namespace Whisper {
+
+#define STATS_CACHE_LINE 64
+
+// Monotonic counter values of one queue at one point in time
+struct QueueSnapshot final {
+    uint64_t pkt_num = 0;
+    uint64_t pkt_len = 0;
+};
+
+// Counters of one NIC queue. Only the owning core writes, once per receive burst,
+// readers on other threads take consistent copies through the sequence number.
+struct alignas(STATS_CACHE_LINE) QueueCounter final {
+
+    atomic<uint32_t> seq;
+    atomic<uint64_t> pkt_num;
+    atomic<uint64_t> pkt_len;
+
+    QueueCounter(): seq(0), pkt_num(0), pkt_len(0) {}
+    QueueCounter & operator=(const QueueCounter &) = delete;
+    QueueCounter(const QueueCounter &) = delete;
+
+    // Owner core only: publish the totals of one burst
+    void inline add_burst(uint64_t num, uint64_t len) {
+        const uint32_t s = seq.load(std::memory_order_relaxed);
+        seq.store(s + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        pkt_num.store(pkt_num.load(std::memory_order_relaxed) + num, std::memory_order_relaxed);
+        pkt_len.store(pkt_len.load(std::memory_order_relaxed) + len, std::memory_order_relaxed);
+        seq.store(s + 2, std::memory_order_release);
+    }
+
+    auto inline snapshot() const -> QueueSnapshot {
+        QueueSnapshot ret;
+        uint32_t s0, s1;
+        do {
+            s0 = seq.load(std::memory_order_acquire);
+            ret.pkt_num = pkt_num.load(std::memory_order_relaxed);
+            ret.pkt_len = pkt_len.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            s1 = seq.load(std::memory_order_relaxed);
+        } while ((s0 & 1) || s0 != s1);
+        return ret;
+    }
+};
+
+// Snapshot of every queue of one core
+struct StatsSnapshot final {
+    double_t ts = 0;
+    vector<QueueSnapshot> queues;
+
+    // Packet and bit rate of queue i between prev and this snapshot
+    auto inline rate_since(const StatsSnapshot & prev, size_t i) const -> pair<double_t, double_t> {
+        const double_t _dt = ts - prev.ts;
+        if (_dt <= 0 || i >= queues.size() || i >= prev.queues.size()) {
+            return {0, 0};
+        }
+        return {
+            ((double_t) (queues[i].pkt_num - prev.queues[i].pkt_num)) / _dt,
+            ((double_t) (queues[i].pkt_len - prev.queues[i].pkt_len)) * 8.0 / _dt
+        };
+    }
+};
+
+// Cache line isolated counters of all queues served by one core
+class QueueCounterBlock final {
+
+    private:
+        size_t num_queue;
+        QueueCounter * counters = nullptr;
+
+    public:
+        explicit QueueCounterBlock(size_t n): num_queue(n) {
+            void * _p = nullptr;
+            if (posix_memalign(&_p, STATS_CACHE_LINE, max<size_t>(n, 1) * sizeof(QueueCounter)) != 0) {
+                FATAL_ERROR("Statistic counters: bad allocation.");
+            }
+            counters = static_cast<QueueCounter *>(_p);
+            for (size_t i = 0; i < num_queue; i ++) {
+                new (counters + i) QueueCounter();
+            }
+        }
+
+        virtual ~QueueCounterBlock() {
+            for (size_t i = 0; i < num_queue; i ++) {
+                counters[i].~QueueCounter();
+            }
+            free(counters);
+        }
+        QueueCounterBlock & operator=(const QueueCounterBlock &) = delete;
+        QueueCounterBlock(const QueueCounterBlock &) = delete;
+
+        auto inline at(size_t i) -> QueueCounter & {
+            return counters[i];
+        }
+
+        auto inline size() const -> size_t {
+            return num_queue;
+        }
+
+        auto snapshot() const -> StatsSnapshot {
+            StatsSnapshot ret;
+            ret.ts = get_time_spec();
+            ret.queues.reserve(num_queue);
+            for (size_t i = 0; i < num_queue; i ++) {
+                ret.queues.push_back(counters[i].snapshot());
+            }
+            return ret;
+        }
+};
+
+}
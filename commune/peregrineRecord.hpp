@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../common.hpp"
+#include "dpdkCommon.hpp"
+
+#include <cstring>
+#include <endian.h>
+#include <arpa/inet.h>
+
+using namespace std;
+
+namespace Whisper {
+
+// Wire format of one Peregrine record as exported by the switch: Ethernet / IPv4
+// (protocol PACKETPP_IPPROTO_PEREGRINE) / this header. Keep in sync with PeregrineLayer.
+struct PeregrineRecordHeader final {
+    // Source address of the mirrored packet, network order
+    uint32_t ip_src;
+    uint8_t ip_proto;
+    // Network order
+    uint32_t length;
+    // Switch timestamp, big endian
+    uint64_t timestamp;
+} __attribute__((packed));
+
+#define PEREGRINE_IPPROTO 253
+#define PEREGRINE_ETH_HDR_LEN 14
+#define PEREGRINE_IPV4_HDR_LEN 20
+#define PEREGRINE_FRAME_LEN (PEREGRINE_ETH_HDR_LEN + PEREGRINE_IPV4_HDR_LEN + sizeof(PeregrineRecordHeader))
+// Short frames are padded to the Ethernet minimum (without FCS)
+#define PEREGRINE_FRAME_MIN_LEN 60
+
+static inline auto __ipv4_checksum(const uint8_t * hdr) -> uint16_t {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < PEREGRINE_IPV4_HDR_LEN; i += 2) {
+        sum += (hdr[i] << 8) | hdr[i + 1];
+    }
+    while (sum >> 16) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return htons((uint16_t) ~sum);
+}
+
+// Encode one record as a Peregrine frame, buf holds at least PEREGRINE_FRAME_MIN_LEN bytes.
+// The timestamp (ticks) replaces meta.ts, which is a double. Returns the frame length.
+static inline auto encode_peregrine_frame(const PktMetadata & meta, uint8_t * buf,
+                                          uint64_t timestamp) -> size_t {
+    static const uint8_t eth_hdr[PEREGRINE_ETH_HDR_LEN] = {
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x02,     // dst: the Whisper server
+        0x02, 0x00, 0x00, 0x00, 0x00, 0x01,     // src: the switch
+        0x08, 0x00
+    };
+    memset(buf, 0, PEREGRINE_FRAME_MIN_LEN);
+    memcpy(buf, eth_hdr, PEREGRINE_ETH_HDR_LEN);
+
+    uint8_t * ip = buf + PEREGRINE_ETH_HDR_LEN;
+    const uint16_t ip_len = PEREGRINE_IPV4_HDR_LEN + sizeof(PeregrineRecordHeader);
+    ip[0] = 0x45;
+    ip[2] = ip_len >> 8;
+    ip[3] = ip_len & 0xff;
+    ip[8] = 64;
+    ip[9] = PEREGRINE_IPPROTO;
+    // 10.255.0.1 -> 10.255.0.2
+    ip[12] = 10; ip[13] = 255; ip[14] = 0; ip[15] = 1;
+    ip[16] = 10; ip[17] = 255; ip[18] = 0; ip[19] = 2;
+    const uint16_t csum = __ipv4_checksum(ip);
+    memcpy(ip + 10, &csum, sizeof(csum));
+
+    PeregrineRecordHeader rec;
+    rec.ip_src = meta.ip_src;
+    rec.ip_proto = (uint8_t) meta.proto;
+    rec.length = htonl(meta.length);
+    rec.timestamp = htobe64(timestamp);
+    memcpy(ip + PEREGRINE_IPV4_HDR_LEN, &rec, sizeof(rec));
+
+    return max<size_t>(PEREGRINE_FRAME_LEN, PEREGRINE_FRAME_MIN_LEN);
+}
+
+static inline auto encode_peregrine_frame(const PktMetadata & meta, uint8_t * buf) -> size_t {
+    return encode_peregrine_frame(meta, buf, (uint64_t) meta.ts);
+}
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "resultRecord.hpp"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <dirent.h>
+
+namespace Whisper {
+
+// Reader of the binary result files written by ResultWriter, usable while the
+// file is still being appended: a truncated trailing record is left for later.
+class ResultReader final {
+
+    private:
+        FILE * p_file = nullptr;
+        ResultFileHeader header;
+
+    public:
+        ResultReader() = default;
+        explicit ResultReader(const std::string & path) {
+            open(path);
+        }
+
+        virtual ~ResultReader() {
+            close();
+        }
+        ResultReader & operator=(const ResultReader &) = delete;
+        ResultReader(const ResultReader &) = delete;
+
+        // Open a file and validate its header
+        auto open(const std::string & path) -> bool {
+            close();
+            p_file = fopen(path.c_str(), "rb");
+            if (p_file == nullptr) {
+                return false;
+            }
+            if (fread(&header, sizeof(header), 1, p_file) != 1 ||
+                    header.magic != RESULT_FILE_MAGIC ||
+                    header.version != RESULT_FILE_VERSION ||
+                    header.record_size != sizeof(ResultRecord)) {
+                close();
+                return false;
+            }
+            return true;
+        }
+
+        void close() {
+            if (p_file != nullptr) {
+                fclose(p_file);
+                p_file = nullptr;
+            }
+        }
+
+        auto inline is_open() const -> bool {
+            return p_file != nullptr;
+        }
+
+        auto inline get_header() const -> const ResultFileHeader & {
+            return header;
+        }
+
+        // Next record, false at the (current) end of the file
+        auto next(ResultRecord & r) -> bool {
+            if (p_file == nullptr) {
+                return false;
+            }
+            const long pos = ftell(p_file);
+            if (fread(&r, sizeof(r), 1, p_file) != 1) {
+                // rewind a partial record so a later call can read it complete
+                fseek(p_file, pos, SEEK_SET);
+                clearerr(p_file);
+                return false;
+            }
+            return true;
+        }
+
+        // Up to max_n records into out with one read, returns the number read
+        auto next_block(ResultRecord * out, size_t max_n) -> size_t {
+            if (p_file == nullptr || max_n == 0) {
+                return 0;
+            }
+            const size_t len = fread(out, 1, max_n * sizeof(ResultRecord), p_file);
+            const size_t rem = len % sizeof(ResultRecord);
+            if (rem) {
+                // leave the partial record for a later call
+                fseek(p_file, -(long) rem, SEEK_CUR);
+            }
+            clearerr(p_file);
+            return len / sizeof(ResultRecord);
+        }
+
+        // Append up to max_n records, returns the number read
+        auto next_batch(std::vector<ResultRecord> & out, size_t max_n) -> size_t {
+            size_t n = 0;
+            ResultRecord r;
+            while (n < max_n && next(r)) {
+                out.push_back(r);
+                ++ n;
+            }
+            return n;
+        }
+
+        // All records of one file
+        auto static read_all(const std::string & path, std::vector<ResultRecord> & out) -> bool {
+            ResultReader reader;
+            if (!reader.open(path)) {
+                return false;
+            }
+            ResultRecord r;
+            while (reader.next(r)) {
+                out.push_back(r);
+            }
+            return true;
+        }
+
+        // Result files in a directory, optionally filtered by prefix, in name order
+        auto static list_files(const std::string & dir, const std::string & prefix = "")
+                -> std::vector<std::string> {
+            std::vector<std::string> ret;
+            const std::string suffix = RESULT_FILE_SUFFIX;
+            DIR * p_dir = opendir(dir.empty() ? "." : dir.c_str());
+            if (p_dir == nullptr) {
+                return ret;
+            }
+            for (struct dirent * p_ent = readdir(p_dir); p_ent != nullptr; p_ent = readdir(p_dir)) {
+                const std::string name = p_ent->d_name;
+                if (name.size() <= suffix.size() ||
+                        name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0 ||
+                        name.compare(0, prefix.size(), prefix) != 0) {
+                    continue;
+                }
+                if (dir.empty()) {
+                    ret.push_back(name);
+                } else {
+                    ret.push_back(dir.back() == '/' ? dir + name : dir + "/" + name);
+                }
+            }
+            closedir(p_dir);
+            std::sort(ret.begin(), ret.end());
+            return ret;
+        }
+};
+
+}
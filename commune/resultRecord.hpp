@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace Whisper {
+
+// On-disk layout of the binary result files, shared by the writer and the reader.
+// File: one ResultFileHeader followed by fixed-size ResultRecords, little endian.
+
+#define RESULT_FILE_MAGIC 0x52505357u   // "WSPR"
+// 2: upper flag bits hold the sample count, aggregate records hold a bucket number
+#define RESULT_FILE_VERSION 2u
+#define RESULT_FILE_SUFFIX ".wres"
+
+enum result_flag : uint32_t {
+    // Scored at shutdown with fewer packets than a regular flow
+    RESULT_FLAG_PARTIAL = 0x1,
+    // Scored on a sample of its packets, the sample size is in the upper flag bits
+    RESULT_FLAG_SAMPLED = 0x2,
+    // Coarse verdict of the light sources of a bucket, the address is the bucket number
+    RESULT_FLAG_AGGREGATE = 0x4
+};
+
+// Samples behind a sampled verdict, saturated at 2^24 - 1
+#define RESULT_SAMPLE_SHIFT 8
+#define RESULT_SAMPLE_MAX 0xffffffu
+
+static inline auto make_result_flags(bool partial, uint64_t packet_num, uint64_t sample_num) -> uint32_t {
+    uint32_t flags = partial ? (uint32_t) RESULT_FLAG_PARTIAL : 0u;
+    if (sample_num < packet_num) {
+        const uint64_t n = sample_num < RESULT_SAMPLE_MAX ? sample_num : RESULT_SAMPLE_MAX;
+        flags |= (uint32_t) RESULT_FLAG_SAMPLED | (uint32_t) (n << RESULT_SAMPLE_SHIFT);
+    }
+    return flags;
+}
+
+// Packets per analyzed sample of a verdict, 1 when every packet was analyzed
+static inline auto result_sample_factor(uint32_t flags, uint64_t packet_num) -> double {
+    const uint64_t n = flags >> RESULT_SAMPLE_SHIFT;
+    return (flags & RESULT_FLAG_SAMPLED) && n != 0 ? (double) packet_num / n : 1.0;
+}
+
+struct ResultFileHeader final {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t core_id;
+    // Sequence number of this file in the rotation
+    uint64_t file_seq;
+    // Creation time, seconds since epoch
+    double ts_create;
+};
+static_assert(sizeof(ResultFileHeader) == 32, "result file header layout");
+
+struct ResultRecord final {
+    // Source address, host byte order
+    uint32_t address;
+    uint32_t flags;
+    // Min. distance to the cluster centers
+    double distance;
+    uint64_t packet_num;
+    // Verdict time, seconds since epoch
+    double ts;
+};
+static_assert(sizeof(ResultRecord) == 32, "result record layout");
+
+static inline auto make_result_header(uint32_t core_id, uint64_t file_seq, double ts) -> ResultFileHeader {
+    ResultFileHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = RESULT_FILE_MAGIC;
+    h.version = RESULT_FILE_VERSION;
+    h.record_size = sizeof(ResultRecord);
+    h.core_id = core_id;
+    h.file_seq = file_seq;
+    h.ts_create = ts;
+    return h;
+}
+
+}
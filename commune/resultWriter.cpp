@@ -0,0 +1,139 @@
+#include "resultWriter.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace Whisper;
+
+ResultWriter::ResultWriter(const shared_ptr<ResultWriterConfigParam> p_c, uint32_t core_id):
+        p_writer_config(p_c), m_core_id(core_id),
+        m_running(false), drop_num(0), written_num(0) {
+    if (p_writer_config == nullptr) {
+        FATAL_ERROR("NULL result writer configuration.");
+    }
+    p_ring = make_shared<record_ring_t>(p_writer_config->queue_size);
+}
+
+auto ResultWriter::file_name(uint64_t seq) const -> string {
+    ostringstream oss;
+    oss << p_writer_config->save_dir << p_writer_config->save_file_prefix
+        << '_' << m_core_id << '_' << setw(4) << setfill('0') << seq << RESULT_FILE_SUFFIX;
+    return oss.str();
+}
+
+auto ResultWriter::write_all(const void * buf, size_t len) -> bool {
+    const char * p = (const char *) buf;
+    while (len > 0) {
+        const ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            WARNF("Result file write failed: %s", strerror(errno));
+            return false;
+        }
+        p += n;
+        len -= n;
+        file_bytes += n;
+    }
+    return true;
+}
+
+auto ResultWriter::open_next() -> bool {
+    close_current();
+
+    const string name = file_name(file_seq);
+    fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        WARNF("Open result file %s failed: %s", name.c_str(), strerror(errno));
+        return false;
+    }
+
+    file_bytes = 0;
+    file_open_ts = get_time_spec();
+    last_sync_ts = file_open_ts;
+
+    const ResultFileHeader header = make_result_header(m_core_id, file_seq, file_open_ts);
+    ++ file_seq;
+    return write_all(&header, sizeof(header));
+}
+
+void ResultWriter::close_current() {
+    if (fd < 0) {
+        return;
+    }
+    fsync(fd);
+    close(fd);
+    fd = -1;
+}
+
+auto ResultWriter::drain_once() -> size_t {
+    #define RESULT_DRAIN_BURST 1024
+    ResultRecord _records[RESULT_DRAIN_BURST];
+
+    size_t sum = 0, n = 0;
+    while ((n = p_ring->pop_bulk(_records, RESULT_DRAIN_BURST)) != 0) {
+        if (fd >= 0 && write_all(_records, n * sizeof(ResultRecord))) {
+            written_num.fetch_add(n, std::memory_order_relaxed);
+        } else {
+            drop_num.fetch_add(n, std::memory_order_relaxed);
+        }
+        sum += n;
+
+        if (p_writer_config->rotate_size != 0 && file_bytes >= p_writer_config->rotate_size) {
+            open_next();
+        }
+    }
+    return sum;
+}
+
+void ResultWriter::writer_loop() {
+    while (m_running.load(std::memory_order_acquire)) {
+        if (drain_once() == 0) {
+            usleep((useconds_t) p_writer_config->flush_interval * 1000);
+        }
+
+        const double_t now = get_time_spec();
+        if (p_writer_config->rotate_interval > 0 &&
+                now - file_open_ts >= p_writer_config->rotate_interval) {
+            open_next();
+        } else if (fd >= 0 && p_writer_config->fsync_interval > 0 &&
+                now - last_sync_ts >= p_writer_config->fsync_interval) {
+            fdatasync(fd);
+            last_sync_ts = now;
+        }
+    }
+    drain_once();
+    close_current();
+}
+
+auto ResultWriter::start() -> bool {
+    if (m_running.load()) {
+        return true;
+    }
+    if (p_writer_config->save_dir.length() != 0 &&
+            access(p_writer_config->save_dir.c_str(), 0) == -1 &&
+            mkdir(p_writer_config->save_dir.c_str(), 0755) != 0) {
+        WARNF("Create result directory %s failed.", p_writer_config->save_dir.c_str());
+        return false;
+    }
+    if (!open_next()) {
+        return false;
+    }
+    m_running.store(true, std::memory_order_release);
+    writer_thread = thread(&ResultWriter::writer_loop, this);
+    return true;
+}
+
+void ResultWriter::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    if (writer_thread.joinable()) {
+        writer_thread.join();
+    }
+    if (drop_num.load() != 0) {
+        WARNF("Result writer of core # %2d: %lu records dropped.", m_core_id, drop_num.load());
+    }
+}
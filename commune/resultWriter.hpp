@@ -0,0 +1,97 @@
+#pragma once
+
+#include "../common.hpp"
+#include "spscRing.hpp"
+#include "resultRecord.hpp"
+
+#include <atomic>
+
+using namespace std;
+
+namespace Whisper {
+
+struct ResultWriterConfigParam final {
+    // Output directory and file prefix, files are <dir><prefix>_<core>_<seq>.wres
+    string save_dir = "";
+    string save_file_prefix = "";
+    // Records buffered between the analyzer and the writer thread
+    size_t queue_size = 1 << 16;
+    // fsync period (s), 0 syncs only on rotation and close
+    double_t fsync_interval = 1.0;
+    // Rotate when the file exceeds this size (bytes), 0 disables
+    size_t rotate_size = 256 << 20;
+    // Rotate when the file is older than this (s), 0 disables
+    double_t rotate_interval = 0;
+    // Idle sleep of the writer thread (ms)
+    size_t flush_interval = 50;
+
+    ResultWriterConfigParam() = default;
+    virtual ~ResultWriterConfigParam() {}
+    ResultWriterConfigParam & operator=(const ResultWriterConfigParam &) = delete;
+    ResultWriterConfigParam(const ResultWriterConfigParam &) = delete;
+};
+
+// Streams the verdicts of one analyzer to append-only binary files.
+// The analyzer pushes into a lock-free ring, a background thread writes.
+class ResultWriter final {
+
+    private:
+        using record_ring_t = SpscRing<ResultRecord>;
+
+        const shared_ptr<ResultWriterConfigParam> p_writer_config;
+        const uint32_t m_core_id;
+
+        shared_ptr<record_ring_t> p_ring;
+
+        atomic<bool> m_running;
+        atomic<uint64_t> drop_num;
+        atomic<uint64_t> written_num;
+        thread writer_thread;
+
+        // Writer thread state
+        int fd = -1;
+        uint64_t file_seq = 0;
+        size_t file_bytes = 0;
+        double_t file_open_ts = 0;
+        double_t last_sync_ts = 0;
+
+        auto file_name(uint64_t seq) const -> string;
+        auto open_next() -> bool;
+        void close_current();
+        auto write_all(const void * buf, size_t len) -> bool;
+        auto drain_once() -> size_t;
+        void writer_loop();
+
+    public:
+        ResultWriter(const shared_ptr<ResultWriterConfigParam> p_c, uint32_t core_id);
+
+        virtual ~ResultWriter() {
+            stop();
+        }
+        ResultWriter & operator=(const ResultWriter &) = delete;
+        ResultWriter(const ResultWriter &) = delete;
+
+        // Open the first file and start the writer thread
+        auto start() -> bool;
+        // Drain the queue, fsync and close
+        void stop();
+
+        // Analyzer side, never blocks; full queue drops the record
+        auto inline push(const ResultRecord & r) -> bool {
+            if (!p_ring->push(r)) {
+                drop_num.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        }
+
+        auto get_drop_num() const -> uint64_t {
+            return drop_num.load(std::memory_order_relaxed);
+        }
+
+        auto get_written_num() const -> uint64_t {
+            return written_num.load(std::memory_order_relaxed);
+        }
+};
+
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "../common.hpp"
+#include "spectrumKernels.hpp"
+
+#include <vector>
+
+using namespace std;
+
+namespace Whisper {
+
+// Twiddles of one DFT size, shared by the flows of an analyzer. Frames match
+// torch::stft(x, n_fft): rectangular window, hop of n_fft / 4, n_fft / 2 + 1 bins.
+struct SpectrumPlan final {
+    size_t n_fft = 0, hop = 0, bins = 0;
+    // Frames per detection window
+    size_t mean_win = 0;
+    // Row k holds cos / sin (2 pi k j / n_fft) for j < n_fft
+    vector<float> cos_t, sin_t;
+    // Picked once for n_fft, the generic loops unless specialize is off
+    frame_kernel_t frame_fn = frame_kernel_generic;
+
+    SpectrumPlan(size_t _n_fft, size_t _mean_win, bool specialize = true) :
+            n_fft(_n_fft), hop(max<size_t>(_n_fft / 4, 1)), bins(_n_fft / 2 + 1),
+            mean_win(max<size_t>(_mean_win, 1)) {
+        if (specialize) {
+            frame_fn = select_frame_kernel(n_fft);
+        }
+        cos_t.resize(bins * n_fft);
+        sin_t.resize(bins * n_fft);
+        for (size_t k = 0; k < bins; k ++) {
+            for (size_t j = 0; j < n_fft; j ++) {
+                // reduce k * j first, the angle stays exact for large n_fft
+                const double_t a = 2 * M_PI * ((k * j) % n_fft) / n_fft;
+                cos_t[k * n_fft + j] = (float) cos(a);
+                sin_t[k * n_fft + j] = (float) sin(a);
+            }
+        }
+    }
+
+    virtual ~SpectrumPlan() {}
+    SpectrumPlan & operator=(const SpectrumPlan &) = delete;
+    SpectrumPlan(const SpectrumPlan &) = delete;
+};
+
+// Spectral state of one flow: the last n_fft samples and the running sum of the log
+// power rows of the current detection window. A frame is transformed once, when the
+// hop completes it, so a packet costs O(n_fft) at most and the history is never kept.
+// The ring is transformed in place: a rotated frame has the same power spectrum.
+class SlidingSpectrum final {
+
+    private:
+        // Ring of the last n_fft samples, pos is the next to overwrite
+        vector<float> ring;
+        vector<float> win_sum;
+        size_t pos = 0;
+        uint64_t num = 0;
+        size_t win_frames = 0;
+
+        void inline frame(const SpectrumPlan & plan) {
+            plan.frame_fn(plan, ring.data(), win_sum.data());
+            win_frames ++;
+        }
+
+    public:
+        SlidingSpectrum() = default;
+        virtual ~SlidingSpectrum() {}
+
+        auto inline is_initialized() const -> bool {
+            return !ring.empty();
+        }
+
+        // Append samples; on_window(sum, frames) gets every window of plan.mean_win frames
+        // completed on the way, after which the window restarts
+        template <typename F>
+        void push(const SpectrumPlan & plan, const float * x, size_t len, F on_window) {
+            if (ring.empty()) {
+                ring.assign(plan.n_fft, 0);
+                win_sum.assign(plan.bins, 0);
+            }
+            for (size_t i = 0; i < len; i ++) {
+                ring[pos] = x[i];
+                pos = (pos + 1) % plan.n_fft;
+                num ++;
+                if (num < plan.n_fft || (num - plan.n_fft) % plan.hop != 0) {
+                    continue;
+                }
+                frame(plan);
+                if (win_frames == plan.mean_win) {
+                    on_window(win_sum, win_frames);
+                    fill(win_sum.begin(), win_sum.end(), 0);
+                    win_frames = 0;
+                }
+            }
+        }
+
+        // A flow shorter than n_fft gets one frame of its zero padded samples: the ring
+        // starts zeroed, and the power does not depend on the rotation of the frame
+        void pad_frame(const SpectrumPlan & plan) {
+            if (num > 0 && num < plan.n_fft && win_frames == 0) {
+                frame(plan);
+            }
+        }
+
+        // Sum and number of the frames of the window in progress
+        auto inline window_sum() const -> const vector<float> & {
+            return win_sum;
+        }
+
+        auto inline window_frames() const -> size_t {
+            return win_frames;
+        }
+
+        auto inline sample_num() const -> uint64_t {
+            return num;
+        }
+
+        auto inline memory_bytes() const -> size_t {
+            return (ring.capacity() + win_sum.capacity()) * sizeof(float);
+        }
+};
+
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <new>
+#include <numa.h>
+#include <sys/mman.h>
+
+#include <rte_malloc.h>
+#include <rte_lcore.h>
+
+using namespace std;
+
+namespace Whisper {
+
+// Socket of a DPDK lcore, SOCKET_ID_ANY when it is unknown
+static inline auto socket_of_core(uint32_t core_id) -> int {
+    if (core_id >= RTE_MAX_LCORE) {
+        return SOCKET_ID_ANY;
+    }
+    return (int) rte_lcore_to_socket_id(core_id);
+}
+
+// Allocate n elements of T on the given socket. DPDK hugepage memory is preferred,
+// anonymous memory bound to the node (with transparent huge pages) is the fallback.
+// Every element is constructed here, so the pages are faulted in at init time
+// instead of on the first packet.
+template <typename T>
+auto make_socket_array(size_t n, int socket_id, const char * tag) -> shared_ptr<T[]> {
+    const size_t bytes = max<size_t>(n, 1) * sizeof(T);
+
+    bool from_rte = true;
+    void * p = rte_malloc_socket(tag, bytes, RTE_CACHE_LINE_SIZE, socket_id);
+
+    if (p == nullptr) {
+        from_rte = false;
+        p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            WARNF("%s: allocation of %ld bytes failed.", tag, bytes);
+            return nullptr;
+        }
+        madvise(p, bytes, MADV_HUGEPAGE);
+        if (socket_id != SOCKET_ID_ANY && numa_available() >= 0) {
+            numa_tonode_memory(p, bytes, socket_id);
+        }
+        WARNF("%s: no hugepage memory on socket %d, use %ld bytes of normal pages.",
+              tag, socket_id, bytes);
+    }
+
+    T * arr = static_cast<T *>(p);
+    for (size_t i = 0; i < n; i ++) {
+        new (arr + i) T();
+    }
+
+    return shared_ptr<T[]>(arr, [n, bytes, from_rte] (T * a) {
+        for (size_t i = 0; i < n; i ++) {
+            a[i].~T();
+        }
+        if (from_rte) {
+            rte_free(a);
+        } else {
+            munmap(a, bytes);
+        }
+    });
+}
+
+}
@@ -0,0 +1,115 @@
+#include "spectrumKernels.hpp"
+#include "slidingSpectrum.hpp"
+
+using namespace Whisper;
+
+namespace {
+
+// log linear transformation, inf and nan are erased as in frequency_transform
+auto inline log_power(float re, float im) -> float {
+    const float v = log2(re * re + im * im + 1);
+    return std::isfinite(v) ? v : 0;
+}
+
+template <size_t N>
+struct BitReverse {
+    uint8_t idx[N];
+
+    constexpr BitReverse() : idx() {
+        for (size_t i = 0; i < N; i ++) {
+            size_t r = 0;
+            for (size_t b = 1; b < N; b <<= 1) {
+                r = (r << 1) | ((i & b) ? 1 : 0);
+            }
+            idx[i] = (uint8_t) r;
+        }
+    }
+};
+
+// Butterflies of the sub-transforms of length Len, then the next stage: the stages and
+// their loop bounds are fixed by the template, the compiler lays out each of them
+template <size_t N, size_t Len>
+struct FftStage {
+    static inline void run(float * re, float * im, const float * c, const float * s) {
+        constexpr size_t half = Len / 2, step = N / Len;
+        for (size_t i = 0; i < N; i += Len) {
+            for (size_t j = 0; j < half; j ++) {
+                const float wr = c[j * step], wi = -s[j * step];
+                const size_t a = i + j, b = a + half;
+                const float tr = re[b] * wr - im[b] * wi;
+                const float ti = re[b] * wi + im[b] * wr;
+                re[b] = re[a] - tr;
+                im[b] = im[a] - ti;
+                re[a] += tr;
+                im[a] += ti;
+            }
+        }
+        FftStage<N, Len * 2>::run(re, im, c, s);
+    }
+};
+
+template <size_t N>
+struct FftStage<N, N * 2> {
+    static inline void run(float *, float *, const float *, const float *) {}
+};
+
+// Radix-2 FFT, N a power of two
+template <size_t N>
+void frame_kernel_fft(const SpectrumPlan & plan, const float * ring, float * win_sum) {
+    static constexpr BitReverse<N> rev{};
+    float re[N], im[N];
+    for (size_t j = 0; j < N; j ++) {
+        re[j] = ring[rev.idx[j]];
+        im[j] = 0;
+    }
+    // row 1 of the plan holds the twiddles cos / sin (2 pi j / N)
+    FftStage<N, 2>::run(re, im, plan.cos_t.data() + N, plan.sin_t.data() + N);
+    for (size_t k = 0; k < N / 2 + 1; k ++) {
+        win_sum[k] += log_power(re[k], im[k]);
+    }
+}
+
+// Direct DFT of a fixed size
+template <size_t N>
+void frame_kernel_dft(const SpectrumPlan & plan, const float * ring, float * win_sum) {
+    constexpr size_t bins = N / 2 + 1;
+    const float * c = plan.cos_t.data(), * s = plan.sin_t.data();
+    for (size_t k = 0; k < bins; k ++) {
+        float re = 0, im = 0;
+        for (size_t j = 0; j < N; j ++) {
+            re += ring[j] * c[k * N + j];
+            im += ring[j] * s[k * N + j];
+        }
+        win_sum[k] += log_power(re, im);
+    }
+}
+
+}
+
+void Whisper::frame_kernel_generic(const SpectrumPlan & plan, const float * ring, float * win_sum) {
+    const size_t n = plan.n_fft;
+    for (size_t k = 0; k < plan.bins; k ++) {
+        const float * c = &plan.cos_t[k * n], * s = &plan.sin_t[k * n];
+        float re = 0, im = 0;
+        for (size_t j = 0; j < n; j ++) {
+            re += ring[j] * c[j];
+            im += ring[j] * s[j];
+        }
+        win_sum[k] += log_power(re, im);
+    }
+}
+
+auto Whisper::select_frame_kernel(size_t n_fft) -> frame_kernel_t {
+    switch (n_fft) {
+        case 16:  return frame_kernel_fft<16>;
+        case 32:  return frame_kernel_fft<32>;
+        case 50:  return frame_kernel_dft<50>;
+        case 64:  return frame_kernel_fft<64>;
+        case 128: return frame_kernel_fft<128>;
+        default:  return frame_kernel_generic;
+    }
+}
+
+auto Whisper::is_specialized_frame_kernel(size_t n_fft) -> bool {
+    return select_frame_kernel(n_fft) != frame_kernel_generic;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "../common.hpp"
+
+using namespace std;
+
+namespace Whisper {
+
+struct SpectrumPlan;
+
+// One frame of the incremental spectrum: the ring of the last n_fft samples is transformed
+// and the log power of each bin is added to win_sum. The ring is taken as it is stored,
+// a circular shift of the frame does not change the power of any bin.
+using frame_kernel_t = void (*)(const SpectrumPlan & plan, const float * ring, float * win_sum);
+
+// DFT sizes with a kernel compiled for them: radix-2 FFT stages for the powers of two,
+// a fixed size DFT otherwise
+#define SPECTRUM_SPECIALIZED_SIZES "16, 32, 50, 64, 128"
+
+// Kernel of a DFT size, the generic loops when it has no specialization
+auto select_frame_kernel(size_t n_fft) -> frame_kernel_t;
+
+auto is_specialized_frame_kernel(size_t n_fft) -> bool;
+
+void frame_kernel_generic(const SpectrumPlan & plan, const float * ring, float * win_sum);
+
+}
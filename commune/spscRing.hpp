@@ -0,0 +1,103 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <atomic>
+
+using namespace std;
+
+namespace Whisper {
+
+// Single-producer single-consumer ring, used to hand records from one
+// ParserWorker to one AnalyzerWorker without locking.
+template <typename T>
+class SpscRing final {
+
+    private:
+        static constexpr size_t CACHE_LINE = 64;
+
+        size_t capacity;
+        size_t mask;
+        shared_ptr<T[]> slots;
+
+        // Consumer side: read position and a cached copy of the producer position
+        alignas(CACHE_LINE) atomic<size_t> head;
+        size_t cached_tail = 0;
+
+        // Producer side: write position and a cached copy of the consumer position
+        alignas(CACHE_LINE) atomic<size_t> tail;
+        size_t cached_head = 0;
+
+    public:
+        // Slot count actually used for a requested capacity
+        auto static inline capacity_for(size_t min_capacity) -> size_t {
+            size_t r = 2;
+            while (r < min_capacity) {
+                r <<= 1;
+            }
+            return r;
+        }
+
+        explicit SpscRing(size_t min_capacity):
+                capacity(capacity_for(min_capacity)),
+                mask(capacity - 1), head(0), tail(0) {
+            slots = shared_ptr<T[]>(new T[capacity](), std::default_delete<T[]>());
+        }
+
+        // Use caller provided storage of capacity_for(min_capacity) constructed slots
+        SpscRing(size_t min_capacity, shared_ptr<T[]> storage):
+                capacity(capacity_for(min_capacity)),
+                mask(capacity - 1), slots(storage), head(0), tail(0) {
+            if (slots == nullptr) {
+                FATAL_ERROR("Ring storage not found.");
+            }
+        }
+
+        virtual ~SpscRing() {}
+        SpscRing & operator=(const SpscRing &) = delete;
+        SpscRing(const SpscRing &) = delete;
+
+        // Producer: append one record, false if the ring is full
+        auto inline push(const T & v) -> bool {
+            const size_t _t = tail.load(std::memory_order_relaxed);
+            if (_t - cached_head == capacity) {
+                cached_head = head.load(std::memory_order_acquire);
+                if (_t - cached_head == capacity) {
+                    return false;
+                }
+            }
+            slots[_t & mask] = v;
+            tail.store(_t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer: move up to max_n records into out, returns the number moved
+        auto inline pop_bulk(T * out, size_t max_n) -> size_t {
+            const size_t _h = head.load(std::memory_order_relaxed);
+            if (cached_tail - _h < max_n) {
+                cached_tail = tail.load(std::memory_order_acquire);
+            }
+            const size_t n = min(cached_tail - _h, max_n);
+            if (n == 0) {
+                return 0;
+            }
+
+            const size_t first = min(n, capacity - (_h & mask));
+            std::copy(slots.get() + (_h & mask), slots.get() + (_h & mask) + first, out);
+            std::copy(slots.get(), slots.get() + (n - first), out + first);
+
+            head.store(_h + n, std::memory_order_release);
+            return n;
+        }
+
+        // Approximate occupancy, exact when called from either endpoint
+        auto inline size() const -> size_t {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        auto inline get_capacity() const -> size_t {
+            return capacity;
+        }
+};
+
+}
@@ -0,0 +1,47 @@
+#include "stageProfiler.hpp"
+
+using namespace Whisper;
+
+atomic<bool> StageProfiler::enabled(false);
+
+static const double_t __report_quantile[] = {0.5, 0.9, 0.99, 0.999};
+
+static inline auto __cycles_to_us(uint64_t c) -> double_t {
+    const uint64_t hz = rte_get_tsc_hz();
+    return hz ? c * 1e6 / hz : 0;
+}
+
+auto StageProfiler::report(const vector<HistogramSnapshot> & snapshots) -> string {
+    stringstream ss;
+    ss << setw(10) << "stage" << setw(12) << "count"
+       << setw(12) << "p50(us)" << setw(12) << "p90(us)" << setw(12) << "p99(us)"
+       << setw(12) << "p999(us)" << setw(12) << "max(us)" << endl;
+
+    for (size_t i = 0; i < snapshots.size() && i < STAGE_NUM; i ++) {
+        const auto & snap = snapshots[i];
+        ss << setw(10) << pipeline_stage_name[i] << setw(12) << snap.total();
+        ss << fixed << setprecision(2);
+        for (const auto q: __report_quantile) {
+            ss << setw(12) << __cycles_to_us(snap.percentile(q));
+        }
+        ss << setw(12) << __cycles_to_us(snap.max_value) << endl;
+        ss.unsetf(ios_base::floatfield);
+    }
+    return ss.str();
+}
+
+auto StageProfiler::report_json(const vector<HistogramSnapshot> & snapshots) -> json {
+    json j;
+    for (size_t i = 0; i < snapshots.size() && i < STAGE_NUM; i ++) {
+        const auto & snap = snapshots[i];
+        json _j;
+        _j["count"] = snap.total();
+        _j["p50_us"] = __cycles_to_us(snap.percentile(0.5));
+        _j["p90_us"] = __cycles_to_us(snap.percentile(0.9));
+        _j["p99_us"] = __cycles_to_us(snap.percentile(0.99));
+        _j["p999_us"] = __cycles_to_us(snap.percentile(0.999));
+        _j["max_us"] = __cycles_to_us(snap.max_value);
+        j[pipeline_stage_name[i]] = _j;
+    }
+    return j;
+}
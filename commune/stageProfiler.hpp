@@ -0,0 +1,183 @@
+#pragma once
+
+#include "../common.hpp"
+
+#include <atomic>
+#include <vector>
+#include <map>
+
+#include <rte_cycles.h>
+
+using namespace std;
+
+namespace Whisper {
+
+// Log-linear latency histogram (HDR style): 16 linear sub-buckets per power of two,
+// i.e. about 6% relative error over the whole 64 bit range. Written by one thread,
+// read by any thread at any time.
+class LatencyHistogram final {
+
+    public:
+        static constexpr size_t SUB_BITS = 4;
+        static constexpr size_t SUB_COUNT = (size_t) 1 << SUB_BITS;
+        static constexpr size_t BUCKET_NUM = (64 - SUB_BITS + 1) * SUB_COUNT;
+
+        auto static inline bucket_of(uint64_t v) -> size_t {
+            if (v < SUB_COUNT) {
+                return (size_t) v;
+            }
+            const size_t e = 63 - __builtin_clzll(v);
+            const size_t shift = e - SUB_BITS;
+            return (e - SUB_BITS + 1) * SUB_COUNT + (size_t) ((v >> shift) - SUB_COUNT);
+        }
+
+        // Upper bound of the values of a bucket
+        auto static inline bucket_upper(size_t b) -> uint64_t {
+            if (b < SUB_COUNT) {
+                return b;
+            }
+            const size_t shift = b / SUB_COUNT - 1;
+            const uint64_t m = SUB_COUNT + b % SUB_COUNT;
+            return ((m + 1) << shift) - 1;
+        }
+
+    private:
+        atomic<uint64_t> buckets[BUCKET_NUM];
+        atomic<uint64_t> max_value;
+
+        void static inline bump(atomic<uint64_t> & c, uint64_t d) {
+            c.store(c.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+        }
+
+    public:
+        LatencyHistogram() {
+            reset();
+        }
+        virtual ~LatencyHistogram() {}
+        LatencyHistogram & operator=(const LatencyHistogram &) = delete;
+        LatencyHistogram(const LatencyHistogram &) = delete;
+
+        // Owner thread only
+        void inline record(uint64_t v) {
+            bump(buckets[bucket_of(v)], 1);
+            if (v > max_value.load(std::memory_order_relaxed)) {
+                max_value.store(v, std::memory_order_relaxed);
+            }
+        }
+
+        void reset() {
+            for (auto & b: buckets) {
+                b.store(0, std::memory_order_relaxed);
+            }
+            max_value.store(0, std::memory_order_relaxed);
+        }
+
+        // Add the current counts to a plain histogram
+        void merge_into(vector<uint64_t> & counts, uint64_t & max_v) const {
+            counts.resize(BUCKET_NUM, 0);
+            for (size_t i = 0; i < BUCKET_NUM; i ++) {
+                counts[i] += buckets[i].load(std::memory_order_relaxed);
+            }
+            max_v = max(max_v, max_value.load(std::memory_order_relaxed));
+        }
+};
+
+// Merged, immutable view of one or more histograms
+struct HistogramSnapshot final {
+    vector<uint64_t> counts;
+    uint64_t max_value = 0;
+
+    auto total() const -> uint64_t {
+        uint64_t sum = 0;
+        for (const auto c: counts) {
+            sum += c;
+        }
+        return sum;
+    }
+
+    // Value at quantile q in [0, 1], upper bucket bound
+    auto percentile(double_t q) const -> uint64_t {
+        const uint64_t n = total();
+        if (n == 0) {
+            return 0;
+        }
+        const uint64_t rank = max<uint64_t>(1, (uint64_t) ceil(q * n));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i ++) {
+            seen += counts[i];
+            if (seen >= rank) {
+                return min(LatencyHistogram::bucket_upper(i), max_value);
+            }
+        }
+        return max_value;
+    }
+};
+
+using pipeline_stage_t = uint8_t;
+enum pipeline_stage : pipeline_stage_t {
+    STAGE_FETCH     = 0,
+    STAGE_AGGREGATE = 1,
+    STAGE_ENCODE    = 2,
+    STAGE_TRANSFORM = 3,
+    STAGE_DISTANCE  = 4,
+    STAGE_LEARNER   = 5,
+    STAGE_NUM       = 6
+};
+
+static const char * const pipeline_stage_name[STAGE_NUM] = {
+    "fetch", "aggregate", "encode", "transform", "distance", "learner"
+};
+
+// Per-worker TSC stage timers. Off by default, toggled at runtime for all workers.
+class StageProfiler final {
+
+    private:
+        static atomic<bool> enabled;
+
+        LatencyHistogram hist[STAGE_NUM];
+
+    public:
+        StageProfiler() = default;
+        virtual ~StageProfiler() {}
+        StageProfiler & operator=(const StageProfiler &) = delete;
+        StageProfiler(const StageProfiler &) = delete;
+
+        static void set_enabled(bool e) {
+            enabled.store(e, std::memory_order_relaxed);
+        }
+
+        static auto inline is_enabled() -> bool {
+            return enabled.load(std::memory_order_relaxed);
+        }
+
+        // Start of a stage, 0 when profiling is off
+        auto static inline begin() -> uint64_t {
+            return is_enabled() ? rte_rdtsc() : 0;
+        }
+
+        // End of a stage started by begin()
+        void inline end(pipeline_stage_t stage, uint64_t t0) {
+            if (t0 != 0) {
+                hist[stage].record(rte_rdtsc() - t0);
+            }
+        }
+
+        void reset() {
+            for (auto & h: hist) {
+                h.reset();
+            }
+        }
+
+        void merge_into(vector<HistogramSnapshot> & snapshots) const {
+            snapshots.resize(STAGE_NUM);
+            for (size_t i = 0; i < STAGE_NUM; i ++) {
+                hist[i].merge_into(snapshots[i].counts, snapshots[i].max_value);
+            }
+        }
+
+        // Percentile table of merged stage histograms, in microseconds
+        auto static report(const vector<HistogramSnapshot> & snapshots) -> string;
+        auto static report_json(const vector<HistogramSnapshot> & snapshots) -> json;
+};
+
+}
@@ -0,0 +1,371 @@
+#include "trafficGenerator.hpp"
+
+#include <pcapplusplus/RawPacket.h>
+#include <pcapplusplus/PcapFileDevice.h>
+
+using namespace Whisper;
+
+static inline auto __parse_ipv4(const string & s, uint32_t & out) -> bool {
+    in_addr a;
+    if (inet_pton(AF_INET, s.c_str(), &a) != 1) {
+        return false;
+    }
+    out = ntohl(a.s_addr);
+    return true;
+}
+
+static inline auto __ipv4_string(uint32_t host_order) -> string {
+    char buf[INET_ADDRSTRLEN];
+    const in_addr a = {htonl(host_order)};
+    inet_ntop(AF_INET, &a, buf, sizeof(buf));
+    return buf;
+}
+
+void TrafficGenerator::reset() {
+    const auto & cfg = *p_gen_config;
+
+    gen.seed(cfg.seed);
+    source_sampler.init(cfg.num_sources, cfg.source_zipf);
+    flow_size_sampler.init(cfg.max_flow_size, cfg.flow_zipf);
+
+    __parse_ipv4(cfg.source_base, source_base);
+    attack_base.clear();
+    next_attack.clear();
+    attack_cursor.assign(cfg.attacks.size(), 0);
+    for (const auto & a: cfg.attacks) {
+        uint32_t base = 0;
+        __parse_ipv4(a.source_base, base);
+        attack_base.push_back(base);
+        next_attack.push_back(a.start);
+    }
+
+    ts_start_tick = (uint64_t) llround((cfg.ts_start > 0 ? cfg.ts_start : get_time_spec()) / cfg.ts_unit);
+    elapsed = 0;
+    generated = 0;
+    next_background = arrival_gap(cfg.rate, cfg.arrival);
+
+    flows.clear();
+    for (size_t i = 0; i < cfg.active_flows; i ++) {
+        flows.push_back(new_flow());
+    }
+}
+
+auto TrafficGenerator::arrival_gap(double_t rate, arrival_process_t process) -> double_t {
+    switch (process) {
+        case ARRIVAL_CONSTANT:
+            return 1.0 / rate;
+        case ARRIVAL_PARETO: {
+            // scale chosen for a mean gap of 1 / rate
+            const double_t shape = p_gen_config->pareto_shape;
+            const double_t xm = (shape - 1) / (shape * rate);
+            uniform_real_distribution<double_t> uni(1e-12, 1);
+            return xm / pow(uni(gen), 1.0 / shape);
+        }
+        default: {
+            exponential_distribution<double_t> expo(rate);
+            return expo(gen);
+        }
+    }
+}
+
+auto TrafficGenerator::new_flow() -> ActiveFlow {
+    static const uint16_t protos[] = {6, 17, 1};
+
+    ActiveFlow f;
+    f.ip_src = htonl(source_base + (uint32_t) (source_sampler(gen) - 1));
+    f.proto = protos[proto_dist(gen)];
+    f.remaining = flow_size_sampler(gen);
+    return f;
+}
+
+void TrafficGenerator::background_record(PktMetadata & out) {
+    // interleave the active flows, a finished flow is replaced by a new one
+    uniform_int_distribution<size_t> pick(0, flows.size() - 1);
+    auto & f = flows[pick(gen)];
+
+    uniform_int_distribution<uint16_t> small_len(40, 80), medium_len(81, 1000);
+    uint16_t length = 1500;
+    switch (size_class(gen)) {
+        case 0: length = small_len(gen); break;
+        case 1: length = medium_len(gen); break;
+        default: break;
+    }
+
+    out.ip_src = f.ip_src;
+    out.proto = f.proto;
+    out.length = length;
+    if (-- f.remaining == 0) {
+        f = new_flow();
+    }
+}
+
+void TrafficGenerator::attack_record(size_t k, PktMetadata & out) {
+    const auto & a = p_gen_config->attacks[k];
+    const size_t sources = max<size_t>(a.sources, 1);
+
+    out.proto = 6;
+    switch (a.type) {
+        case ATTACK_SYN_FLOOD: {
+            uniform_int_distribution<size_t> src(0, sources - 1);
+            out.ip_src = htonl(attack_base[k] + (uint32_t) src(gen));
+            out.length = 40;
+            break;
+        }
+        case ATTACK_SLOWLORIS: {
+            uniform_int_distribution<uint16_t> len(60, 100);
+            out.ip_src = htonl(attack_base[k] + (uint32_t) (attack_cursor[k] ++ % sources));
+            out.length = len(gen);
+            break;
+        }
+        default: {
+            out.ip_src = htonl(attack_base[k] + (uint32_t) (attack_cursor[k] ++ % sources));
+            out.length = 44;
+            break;
+        }
+    }
+}
+
+auto TrafficGenerator::next(PktMetadata & out) -> uint64_t {
+    const auto & cfg = *p_gen_config;
+
+    // the stream with the earliest pending record
+    size_t which = next_attack.size();
+    double_t t = next_background;
+    for (size_t k = 0; k < next_attack.size(); k ++) {
+        if (next_attack[k] < t) {
+            t = next_attack[k];
+            which = k;
+        }
+    }
+
+    elapsed = t;
+    if (which == next_attack.size()) {
+        background_record(out);
+        next_background += arrival_gap(cfg.rate, cfg.arrival);
+    } else {
+        const auto & a = cfg.attacks[which];
+        attack_record(which, out);
+        next_attack[which] += arrival_gap(a.rate,
+                                          a.type == ATTACK_SYN_FLOOD ? ARRIVAL_POISSON : ARRIVAL_CONSTANT);
+        if (next_attack[which] > a.start + a.duration) {
+            next_attack[which] = HUGE_VAL;
+        }
+    }
+    const uint64_t tick = ts_start_tick + (uint64_t) llround(elapsed / cfg.ts_unit);
+    out.ts = (double_t) tick;
+    ++ generated;
+    return tick;
+}
+
+auto TrafficGenerator::next_batch(PktMetadata * out, size_t n) -> size_t {
+    for (size_t i = 0; i < n; i ++) {
+        next(out[i]);
+    }
+    return n;
+}
+
+auto TrafficGenerator::fill_mbufs(rte_mempool * p_pool, rte_mbuf ** out, size_t n) -> size_t {
+    if (rte_pktmbuf_alloc_bulk(p_pool, out, n) != 0) {
+        return 0;
+    }
+    PktMetadata meta;
+    uint8_t frame[PEREGRINE_FRAME_MIN_LEN];
+    for (size_t i = 0; i < n; i ++) {
+        const uint64_t tick = next(meta);
+        const size_t len = encode_peregrine_frame(meta, frame, tick);
+        char * p = rte_pktmbuf_append(out[i], len);
+        if (p == nullptr) {
+            for (size_t j = i; j < n; j ++) {
+                rte_pktmbuf_free(out[j]);
+            }
+            return i;
+        }
+        memcpy(p, frame, len);
+    }
+    return n;
+}
+
+auto TrafficGenerator::write_pcap(const string & file, size_t num, double_t duration) -> size_t {
+    pcpp::PcapFileWriterDevice writer(file);
+    if (!writer.open()) {
+        WARNF("Traffic generator: open %s failed.", file.c_str());
+        return 0;
+    }
+
+    const double_t ts_unit = p_gen_config->ts_unit;
+    const double_t end = elapsed + duration;
+    PktMetadata meta;
+    uint8_t frame[PEREGRINE_FRAME_MIN_LEN];
+    size_t written = 0;
+    while ((num == 0 || written < num) && (duration <= 0 || elapsed < end)) {
+        const uint64_t tick = next(meta);
+        const size_t len = encode_peregrine_frame(meta, frame, tick);
+        // whole seconds first, the fraction keeps its precision
+        const uint64_t tick_per_sec = (uint64_t) llround(1 / ts_unit);
+        timeval tv;
+        if (tick_per_sec != 0 && fabs(tick_per_sec * ts_unit - 1) < 1e-9) {
+            tv.tv_sec = (time_t) (tick / tick_per_sec);
+            tv.tv_usec = (suseconds_t) ((tick % tick_per_sec) * 1e6 / tick_per_sec);
+        } else {
+            const double_t sec = tick * ts_unit;
+            tv.tv_sec = (time_t) sec;
+            tv.tv_usec = (suseconds_t) ((sec - floor(sec)) * 1e6);
+        }
+        pcpp::RawPacket raw(frame, (int) len, tv, false);
+        if (!writer.writePacket(raw)) {
+            WARNF("Traffic generator: write %s failed.", file.c_str());
+            break;
+        }
+        ++ written;
+    }
+    writer.close();
+    return written;
+}
+
+auto TrafficGenerator::malicious_sources() const -> vector<string> {
+    vector<string> ve;
+    for (size_t k = 0; k < p_gen_config->attacks.size(); k ++) {
+        for (size_t i = 0; i < max<size_t>(p_gen_config->attacks[k].sources, 1); i ++) {
+            ve.push_back(__ipv4_string(attack_base[k] + (uint32_t) i));
+        }
+    }
+    return ve;
+}
+
+auto TrafficGenerator::write_labels(const string & file) const -> bool {
+    ofstream of(file);
+    if (!of) {
+        WARNF("Traffic generator: write labels to %s failed.", file.c_str());
+        return false;
+    }
+    json j;
+    j[p_gen_config->label_tag] = malicious_sources();
+    of << j.dump(4) << endl;
+    return true;
+}
+
+auto TrafficGenerator::configure_via_json(const json & jin) -> bool {
+    if (p_gen_config != nullptr) {
+        WARN("Traffic generator configuration overlap.");
+        return false;
+    }
+
+    p_gen_config = make_shared<TrafficGenConfigParam>();
+    if (p_gen_config == nullptr) {
+        WARNF("Traffic generator configuration paramerter bad allocation.");
+        return false;
+    }
+
+    try {
+        uint32_t _addr = 0;
+        if (jin.count("num_sources")) {
+            p_gen_config->num_sources =
+                static_cast<decltype(p_gen_config->num_sources)>(jin["num_sources"]);
+            if (p_gen_config->num_sources == 0) {
+                throw logic_error("Parse error Json tag: num_sources\n");
+            }
+        }
+        if (jin.count("source_base")) {
+            p_gen_config->source_base =
+                static_cast<decltype(p_gen_config->source_base)>(jin["source_base"]);
+            if (!__parse_ipv4(p_gen_config->source_base, _addr)) {
+                throw logic_error("Parse error Json tag: source_base\n");
+            }
+        }
+        if (jin.count("source_zipf")) {
+            p_gen_config->source_zipf =
+                static_cast<decltype(p_gen_config->source_zipf)>(jin["source_zipf"]);
+        }
+        if (jin.count("flow_zipf")) {
+            p_gen_config->flow_zipf =
+                static_cast<decltype(p_gen_config->flow_zipf)>(jin["flow_zipf"]);
+        }
+        if (jin.count("max_flow_size")) {
+            p_gen_config->max_flow_size =
+                static_cast<decltype(p_gen_config->max_flow_size)>(jin["max_flow_size"]);
+        }
+        if (jin.count("active_flows")) {
+            p_gen_config->active_flows =
+                static_cast<decltype(p_gen_config->active_flows)>(jin["active_flows"]);
+            if (p_gen_config->active_flows == 0) {
+                throw logic_error("Parse error Json tag: active_flows\n");
+            }
+        }
+        if (jin.count("rate")) {
+            p_gen_config->rate = static_cast<decltype(p_gen_config->rate)>(jin["rate"]);
+            if (p_gen_config->rate <= 0) {
+                throw logic_error("Parse error Json tag: rate\n");
+            }
+        }
+        if (jin.count("arrival")) {
+            const string _s = static_cast<string>(jin["arrival"]);
+            if (arrival_process_map.find(_s) == arrival_process_map.end()) {
+                throw logic_error("Parse error Json tag: arrival (constant|poisson|pareto)\n");
+            }
+            p_gen_config->arrival = arrival_process_map.at(_s);
+        }
+        if (jin.count("pareto_shape")) {
+            p_gen_config->pareto_shape =
+                static_cast<decltype(p_gen_config->pareto_shape)>(jin["pareto_shape"]);
+            if (p_gen_config->pareto_shape <= 1) {
+                throw logic_error("Parse error Json tag: pareto_shape (must be > 1)\n");
+            }
+        }
+        if (jin.count("ts_unit")) {
+            p_gen_config->ts_unit = static_cast<decltype(p_gen_config->ts_unit)>(jin["ts_unit"]);
+            if (p_gen_config->ts_unit <= 0) {
+                throw logic_error("Parse error Json tag: ts_unit\n");
+            }
+        }
+        if (jin.count("ts_start")) {
+            p_gen_config->ts_start = static_cast<decltype(p_gen_config->ts_start)>(jin["ts_start"]);
+        }
+        if (jin.count("seed")) {
+            p_gen_config->seed = static_cast<decltype(p_gen_config->seed)>(jin["seed"]);
+        }
+        if (jin.count("label_tag")) {
+            p_gen_config->label_tag =
+                static_cast<decltype(p_gen_config->label_tag)>(jin["label_tag"]);
+        }
+        if (jin.count("attacks")) {
+            for (const auto & ja: jin["attacks"]) {
+                AttackConfigParam a;
+                if (ja.count("type")) {
+                    const string _s = static_cast<string>(ja["type"]);
+                    if (attack_type_map.find(_s) == attack_type_map.end()) {
+                        throw logic_error("Parse error Json tag: attacks.type (syn_flood|slowloris|scan)\n");
+                    }
+                    a.type = attack_type_map.at(_s);
+                }
+                if (ja.count("start")) {
+                    a.start = static_cast<decltype(a.start)>(ja["start"]);
+                }
+                if (ja.count("duration")) {
+                    a.duration = static_cast<decltype(a.duration)>(ja["duration"]);
+                }
+                if (ja.count("rate")) {
+                    a.rate = static_cast<decltype(a.rate)>(ja["rate"]);
+                    if (a.rate <= 0) {
+                        throw logic_error("Parse error Json tag: attacks.rate\n");
+                    }
+                }
+                if (ja.count("sources")) {
+                    a.sources = static_cast<decltype(a.sources)>(ja["sources"]);
+                }
+                if (ja.count("source_base")) {
+                    a.source_base = static_cast<decltype(a.source_base)>(ja["source_base"]);
+                    if (!__parse_ipv4(a.source_base, _addr)) {
+                        throw logic_error("Parse error Json tag: attacks.source_base\n");
+                    }
+                }
+                p_gen_config->attacks.push_back(a);
+            }
+        }
+    } catch (exception & e) {
+        WARN(e.what());
+        return false;
+    }
+
+    reset();
+    return true;
+}
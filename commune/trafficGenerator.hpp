@@ -0,0 +1,235 @@
+#pragma once
+
+#include "../common.hpp"
+#include "dpdkCommon.hpp"
+#include "peregrineRecord.hpp"
+
+#include <random>
+#include <vector>
+#include <map>
+
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+
+using namespace std;
+
+namespace Whisper {
+
+using arrival_process_t = uint8_t;
+enum arrival_process : arrival_process_t {
+    ARRIVAL_CONSTANT = 0,
+    ARRIVAL_POISSON  = 1,
+    // heavy-tailed gaps with the same mean, i.e. bursts and silences
+    ARRIVAL_PARETO   = 2
+};
+
+static const map<string, arrival_process_t> arrival_process_map = {
+    {"constant", ARRIVAL_CONSTANT},
+    {"poisson",  ARRIVAL_POISSON},
+    {"pareto",   ARRIVAL_PARETO}
+};
+
+using attack_type_t = uint8_t;
+enum attack_type : attack_type_t {
+    // spoofed sources, one or two SYN each
+    ATTACK_SYN_FLOOD = 0,
+    // few sources keeping many connections alive with small periodic packets
+    ATTACK_SLOWLORIS = 1,
+    // few sources probing at a constant rate with minimal packets
+    ATTACK_SCAN      = 2
+};
+
+static const map<string, attack_type_t> attack_type_map = {
+    {"syn_flood", ATTACK_SYN_FLOOD},
+    {"slowloris", ATTACK_SLOWLORIS},
+    {"scan",      ATTACK_SCAN}
+};
+
+struct AttackConfigParam final {
+    attack_type_t type = ATTACK_SYN_FLOOD;
+    // Offset from the start of the trace and length of the attack (s)
+    double_t start = 10.0;
+    double_t duration = 30.0;
+    // Records per second of the attack
+    double_t rate = 1e5;
+    // Attacker addresses: source_base + [0, sources)
+    size_t sources = 1;
+    string source_base = "192.168.100.0";
+};
+
+struct TrafficGenConfigParam final {
+    // Background sources: source_base + [0, num_sources), popularity Zipf(source_zipf)
+    size_t num_sources = 10000;
+    string source_base = "10.0.0.0";
+    double_t source_zipf = 1.0;
+    // Packets per flow: Zipf(flow_zipf) over [1, max_flow_size]
+    double_t flow_zipf = 1.2;
+    size_t max_flow_size = 100000;
+    // Flows interleaved at any time
+    size_t active_flows = 1024;
+    // Background records per second of trace time and their arrival process
+    double_t rate = 1e6;
+    arrival_process_t arrival = ARRIVAL_POISSON;
+    double_t pareto_shape = 1.5;
+    // Seconds per timestamp tick (switch_ts_unit of the analyzer), start of the trace
+    // (s since epoch), 0 starts from the wall clock
+    double_t ts_unit = 1e-9;
+    double_t ts_start = 1.6e9;
+    uint64_t seed = 7;
+    vector<AttackConfigParam> attacks;
+    // Tag of the attack sources in the labels file (analysis/address.json format)
+    string label_tag = "SYNTH";
+
+    auto inline display_params() const -> void {
+        printf("[Whisper Traffic Generator Configuration]\n");
+        printf("Sources: %ld from %s (Zipf %4.2lf), Flow size: Zipf %4.2lf up to %ld, Active flows: %ld\n",
+        num_sources, source_base.c_str(), source_zipf, flow_zipf, max_flow_size, active_flows);
+        printf("Rate: %4.2lf Mrps, Arrival: %s, Seed: %ld\n", rate / 1e6,
+        arrival == ARRIVAL_CONSTANT ? "constant" : (arrival == ARRIVAL_POISSON ? "poisson" : "pareto"),
+        seed);
+        for (const auto & a: attacks) {
+            printf("Attack %s: %4.2lfs for %4.2lfs, %4.2lf Krps, %ld sources from %s\n",
+            a.type == ATTACK_SYN_FLOOD ? "syn_flood" : (a.type == ATTACK_SLOWLORIS ? "slowloris" : "scan"),
+            a.start, a.duration, a.rate / 1e3, a.sources, a.source_base.c_str());
+        }
+        printf("\n");
+    }
+
+    TrafficGenConfigParam() = default;
+    virtual ~TrafficGenConfigParam() {}
+    TrafficGenConfigParam & operator=(const TrafficGenConfigParam &) = delete;
+    TrafficGenConfigParam(const TrafficGenConfigParam &) = delete;
+};
+
+// Zipf(s) over [1, n] by rejection-inversion (Hormann and Derflinger), O(1) memory
+class ZipfSampler final {
+
+    private:
+        double_t n, s;
+        double_t h_integral_x1, h_integral_n, sval;
+
+        auto static inline helper1(double_t x) -> double_t {
+            return fabs(x) > 1e-8 ? log1p(x) / x : 1 - x * (0.5 - x * (1.0 / 3 - 0.25 * x));
+        }
+        auto static inline helper2(double_t x) -> double_t {
+            return fabs(x) > 1e-8 ? expm1(x) / x : 1 + x * 0.5 * (1 + x * (1.0 / 3) * (1 + 0.25 * x));
+        }
+        auto inline h(double_t x) const -> double_t {
+            return exp(-s * log(x));
+        }
+        auto inline h_integral(double_t x) const -> double_t {
+            const double_t lx = log(x);
+            return helper2((1 - s) * lx) * lx;
+        }
+        auto inline h_integral_inv(double_t x) const -> double_t {
+            const double_t t = max(-1.0, x * (1 - s));
+            return exp(helper1(t) * x);
+        }
+
+    public:
+        ZipfSampler(size_t _n = 1, double_t _s = 1.0) {
+            init(_n, _s);
+        }
+
+        void init(size_t _n, double_t _s) {
+            n = (double_t) max<size_t>(_n, 1);
+            s = max(_s, 1e-6);
+            h_integral_x1 = h_integral(1.5) - 1;
+            h_integral_n = h_integral(n + 0.5);
+            sval = 2 - h_integral_inv(h_integral(2.5) - h(2));
+        }
+
+        template <typename G>
+        auto inline operator()(G & gen) -> size_t {
+            uniform_real_distribution<double_t> uni(0, 1);
+            while (true) {
+                const double_t u = h_integral_n + uni(gen) * (h_integral_x1 - h_integral_n);
+                const double_t x = h_integral_inv(u);
+                double_t k = floor(x + 0.5);
+                k = min(max(k, 1.0), n);
+                if (k - x <= sval || u >= h_integral(k + 0.5) - h(k)) {
+                    return (size_t) k;
+                }
+            }
+        }
+};
+
+// Synthesizes the Peregrine record stream of a background population plus injected
+// attacks, as records, pcap files or mbuf bursts. Deterministic for a given seed, unless
+// ts_start is 0 and the timestamps follow the wall clock.
+class TrafficGenerator final {
+
+    private:
+        shared_ptr<TrafficGenConfigParam> p_gen_config;
+
+        mt19937_64 gen;
+        ZipfSampler source_sampler, flow_size_sampler;
+        // TCP / UDP / ICMP flows, small (ACK) / medium / full sized packets
+        discrete_distribution<int> proto_dist{85, 13, 2};
+        discrete_distribution<int> size_class{45, 15, 40};
+
+        struct ActiveFlow {
+            uint32_t ip_src;
+            uint16_t proto;
+            size_t remaining;
+        };
+        vector<ActiveFlow> flows;
+
+        // Next record time of the background and of every attack (s from the start)
+        double_t next_background = 0;
+        vector<double_t> next_attack;
+        // Round robin position of the scan and slowloris sources
+        vector<size_t> attack_cursor;
+
+        uint32_t source_base = 0;
+        vector<uint32_t> attack_base;
+        // Timestamps are counted in integer ticks, a double tick near 1e18 is 256 ns coarse
+        uint64_t ts_start_tick = 0;
+        double_t elapsed = 0;
+        uint64_t generated = 0;
+
+        auto arrival_gap(double_t rate, arrival_process_t process) -> double_t;
+        auto new_flow() -> ActiveFlow;
+        void background_record(PktMetadata & out);
+        void attack_record(size_t k, PktMetadata & out);
+
+    public:
+        TrafficGenerator() = default;
+        virtual ~TrafficGenerator() {}
+        TrafficGenerator & operator=(const TrafficGenerator &) = delete;
+        TrafficGenerator(const TrafficGenerator &) = delete;
+
+        // Config form json file ("Traffic" section)
+        auto configure_via_json(const json & jin) -> bool;
+
+        // Restart the trace from the seed, called by configure_via_json
+        void reset();
+
+        // Next record in time order, returns its exact timestamp (ticks)
+        auto next(PktMetadata & out) -> uint64_t;
+        auto next_batch(PktMetadata * out, size_t n) -> size_t;
+
+        // Encoded Peregrine frames in mbufs of the pool, returns the mbufs filled
+        auto fill_mbufs(rte_mempool * p_pool, rte_mbuf ** out, size_t n) -> size_t;
+
+        // Write num records, or the records of the next duration seconds, to a pcap file
+        auto write_pcap(const string & file, size_t num, double_t duration = 0) -> size_t;
+
+        // Attack sources in the analysis/address.json format
+        auto write_labels(const string & file) const -> bool;
+        auto malicious_sources() const -> vector<string>;
+
+        // Trace time (s) and number of records generated so far
+        auto inline get_elapsed() const -> double_t {
+            return elapsed;
+        }
+        auto inline get_generated() const -> uint64_t {
+            return generated;
+        }
+
+        auto get_config() const -> shared_ptr<const TrafficGenConfigParam> {
+            return p_gen_config;
+        }
+};
+
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+// Shared-memory layout of the live verdict table and a read-only client.
+// Standalone on purpose: external processes include only this header.
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace Whisper {
+
+#define VERDICT_SHM_MAGIC 0x54435657u   // "WVCT"
+#define VERDICT_SHM_VERSION 1u
+#define VERDICT_MAX_PROBE 16
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+              "shared memory atomics must be lock free");
+
+// Segment: header | table_size x VerdictEntry | alert ring header | alert_size x AlertSlot
+struct alignas(64) VerdictShmHeader final {
+    std::atomic<uint32_t> magic;        // written last by the creator
+    uint32_t version;
+    uint32_t entry_size;
+    uint32_t alert_slot_size;
+    uint64_t table_size;                // power of 2
+    uint64_t alert_size;                // power of 2
+    double ts_create;
+    uint32_t writer_pid;
+    uint32_t reserved;
+    // Verdicts that replaced an unrelated source (table pressure)
+    std::atomic<uint64_t> eviction_num;
+};
+
+// Per-source anomaly state, protected by a seqlock (odd while written)
+struct alignas(64) VerdictEntry final {
+    std::atomic<uint32_t> seq;
+    // Source address in host byte order, 0 for an empty slot
+    std::atomic<uint32_t> address;
+    double last_distance;
+    double max_distance;
+    uint64_t packet_num;
+    // Time of the last verdict, seconds since epoch
+    double last_update;
+    uint32_t verdict_num;
+    uint32_t flags;
+};
+static_assert(sizeof(VerdictEntry) == 64, "verdict entry layout");
+
+struct alignas(64) AlertRingHeader final {
+    // Number of alerts ever published
+    std::atomic<uint64_t> head;
+};
+
+// One alert, seq is the alert number + 1 once complete, 0 while written
+struct alignas(64) AlertSlot final {
+    std::atomic<uint64_t> seq;
+    uint32_t address;
+    uint32_t flags;
+    double distance;
+    uint64_t packet_num;
+    double ts;
+};
+static_assert(sizeof(AlertSlot) == 64, "alert slot layout");
+
+// Consistent copies handed to the readers
+struct VerdictSnapshot final {
+    uint32_t address;
+    uint32_t flags;
+    double last_distance;
+    double max_distance;
+    uint64_t packet_num;
+    double last_update;
+    uint32_t verdict_num;
+};
+
+struct VerdictAlert final {
+    uint64_t alert_no;
+    uint32_t address;
+    uint32_t flags;
+    double distance;
+    uint64_t packet_num;
+    double ts;
+};
+
+static inline auto verdict_shm_bytes(uint64_t table_size, uint64_t alert_size) -> size_t {
+    return sizeof(VerdictShmHeader) + table_size * sizeof(VerdictEntry) +
+           sizeof(AlertRingHeader) + alert_size * sizeof(AlertSlot);
+}
+
+static inline auto verdict_slot_of(uint32_t address, uint64_t table_size) -> uint64_t {
+    return ((address * 0x9E3779B97F4A7C15ull) >> 32) & (table_size - 1);
+}
+
+// Zero-copy reader: after attach, lookups and alert polling are plain loads
+class VerdictTableReader final {
+
+    private:
+        void * p_base = nullptr;
+        size_t bytes = 0;
+
+        const VerdictShmHeader * p_header = nullptr;
+        const VerdictEntry * p_entries = nullptr;
+        const AlertRingHeader * p_alert_header = nullptr;
+        const AlertSlot * p_alerts = nullptr;
+
+    public:
+        VerdictTableReader() = default;
+        virtual ~VerdictTableReader() {
+            detach();
+        }
+        VerdictTableReader & operator=(const VerdictTableReader &) = delete;
+        VerdictTableReader(const VerdictTableReader &) = delete;
+
+        // Map a segment created by Whisper, false if absent or not initialized yet
+        auto attach(const std::string & shm_name) -> bool {
+            detach();
+            const int fd = shm_open(shm_name.c_str(), O_RDONLY, 0);
+            if (fd < 0) {
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(VerdictShmHeader)) {
+                close(fd);
+                return false;
+            }
+            p_base = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            close(fd);
+            if (p_base == MAP_FAILED) {
+                p_base = nullptr;
+                return false;
+            }
+            bytes = st.st_size;
+
+            p_header = (const VerdictShmHeader *) p_base;
+            if (p_header->magic.load(std::memory_order_acquire) != VERDICT_SHM_MAGIC ||
+                    p_header->version != VERDICT_SHM_VERSION ||
+                    p_header->entry_size != sizeof(VerdictEntry) ||
+                    p_header->alert_slot_size != sizeof(AlertSlot) ||
+                    verdict_shm_bytes(p_header->table_size, p_header->alert_size) > bytes) {
+                detach();
+                return false;
+            }
+
+            const char * p = (const char *) p_base + sizeof(VerdictShmHeader);
+            p_entries = (const VerdictEntry *) p;
+            p += p_header->table_size * sizeof(VerdictEntry);
+            p_alert_header = (const AlertRingHeader *) p;
+            p_alerts = (const AlertSlot *) (p + sizeof(AlertRingHeader));
+            return true;
+        }
+
+        void detach() {
+            if (p_base != nullptr) {
+                munmap(p_base, bytes);
+            }
+            p_base = nullptr;
+            p_header = nullptr;
+        }
+
+        auto inline is_attached() const -> bool {
+            return p_header != nullptr;
+        }
+
+        auto inline get_header() const -> const VerdictShmHeader & {
+            return *p_header;
+        }
+
+        // Current verdict of one source (host byte order)
+        auto lookup(uint32_t address, VerdictSnapshot & out) const -> bool {
+            if (address == 0) {
+                return false;
+            }
+            const uint64_t mask = p_header->table_size - 1;
+            const uint64_t slot = verdict_slot_of(address, p_header->table_size);
+
+            for (uint64_t p = 0; p < VERDICT_MAX_PROBE; p ++) {
+                const VerdictEntry & e = p_entries[(slot + p) & mask];
+                const uint32_t a = e.address.load(std::memory_order_acquire);
+                if (a == 0) {
+                    return false;
+                }
+                if (a != address) {
+                    continue;
+                }
+                while (true) {
+                    const uint32_t s1 = e.seq.load(std::memory_order_acquire);
+                    if (s1 & 1) {
+                        continue;
+                    }
+                    out.address = e.address.load(std::memory_order_relaxed);
+                    out.flags = e.flags;
+                    out.last_distance = e.last_distance;
+                    out.max_distance = e.max_distance;
+                    out.packet_num = e.packet_num;
+                    out.last_update = e.last_update;
+                    out.verdict_num = e.verdict_num;
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    if (e.seq.load(std::memory_order_relaxed) == s1) {
+                        break;
+                    }
+                }
+                // the slot was taken over by another source meanwhile
+                return out.address == address;
+            }
+            return false;
+        }
+
+        // Cursor that only sees the alerts published from now on
+        auto alert_cursor() const -> uint64_t {
+            return p_alert_header->head.load(std::memory_order_acquire);
+        }
+
+        // Next alert after the cursor, alerts overwritten before being read count as lost
+        auto next_alert(uint64_t & cursor, VerdictAlert & out, uint64_t * p_lost = nullptr) const -> bool {
+            const uint64_t cap = p_header->alert_size;
+            while (true) {
+                const uint64_t head = p_alert_header->head.load(std::memory_order_acquire);
+                if (cursor >= head) {
+                    return false;
+                }
+                if (head - cursor > cap) {
+                    if (p_lost) *p_lost += head - cursor - cap;
+                    cursor = head - cap;
+                }
+
+                const AlertSlot & slot = p_alerts[cursor & (cap - 1)];
+                const uint64_t s1 = slot.seq.load(std::memory_order_acquire);
+                if (s1 < cursor + 1) {
+                    // published but still being written
+                    return false;
+                }
+                out.alert_no = cursor;
+                out.address = slot.address;
+                out.flags = slot.flags;
+                out.distance = slot.distance;
+                out.packet_num = slot.packet_num;
+                out.ts = slot.ts;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                const uint64_t s2 = slot.seq.load(std::memory_order_relaxed);
+
+                if (s1 == cursor + 1 && s2 == s1) {
+                    ++ cursor;
+                    return true;
+                }
+                // lapped by the writer
+                if (p_lost) *p_lost += 1;
+                ++ cursor;
+            }
+        }
+};
+
+}
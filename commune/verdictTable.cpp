@@ -0,0 +1,198 @@
+#include "verdictTable.hpp"
+
+using namespace Whisper;
+
+static inline auto __round_pow2(size_t n) -> size_t {
+    size_t r = 1;
+    while (r < n) {
+        r <<= 1;
+    }
+    return r;
+}
+
+auto VerdictTable::create() -> bool {
+    if (!is_enabled()) {
+        return false;
+    }
+    destroy();
+
+    const uint64_t table_size = __round_pow2(max<size_t>(p_verdict_config->table_size, VERDICT_MAX_PROBE));
+    const uint64_t alert_size = __round_pow2(max<size_t>(p_verdict_config->alert_size, 2));
+    bytes = verdict_shm_bytes(table_size, alert_size);
+
+    const char * name = p_verdict_config->shm_name.c_str();
+    const int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0) {
+        WARNF("Verdict table: shm_open %s failed: %s", name, strerror(errno));
+        return false;
+    }
+    if (ftruncate(fd, bytes) != 0) {
+        WARNF("Verdict table: resize to %ld bytes failed: %s", bytes, strerror(errno));
+        close(fd);
+        return false;
+    }
+    p_base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (p_base == MAP_FAILED) {
+        WARNF("Verdict table: mmap failed: %s", strerror(errno));
+        p_base = nullptr;
+        return false;
+    }
+
+    // the object is zero filled: empty entries, even sequences, empty alert ring
+    char * p = (char *) p_base;
+    p_header = (VerdictShmHeader *) p;
+    p_entries = (VerdictEntry *) (p + sizeof(VerdictShmHeader));
+    p_alert_header = (AlertRingHeader *) (p + sizeof(VerdictShmHeader) + table_size * sizeof(VerdictEntry));
+    p_alerts = (AlertSlot *) ((char *) p_alert_header + sizeof(AlertRingHeader));
+    table_mask = table_size - 1;
+    alert_mask = alert_size - 1;
+
+    p_header->version = VERDICT_SHM_VERSION;
+    p_header->entry_size = sizeof(VerdictEntry);
+    p_header->alert_slot_size = sizeof(AlertSlot);
+    p_header->table_size = table_size;
+    p_header->alert_size = alert_size;
+    p_header->ts_create = get_time_spec();
+    p_header->writer_pid = (uint32_t) getpid();
+    // readers accept the segment once the magic is visible
+    p_header->magic.store(VERDICT_SHM_MAGIC, std::memory_order_release);
+
+    LOGF("Verdict table %s: %lu entries, %lu alert slots, %.2lf MB.",
+         name, table_size, alert_size, bytes / 1048576.0);
+    return true;
+}
+
+void VerdictTable::destroy() {
+    if (p_base == nullptr) {
+        return;
+    }
+    munmap(p_base, bytes);
+    p_base = nullptr;
+    p_header = nullptr;
+    if (p_verdict_config->unlink_on_exit) {
+        shm_unlink(p_verdict_config->shm_name.c_str());
+    }
+}
+
+auto VerdictTable::update(uint32_t address, double_t distance, uint64_t packet_num,
+                          double_t ts, uint32_t flags) -> bool {
+    if (p_header == nullptr || address == 0) {
+        return false;
+    }
+
+    const uint64_t slot = verdict_slot_of(address, table_mask + 1);
+    VerdictEntry * p_target = nullptr;
+    VerdictEntry * p_oldest = nullptr;
+
+    for (uint64_t p = 0; p < VERDICT_MAX_PROBE; p ++) {
+        VerdictEntry & e = p_entries[(slot + p) & table_mask];
+        const uint32_t a = e.address.load(std::memory_order_acquire);
+        if (a == address || a == 0) {
+            p_target = &e;
+            break;
+        }
+        if (p_oldest == nullptr || e.last_update < p_oldest->last_update) {
+            p_oldest = &e;
+        }
+    }
+
+    bool evict = false;
+    if (p_target == nullptr) {
+        p_target = p_oldest;
+        evict = true;
+    }
+
+    VerdictEntry & e = *p_target;
+    const uint32_t locked = lock_entry(e);
+    const uint32_t a = e.address.load(std::memory_order_relaxed);
+    if (a != address) {
+        // empty slot, or an entry (raced or evicted) that now belongs to this source
+        if (a != 0) {
+            evict = true;
+        }
+        e.address.store(address, std::memory_order_relaxed);
+        e.max_distance = distance;
+        e.packet_num = 0;
+        e.verdict_num = 0;
+    }
+    e.last_distance = distance;
+    e.max_distance = max(e.max_distance, distance);
+    e.packet_num += packet_num;
+    e.last_update = ts;
+    e.flags = flags;
+    ++ e.verdict_num;
+    unlock_entry(e, locked);
+
+    if (evict) {
+        p_header->eviction_num.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (distance >= p_verdict_config->alert_threshold) {
+        publish_alert(address, distance, packet_num, ts, flags);
+    }
+    return true;
+}
+
+void VerdictTable::publish_alert(uint32_t address, double_t distance, uint64_t packet_num,
+                                 double_t ts, uint32_t flags) {
+    const uint64_t n = p_alert_header->head.fetch_add(1, std::memory_order_acq_rel);
+    AlertSlot & slot = p_alerts[n & alert_mask];
+
+    slot.seq.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.address = address;
+    slot.flags = flags;
+    slot.distance = distance;
+    slot.packet_num = packet_num;
+    slot.ts = ts;
+    slot.seq.store(n + 1, std::memory_order_release);
+}
+
+auto VerdictTable::configure_via_json(const json & jin) -> bool {
+    if (p_verdict_config != nullptr) {
+        WARN("Verdict table configuration overlap.");
+        return false;
+    }
+
+    p_verdict_config = make_shared<VerdictTableConfigParam>();
+    if (p_verdict_config == nullptr) {
+        WARNF("Verdict table configuration paramerter bad allocation.");
+        return false;
+    }
+
+    try {
+        if (jin.count("enable")) {
+            p_verdict_config->enable =
+                static_cast<decltype(p_verdict_config->enable)>(jin["enable"]);
+        }
+        if (jin.count("shm_name")) {
+            p_verdict_config->shm_name =
+                static_cast<decltype(p_verdict_config->shm_name)>(jin["shm_name"]);
+            if (p_verdict_config->shm_name.empty() || p_verdict_config->shm_name[0] != '/') {
+                throw logic_error("Parse error Json tag: shm_name (must start with '/')\n");
+            }
+        }
+        if (jin.count("table_size")) {
+            p_verdict_config->table_size =
+                static_cast<decltype(p_verdict_config->table_size)>(jin["table_size"]);
+        }
+        if (jin.count("alert_size")) {
+            p_verdict_config->alert_size =
+                static_cast<decltype(p_verdict_config->alert_size)>(jin["alert_size"]);
+        }
+        if (jin.count("alert_threshold")) {
+            p_verdict_config->alert_threshold =
+                static_cast<decltype(p_verdict_config->alert_threshold)>(jin["alert_threshold"]);
+        }
+        if (jin.count("unlink_on_exit")) {
+            p_verdict_config->unlink_on_exit =
+                static_cast<decltype(p_verdict_config->unlink_on_exit)>(jin["unlink_on_exit"]);
+        }
+    } catch (exception & e) {
+        WARN(e.what());
+        p_verdict_config->enable = false;
+        return false;
+    }
+    return true;
+}
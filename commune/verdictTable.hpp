@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../common.hpp"
+#include "verdictShm.hpp"
+
+using namespace std;
+
+namespace Whisper {
+
+struct VerdictTableConfigParam final {
+    bool enable = false;
+    // POSIX shared memory object, readers attach by this name
+    string shm_name = "/whisper_verdicts";
+    // Slots of the per-source table and of the alert ring (rounded up to powers of 2)
+    size_t table_size = 1 << 20;
+    size_t alert_size = 1 << 16;
+    // A verdict with a distance from this value on is also published as an alert
+    double_t alert_threshold = 6.0;
+    // Remove the object at shutdown
+    bool unlink_on_exit = true;
+
+    auto inline display_params() const -> void {
+        printf("[Whisper Verdict Table Configuration]\n");
+        printf("Shared memory: %s, Table size: %ld, Alert ring size: %ld, Alert threshold: %4.2lf\n\n",
+        shm_name.c_str(), table_size, alert_size, alert_threshold);
+    }
+
+    VerdictTableConfigParam() = default;
+    virtual ~VerdictTableConfigParam() {}
+    VerdictTableConfigParam & operator=(const VerdictTableConfigParam &) = delete;
+    VerdictTableConfigParam(const VerdictTableConfigParam &) = delete;
+};
+
+// Writer side of the shared-memory verdict table. Shared by all analyzers: every
+// entry is locked by a CAS on its sequence, so any analyzer may publish any source.
+class VerdictTable final {
+
+    private:
+        shared_ptr<VerdictTableConfigParam> p_verdict_config;
+
+        void * p_base = nullptr;
+        size_t bytes = 0;
+
+        VerdictShmHeader * p_header = nullptr;
+        VerdictEntry * p_entries = nullptr;
+        AlertRingHeader * p_alert_header = nullptr;
+        AlertSlot * p_alerts = nullptr;
+        uint64_t table_mask = 0;
+        uint64_t alert_mask = 0;
+
+        auto static inline lock_entry(VerdictEntry & e) -> uint32_t {
+            uint32_t s = e.seq.load(std::memory_order_relaxed);
+            while (true) {
+                if ((s & 1) == 0 && e.seq.compare_exchange_weak(s, s + 1, std::memory_order_acquire)) {
+                    return s + 1;
+                }
+                s = e.seq.load(std::memory_order_relaxed);
+            }
+        }
+
+        void static inline unlock_entry(VerdictEntry & e, uint32_t locked_seq) {
+            e.seq.store(locked_seq + 1, std::memory_order_release);
+        }
+
+        void publish_alert(uint32_t address, double_t distance, uint64_t packet_num,
+                           double_t ts, uint32_t flags);
+
+    public:
+        VerdictTable() = default;
+        virtual ~VerdictTable() {
+            destroy();
+        }
+        VerdictTable & operator=(const VerdictTable &) = delete;
+        VerdictTable(const VerdictTable &) = delete;
+
+        // Config form json file
+        auto configure_via_json(const json & jin) -> bool;
+
+        auto inline is_enabled() const -> bool {
+            return p_verdict_config != nullptr && p_verdict_config->enable;
+        }
+
+        // Create and initialize the shared memory object
+        auto create() -> bool;
+        void destroy();
+
+        // Record one verdict of a source (host byte order), raise an alert above the threshold
+        auto update(uint32_t address, double_t distance, uint64_t packet_num,
+                    double_t ts, uint32_t flags) -> bool;
+
+        auto get_config() const -> shared_ptr<const VerdictTableConfigParam> {
+            return p_verdict_config;
+        }
+};
+
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include "../common.hpp"
+#include "dpdkCommon.hpp"
+#include "batchGrouping.hpp"
+#include "slidingSpectrum.hpp"
+#include "centerStore.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+#include <torch/torch.h>
+
+using namespace std;
+
+namespace Whisper {
+
+// Stage kernels of AnalyzerWorkerThread::wave_analyze, free of worker state so that
+// the benchmarks run exactly the code of the analyzer.
+
+// Per-flow state kept across batches. It holds the encoded packets themselves: batch
+// positions would be stale once the fetch buffer is reused for the next batch.
+struct FlowState final {
+    // Encoded packets not transformed yet: all of them unless the spectrum is incremental
+    vector<float> values;
+    // Packets seen, and covered by a verdict
+    uint64_t packet_num = 0;
+    uint64_t reported_num = 0;
+    // Incremental spectrum, and the largest distance of the windows it completed since
+    // the last verdict (negative for none)
+    SlidingSpectrum spectrum;
+    double_t pending_dist = -1;
+    // Switch timestamp of the newest packet
+    double_t last_ts = 0;
+    // Host time of the last batch with packets of the flow, for idle expiry
+    double_t last_seen = 0;
+    // Creation number, tells a recreated flow from stale timer entries
+    uint32_t gen = 0;
+    // Already on the ready queue of the analyzer
+    bool queued = false;
+    // Per-flow sample cap: packets through the sampler, samples kept toward the next
+    // verdict, and the systematic stride with the arrivals to skip before the next sample
+    uint64_t sampled_num = 0;
+    uint64_t sample_num = 0;
+    uint32_t sample_stride = 1;
+    uint32_t sample_skip = 0;
+};
+
+// 2020.12.8
+// Linear Tranformation of per-packet properties
+// Evaluated in double for the timestamp, the pipeline is float32 from here on
+auto static inline weight_transform(const PktMetadata & info) -> float {
+     return (float) (info.length * 10 + info.proto / 10 + -log2(info.ts) * 15.68);
+}
+
+// Append the packets of every group of a batch to the state of its flow, returns the
+// bytes seen. admit(key, k, is_new) decides on group k first: a group it turns down is
+// left to the caller and gets no state. on_update(key, state, is_new) is called once per
+// flow of the batch after its packets are appended, key in host byte order.
+template <typename F, typename A>
+auto static inline accumulate_groups(const PktMetadata * raw_data, const FlowGroups & groups,
+                                     unordered_map<uint32_t, FlowState> & mp, F on_update,
+                                     A admit) -> uint64_t {
+    uint64_t sum_len = 0;
+    for (size_t k = 0; k < groups.size(); k ++) {
+        const uint32_t * p_index = groups.index.data() + groups.offset[k];
+        auto it = mp.find(groups.key[k]);
+        const bool is_new = it == mp.end();
+        if (!admit(groups.key[k], k, is_new)) {
+            for (size_t i = 0; i < groups.count[k]; i ++) {
+                sum_len += raw_data[p_index[i]].length;
+            }
+            continue;
+        }
+        if (is_new) {
+            it = mp.emplace(groups.key[k], FlowState()).first;
+        }
+        auto & state = it->second;
+        for (size_t i = 0; i < groups.count[k]; i ++) {
+            const auto & info = raw_data[p_index[i]];
+            sum_len += info.length;
+            state.values.push_back(weight_transform(info));
+            state.last_ts = max(state.last_ts, info.ts);
+        }
+        state.packet_num += groups.count[k];
+        on_update(groups.key[k], state, is_new);
+    }
+    return sum_len;
+}
+
+template <typename F>
+auto static inline accumulate_groups(const PktMetadata * raw_data, const FlowGroups & groups,
+                                     unordered_map<uint32_t, FlowState> & mp, F on_update) -> uint64_t {
+    return accumulate_groups(raw_data, groups, mp, on_update,
+                             [] (uint32_t, size_t, bool) -> bool { return true; });
+}
+
+// Packet encoding of the first len packets of a flow, a view of them: valid while the
+// state is unchanged
+auto static inline encode_flow(const FlowState & state, size_t len) -> torch::Tensor {
+    return torch::from_blob(const_cast<float *>(state.values.data()),
+                            {(int64_t) len}, torch::dtype(torch::kFloat32));
+}
+
+auto static inline encode_flow(const FlowState & state) -> torch::Tensor {
+    return encode_flow(state, state.values.size());
+}
+
+// Packet encoding of a flow shorter than one DFT window, zero padded to n_fft packets
+auto static inline encode_padded_flow(const FlowState & state, size_t n_fft) -> torch::Tensor {
+    if (state.values.size() >= n_fft) {
+        return encode_flow(state);
+    }
+    vector<float> padded(state.values);
+    padded.resize(n_fft, 0);
+    return torch::from_blob(padded.data(), {(int64_t) n_fft}, torch::dtype(torch::kFloat32)).clone();
+}
+
+// STFT, power and log linear transformation: one row of n_fft / 2 + 1 features per frame
+auto static inline frequency_transform(const torch::Tensor & ten, size_t n_fft) -> torch::Tensor {
+    // DFT on flow vector
+    torch::Tensor ten_fft = torch::stft(ten, n_fft);
+
+    // calculate the power
+    torch::Tensor ten_power = ten_fft.permute({2, 0, 1})[0] * ten_fft.permute({2, 0, 1})[0] +
+                              ten_fft.permute({2, 0, 1})[1] * ten_fft.permute({2, 0, 1})[1];
+    ten_power = ten_power.squeeze();
+
+    // log linear transformation
+    torch::Tensor ten_res = ((ten_power + 1).log2()).permute({1, 0});
+
+    // erase the inf and nan
+    ten_res = torch::where(torch::isnan(ten_res), torch::full_like(ten_res, 0), ten_res);
+    ten_res = torch::where(torch::isinf(ten_res), torch::full_like(ten_res, 0), ten_res);
+    return ten_res;
+}
+
+// Means of consecutive windows of mean_win frames, the whole flow when it is not longer
+auto static inline window_means(const torch::Tensor & ten_res, size_t mean_win) -> torch::Tensor {
+    if (ten_res.size(0) <= mean_win) {
+        return ten_res.mean(0).unsqueeze(0);
+    }
+    vector<torch::Tensor> means;
+    for (size_t i = 0; i + mean_win < ten_res.size(0); i += mean_win) {
+        means.push_back(ten_res.slice(0, i, i + mean_win).mean(0));
+    }
+    return torch::stack(means);
+}
+
+// Distance of the flow: the largest, over its windows, distance to the nearest center
+auto static inline center_distance(const torch::Tensor & means, const CenterStore & centers,
+                                   double_t max_dist) -> double_t {
+    const torch::Tensor rows = means.contiguous();
+    return centers.max_nearest(rows.data_ptr<float>(), rows.size(0), max_dist);
+}
+
+// Mean of the window sum of an incremental spectrum
+auto static inline spectrum_mean(const vector<float> & sum, size_t frames, vector<float> & mean) -> void {
+    mean.resize(sum.size());
+    for (size_t i = 0; i < sum.size(); i ++) {
+        mean[i] = sum[i] / frames;
+    }
+}
+
+}
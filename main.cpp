@@ -28,10 +28,12 @@ int main(int argc, char** argv) {
 
     const auto p_device_init = make_shared<Whisper::DeviceConfig>();
     p_device_init->configure_via_json(config_j);
-    p_device_init->do_init();
+    const bool slo_met = p_device_init->do_init();
 
     __STOP_FTIMER__
     __PRINTF_EXE_TIME__
 
+    // a missed detection latency objective fails the run
+    return slo_met ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
@@ -0,0 +1,236 @@
+// Packet weighted evaluation of Whisper results against analysis/address.json, in place of
+// analysis/auc.py: one pass over the .wres and .json result files of <dir>/<tag>/,
+// files spread over threads, no per-packet expansion.
+//
+//   ./WhisperEval --labels ../analysis/address.json --dir ../eval/ --target SYNDOS
+
+#include <gflags/gflags.h>
+
+#include "../commune/evaluationMetrics.hpp"
+#include "../commune/resultReader.hpp"
+#include "../common.hpp"
+
+#include <atomic>
+#include <thread>
+#include <unordered_set>
+#include <dirent.h>
+#include <arpa/inet.h>
+
+
+using namespace std;
+
+
+DEFINE_string(labels, "../analysis/address.json", "Malicious addresses of every tag.");
+DEFINE_string(dir, "../eval/", "Results of tag T are read from <dir>/T/.");
+DEFINE_string(target, "ALL", "Tag to evaluate, ALL for every tag of the label file.");
+DEFINE_uint64(threads, 0, "Reader threads, 0 for the hardware concurrency.");
+DEFINE_uint64(bins, 0, "Log-spaced score bins, 0 for exact scores.");
+DEFINE_double(max_score, 1e12, "Upper bound of the binned scores.");
+DEFINE_double(threshold, 6, "Alarm threshold of the F-scores, distance > threshold.");
+DEFINE_double(fpr, 0.1, "Report the TPR at this FPR.");
+DEFINE_double(tpr, 0.9, "Report the FPR at this TPR.");
+DEFINE_bool(skip_partial, false, "Ignore the flows scored at shutdown with fewer packets.");
+DEFINE_string(output, "", "Write the metrics and the ROC curves to this JSON file.");
+DEFINE_string(prefix, "", "Analyzer.save_file_prefix of the result files.");
+
+
+namespace Whisper {
+
+// Result files of one tag directory, binary and JSON
+// Result files of the analyzers: <prefix>_<core>.json and <prefix>_<core>_<seq>.wres,
+// the reports next to them do not match
+static auto is_result_file(const string & name) -> bool {
+    auto _ends = [&name] (const string & s) -> bool {
+        return name.size() > s.size() && name.compare(name.size() - s.size(), s.size(), s) == 0;
+    };
+    size_t fields;
+    size_t end;
+    if (_ends(RESULT_FILE_SUFFIX)) {
+        fields = 2;
+        end = name.size() - strlen(RESULT_FILE_SUFFIX);
+    } else if (_ends(".json")) {
+        fields = 1;
+        end = name.size() - strlen(".json");
+    } else {
+        return false;
+    }
+    // numeric fields from the end, each behind an underscore
+    for (size_t i = 0; i < fields; i ++) {
+        const size_t pos = end == 0 ? string::npos : name.rfind('_', end - 1);
+        if (pos == string::npos || pos + 1 == end ||
+            name.find_first_not_of("0123456789", pos + 1) < end) {
+            return false;
+        }
+        end = pos;
+    }
+    return end == FLAGS_prefix.size() && name.compare(0, end, FLAGS_prefix) == 0;
+}
+
+static auto list_result_files(const string & dir) -> vector<string> {
+    vector<string> ret;
+    DIR * p_dir = opendir(dir.c_str());
+    if (p_dir == nullptr) {
+        return ret;
+    }
+    for (const dirent * p_ent = readdir(p_dir); p_ent != nullptr; p_ent = readdir(p_dir)) {
+        const string name = p_ent->d_name;
+        if (is_result_file(name)) {
+            ret.push_back(dir + "/" + name);
+        }
+    }
+    closedir(p_dir);
+    sort(ret.begin(), ret.end());
+    return ret;
+}
+
+static auto read_binary(const string & file, const unordered_set<uint32_t> & malicious,
+                        WeightedScoreAccumulator & acc) -> bool {
+    ResultReader reader;
+    if (!reader.open(file)) {
+        return false;
+    }
+    vector<ResultRecord> block(1 << 15);
+    for (size_t n = reader.next_block(block.data(), block.size()); n;
+         n = reader.next_block(block.data(), block.size())) {
+        for (size_t i = 0; i < n; i ++) {
+            const auto & r = block[i];
+            if (FLAGS_skip_partial && (r.flags & RESULT_FLAG_PARTIAL)) {
+                continue;
+            }
+            // no source of its own to match against the labels
+            if (r.flags & RESULT_FLAG_AGGREGATE) {
+                continue;
+            }
+            acc.add(r.distance, malicious.count(r.address) != 0, (double_t) r.packet_num);
+        }
+    }
+    return true;
+}
+
+// {"Results": [[address, distance, packet_num, partial, sample_num], ...]} of save_res_json
+static auto read_json(const string & file, const unordered_set<uint32_t> & malicious,
+                      WeightedScoreAccumulator & acc) -> bool {
+    json j;
+    try {
+        ifstream fin(file, ios::in);
+        fin >> j;
+        if (!j.count("Results")) {
+            return false;
+        }
+        for (const auto & e: j["Results"]) {
+            if (FLAGS_skip_partial && e.size() > 3 && static_cast<bool>(e[3])) {
+                continue;
+            }
+            const uint32_t address = static_cast<uint32_t>(e[0]);
+            acc.add(static_cast<double_t>(e[1]), malicious.count(address) != 0,
+                    static_cast<double_t>(e[2]));
+        }
+    } catch (exception & e) {
+        WARNF("%s: %s", file.c_str(), e.what());
+        return false;
+    }
+    return true;
+}
+
+static auto evaluate_tag(const string & tag, const json & addresses) -> json {
+    unordered_set<uint32_t> malicious;
+    for (const auto & a: addresses) {
+        in_addr _addr;
+        if (inet_aton(static_cast<string>(a).c_str(), &_addr) == 0) {
+            WARNF("Tag %s: bad address %s.", tag.c_str(), static_cast<string>(a).c_str());
+            continue;
+        }
+        malicious.insert(ntohl(_addr.s_addr));
+    }
+
+    const auto files = list_result_files(FLAGS_dir + "/" + tag);
+    if (files.empty()) {
+        WARNF("Tag %s: no result files in %s.", tag.c_str(), (FLAGS_dir + "/" + tag).c_str());
+        return json();
+    }
+
+    const size_t num_thread = min<size_t>(files.size(),
+            FLAGS_threads ? FLAGS_threads : max<unsigned>(thread::hardware_concurrency(), 1));
+    vector<WeightedScoreAccumulator> accs;
+    accs.reserve(num_thread);
+    for (size_t i = 0; i < num_thread; i ++) {
+        accs.emplace_back(FLAGS_threshold, FLAGS_bins, FLAGS_max_score);
+    }
+
+    atomic<size_t> next_file(0), bad_file(0);
+    vector<thread> workers;
+    for (size_t i = 0; i < num_thread; i ++) {
+        workers.emplace_back([&, i] () -> void {
+            for (size_t k = next_file.fetch_add(1); k < files.size(); k = next_file.fetch_add(1)) {
+                const string & f = files[k];
+                const bool ok = f.size() > 5 && f.compare(f.size() - 5, 5, ".json") == 0 ?
+                                read_json(f, malicious, accs[i]) : read_binary(f, malicious, accs[i]);
+                if (!ok) {
+                    bad_file.fetch_add(1);
+                }
+            }
+            accs[i].compact();
+        });
+    }
+    for (auto & t: workers) {
+        t.join();
+    }
+    for (size_t i = 1; i < num_thread; i ++) {
+        accs[0].merge(accs[i]);
+    }
+    if (bad_file.load()) {
+        WARNF("Tag %s: %ld unreadable files skipped.", tag.c_str(), bad_file.load());
+    }
+
+    const auto res = evaluate_scores(accs[0], FLAGS_threshold, FLAGS_fpr, FLAGS_tpr);
+    printf("[%s]\n", tag.c_str());
+    printf("Files: %ld, flows: %ld, benign packets: %.0lf, malicious packets: %.0lf\n",
+           files.size(), res.records, res.neg_weight, res.pos_weight);
+    printf("TPR=%7.6lf (FPR=%4.2lf)\nFPR=%7.6lf (TPR=%4.2lf)\n",
+           res.tpr_at_fpr, res.at_fpr, res.fpr_at_tpr, res.at_tpr);
+    printf("AUC=%7.6lf\nEER=%7.6lf\nPR-AUC=%7.6lf\n", res.roc_auc, res.eer, res.pr_auc);
+    printf("Threshold %4.2lf: precision=%7.6lf, recall=%7.6lf, F1=%7.6lf, F2=%7.6lf (macro F1=%7.6lf, F2=%7.6lf)\n\n",
+           res.threshold, res.precision, res.recall, res.f1, res.f2, res.f1_macro, res.f2_macro);
+    return res.to_json();
+}
+
+}
+
+
+int main(int argc, char** argv) {
+    __START_FTIMMER__
+
+    // parse command line
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    json labels_j;
+    try {
+        ifstream fin(FLAGS_labels, ios::in);
+        fin >> labels_j;
+    } catch (exception & e) {
+        FATAL_ERROR(e.what());
+    }
+
+    json report;
+    for (auto it = labels_j.begin(); it != labels_j.end(); ++ it) {
+        // entries such as "20200610" describe the background traffic
+        if (!it.value().is_array() || (FLAGS_target != "ALL" && it.key() != FLAGS_target)) {
+            continue;
+        }
+        const json res = Whisper::evaluate_tag(it.key(), it.value());
+        if (!res.is_null()) {
+            report[it.key()] = res;
+        }
+    }
+    if (FLAGS_target != "ALL" && !labels_j.count(FLAGS_target)) {
+        FATAL_ERROR("Target Not found.");
+    }
+
+    if (FLAGS_output.length()) {
+        ofstream fout(FLAGS_output, ios::out);
+        fout << report.dump(4) << endl;
+    }
+
+    __STOP_FTIMER__
+    __PRINTF_EXE_TIME__
+}
@@ -0,0 +1,640 @@
+// Zero-loss throughput of a Whisper core configuration on DPDK software PMDs.
+//
+// Every trial is one process running the unmodified DeviceConfig::do_init flow, EAL
+// arguments from DPDK.eal_args select the PMD, e.g. on net_ring (TX loops back to RX):
+//
+//   "eal_args": ["--no-huge", "-m", "2048", "--no-pci", "--vdev=net_ring0"]
+//
+// An injector thread pinned to Harness.injector_core sends pre-encoded Peregrine frames
+// of the "Traffic" section at a fixed rate. The search mode runs trials in child processes
+// and bisects the rate until the largest lossless one is known within Harness.precision.
+// Without the injector (net_pcap rx_pcap=, net_null) one trial measures the PMD rate.
+
+#include <gflags/gflags.h>
+
+#include "../commune/deviceConfig.hpp"
+#include "../commune/trafficGenerator.hpp"
+#include "../commune/peregrineRecord.hpp"
+#include "../common.hpp"
+
+#include <array>
+#include <atomic>
+#include <thread>
+#include <cstddef>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+#include <rte_ethdev.h>
+#include <rte_mbuf.h>
+#include <rte_cycles.h>
+#include <rte_version.h>
+
+
+using namespace std;
+
+
+DEFINE_string(config, "../configTemplate.json", "Whisper JSON file with the \"Harness\" and \"Traffic\" sections.");
+DEFINE_double(rate, 0, "Run one trial at this rate (records/s), 0 to search the largest lossless rate.");
+DEFINE_string(trial_out, "", "Write the result of the trial to this file (used by the search).");
+DEFINE_string(report, "", "Write the trials and the result of the search to this file, default Harness.report_file.");
+
+
+namespace Whisper {
+
+struct HarnessConfigParam final {
+    // Generate the traffic, false when the PMD supplies it (net_pcap, net_null)
+    bool injector = true;
+    cpu_core_id_t injector_core = 3;
+    nic_port_id_t port = 0;
+    size_t burst = 32;
+    size_t pool_size = 65535;
+    // Distinct frames, replayed with shifted timestamps
+    size_t records = 1 << 20;
+    // Seconds before and of the measurement window
+    double_t warmup = 2.0;
+    double_t duration = 10.0;
+    // Search bounds (records/s), stop when (hi - lo) / hi < precision
+    double_t min_rate = 1e5;
+    double_t max_rate = 2e7;
+    double_t precision = 0.02;
+    // A trial is lossless when lost / offered <= loss_tolerance
+    double_t loss_tolerance = 0;
+    string report_file = "harness.json";
+
+    auto inline display_params() const -> void {
+        printf("[Whisper Throughput Harness Configuration]\n");
+        if (injector) {
+            printf("Injector core: %d, port: %d, burst: %ld, frames: %ld\n",
+                   (int) injector_core, (int) port, burst, records);
+        } else {
+            printf("No injector, the PMD of port %d supplies the traffic\n", (int) port);
+        }
+        printf("Warmup: %4.2lfs, measure: %4.2lfs\n", warmup, duration);
+        printf("Search: %4.2lf - %4.2lf Mrps, precision: %4.2lf%%, loss tolerance: %4.2le\n\n",
+               min_rate / 1e6, max_rate / 1e6, precision * 100, loss_tolerance);
+    }
+
+    HarnessConfigParam() = default;
+    virtual ~HarnessConfigParam() {}
+    HarnessConfigParam & operator=(const HarnessConfigParam &) = delete;
+    HarnessConfigParam(const HarnessConfigParam &) = delete;
+};
+
+static auto configure_harness(const json & jin, HarnessConfigParam & conf) -> bool {
+    try {
+        if (jin.count("injector")) {
+            conf.injector = static_cast<bool>(jin["injector"]);
+        }
+        if (jin.count("injector_core")) {
+            conf.injector_core = static_cast<cpu_core_id_t>(jin["injector_core"]);
+        }
+        if (jin.count("port")) {
+            conf.port = static_cast<nic_port_id_t>(jin["port"]);
+        }
+        if (jin.count("burst")) {
+            conf.burst = static_cast<size_t>(jin["burst"]);
+        }
+        if (jin.count("pool_size")) {
+            conf.pool_size = static_cast<size_t>(jin["pool_size"]);
+        }
+        if (jin.count("records")) {
+            conf.records = static_cast<size_t>(jin["records"]);
+        }
+        if (jin.count("warmup")) {
+            conf.warmup = static_cast<double_t>(jin["warmup"]);
+        }
+        if (jin.count("duration")) {
+            conf.duration = static_cast<double_t>(jin["duration"]);
+        }
+        if (jin.count("min_rate")) {
+            conf.min_rate = static_cast<double_t>(jin["min_rate"]);
+        }
+        if (jin.count("max_rate")) {
+            conf.max_rate = static_cast<double_t>(jin["max_rate"]);
+        }
+        if (jin.count("precision")) {
+            conf.precision = static_cast<double_t>(jin["precision"]);
+        }
+        if (jin.count("loss_tolerance")) {
+            conf.loss_tolerance = static_cast<double_t>(jin["loss_tolerance"]);
+        }
+        if (jin.count("report_file")) {
+            conf.report_file = static_cast<string>(jin["report_file"]);
+        }
+    } catch (exception & e) {
+        WARN(e.what());
+        return false;
+    }
+    if (conf.burst == 0 || conf.records == 0 || conf.duration <= 0 ||
+        conf.min_rate <= 0 || conf.max_rate <= conf.min_rate || conf.precision <= 0) {
+        WARN("Harness: invalid burst, records, duration, rate bounds or precision.");
+        return false;
+    }
+    return true;
+}
+
+// user + system jiffies of every thread of this process, by tid
+static auto read_thread_cpu() -> map<pid_t, pair<string, uint64_t> > {
+    map<pid_t, pair<string, uint64_t> > ret;
+    DIR * p_dir = opendir("/proc/self/task");
+    if (p_dir == nullptr) {
+        return ret;
+    }
+    while (const dirent * p_ent = readdir(p_dir)) {
+        if (p_ent->d_name[0] == '.') {
+            continue;
+        }
+        ifstream fin(string("/proc/self/task/") + p_ent->d_name + "/stat");
+        string line;
+        getline(fin, line);
+        const size_t l = line.find('('), r = line.rfind(')');
+        if (l == string::npos || r == string::npos) {
+            continue;
+        }
+        // fields after the name start at 3 (state), utime and stime are 14 and 15
+        stringstream ss(line.substr(r + 2));
+        string field;
+        uint64_t utime = 0, stime = 0;
+        for (size_t i = 3; i <= 15 && ss >> field; i ++) {
+            if (i == 14) {
+                utime = stoull(field);
+            } else if (i == 15) {
+                stime = stoull(field);
+            }
+        }
+        ret[atoi(p_ent->d_name)] = {line.substr(l + 1, r - l - 1), utime + stime};
+    }
+    closedir(p_dir);
+    return ret;
+}
+
+// Lcore of an EAL thread from its name: lcore-worker-N (DPDK < 23), dpdk-workerN
+static auto lcore_of_thread(const string & name) -> int {
+    if (name.find("worker") == string::npos) {
+        return -1;
+    }
+    size_t i = name.size();
+    while (i > 0 && isdigit(name[i - 1])) {
+        i --;
+    }
+    return i < name.size() ? atoi(name.c_str() + i) : -1;
+}
+
+// Counters of every stage at one point in time
+struct StageCounters final {
+    double_t ts = 0;
+    uint64_t offered = 0;
+    uint64_t tx_fail = 0;
+    uint64_t nic_rx = 0;
+    uint64_t nic_drop = 0;
+    uint64_t parsed = 0;
+    uint64_t drop_overload = 0;
+    uint64_t drop_full = 0;
+    uint64_t analyzed = 0;
+    map<pid_t, pair<string, uint64_t> > cpu;
+};
+
+// One trial: the injector and the hooks run inside DeviceConfig::do_init
+class ThroughputTrial final {
+
+    private:
+        const HarnessConfigParam & conf;
+        const double_t rate;
+
+        // Frames per TX queue, spread as RSS would, and the trace span for the replay
+        vector<vector<array<uint8_t, PEREGRINE_FRAME_MIN_LEN> > > frames;
+        uint64_t trace_span = 0;
+        size_t num_tx_queue = 1;
+
+        rte_mempool * p_pool = nullptr;
+        thread injector;
+        atomic<bool> injector_stop;
+        atomic<uint64_t> offered, tx_fail;
+        atomic<pid_t> injector_tid;
+
+        // Phases on the master core
+        double_t start_ts = 0;
+        StageCounters window_begin, window_end, final_counters;
+        bool measuring = false, cooling = false;
+        uint64_t last_parsed = 0;
+        size_t idle_tick = 0;
+
+        auto snapshot(const ThreadStateManagement & args) const -> StageCounters;
+        void inject();
+
+    public:
+        ThroughputTrial(const HarnessConfigParam & _c, double_t _rate):
+                conf(_c), rate(_rate), injector_stop(false), offered(0), tx_fail(0), injector_tid(0) {}
+        virtual ~ThroughputTrial() {}
+        ThroughputTrial & operator=(const ThroughputTrial &) = delete;
+        ThroughputTrial(const ThroughputTrial &) = delete;
+
+        // Encode the frames before DPDK starts
+        auto prepare(TrafficGenerator & generator, size_t tx_queue) -> bool;
+
+        auto hooks() -> RunHooks;
+
+        auto result() const -> json;
+};
+
+auto ThroughputTrial::prepare(TrafficGenerator & generator, size_t tx_queue) -> bool {
+    num_tx_queue = max<size_t>(tx_queue, 1);
+    frames.assign(num_tx_queue, {});
+    if (!conf.injector) {
+        return true;
+    }
+
+    PktMetadata meta;
+    uint64_t first_ts = 0, last_ts = 0;
+    for (size_t i = 0; i < conf.records; i ++) {
+        const uint64_t tick = generator.next(meta);
+        if (i == 0) {
+            first_ts = tick;
+        }
+        last_ts = tick;
+        auto & q = frames[flow_shard_of(meta.ip_src ^ 0x5bd1e995u, num_tx_queue)];
+        q.emplace_back();
+        encode_peregrine_frame(meta, q.back().data(), tick);
+    }
+    trace_span = last_ts - first_ts + 1;
+    return true;
+}
+
+void ThroughputTrial::inject() {
+    injector_tid.store((pid_t) syscall(SYS_gettid));
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(conf.injector_core, &cpus);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+        WARNF("Injector: can not pin to core %d.", (int) conf.injector_core);
+    }
+#if RTE_VERSION >= RTE_VERSION_NUM(20, 11, 0, 0)
+    // an lcore id gives the injector its own mempool cache
+    rte_thread_register();
+#endif
+
+    // offset of the timestamp in the frame, shifted by trace_span at every replay
+    const size_t ts_offset = PEREGRINE_ETH_HDR_LEN + PEREGRINE_IPV4_HDR_LEN
+                           + offsetof(PeregrineRecordHeader, timestamp);
+    vector<size_t> cursor(num_tx_queue, 0);
+    vector<uint64_t> replay(num_tx_queue, 0);
+    vector<rte_mbuf *> mbufs(conf.burst);
+
+    const double_t cycles_per_burst = (double_t) rte_get_tsc_hz() * conf.burst / rate;
+    double_t next_tsc = (double_t) rte_rdtsc();
+    size_t q = 0;
+    uint64_t _offered = 0, _tx_fail = 0;
+
+    while (!injector_stop.load(std::memory_order_relaxed)) {
+        const double_t now = (double_t) rte_rdtsc();
+        if (now < next_tsc) {
+            continue;
+        }
+        // behind by more than 1000 bursts: the injector is the bottleneck, do not catch up
+        if (now - next_tsc > 1000 * cycles_per_burst) {
+            next_tsc = now;
+        }
+        next_tsc += cycles_per_burst;
+
+        q = (q + 1) % num_tx_queue;
+        const auto & qf = frames[q];
+        if (qf.empty()) {
+            continue;
+        }
+        // a failed allocation is offered load the injector could not send
+        if (rte_pktmbuf_alloc_bulk(p_pool, mbufs.data(), conf.burst) != 0) {
+            _offered += conf.burst;
+            _tx_fail += conf.burst;
+        } else {
+            for (size_t i = 0; i < conf.burst; i ++) {
+                uint8_t * p_data = (uint8_t *) rte_pktmbuf_append(mbufs[i], PEREGRINE_FRAME_MIN_LEN);
+                memcpy(p_data, qf[cursor[q]].data(), PEREGRINE_FRAME_MIN_LEN);
+                if (replay[q]) {
+                    uint64_t ts;
+                    memcpy(&ts, p_data + ts_offset, sizeof(ts));
+                    ts = htobe64(be64toh(ts) + replay[q] * trace_span);
+                    memcpy(p_data + ts_offset, &ts, sizeof(ts));
+                }
+                if (++ cursor[q] == qf.size()) {
+                    cursor[q] = 0;
+                    replay[q] ++;
+                }
+            }
+            const uint16_t sent = rte_eth_tx_burst(conf.port, q, mbufs.data(), conf.burst);
+            for (size_t i = sent; i < conf.burst; i ++) {
+                rte_pktmbuf_free(mbufs[i]);
+            }
+            _offered += conf.burst;
+            _tx_fail += conf.burst - sent;
+        }
+        offered.store(_offered, std::memory_order_relaxed);
+        tx_fail.store(_tx_fail, std::memory_order_relaxed);
+    }
+}
+
+auto ThroughputTrial::snapshot(const ThreadStateManagement & args) const -> StageCounters {
+    StageCounters ret;
+    ret.ts = get_time_spec();
+    ret.offered = offered.load(std::memory_order_relaxed);
+    ret.tx_fail = tx_fail.load(std::memory_order_relaxed);
+    rte_eth_stats _st;
+    if (rte_eth_stats_get(conf.port, &_st) == 0) {
+        ret.nic_rx = _st.ipackets;
+        ret.nic_drop = _st.imissed + _st.ierrors + _st.rx_nombuf;
+    }
+    for (const auto & p_parser: args.parser_worker_thread_vec) {
+        const auto _c = p_parser->get_counters();
+        ret.parsed += _c.received;
+        ret.drop_overload += _c.drop_overload;
+        ret.drop_full += _c.drop_full;
+    }
+    for (const auto & p_analyzer: args.analyzer_worker_thread_vec) {
+        ret.analyzed += p_analyzer->get_fetched_num();
+    }
+    ret.cpu = read_thread_cpu();
+    return ret;
+}
+
+auto ThroughputTrial::hooks() -> RunHooks {
+    RunHooks h;
+    h.on_start = [this] (const ThreadStateManagement & args) -> void {
+        if (conf.injector) {
+            // the cores of a topology aware placement are known from here on
+            for (const auto & p_parser: args.parser_worker_thread_vec) {
+                if (p_parser->getCoreId() == conf.injector_core) {
+                    FATAL_ERROR("Harness: injector_core is the core of a parser.");
+                }
+            }
+            for (const auto & p_analyzer: args.analyzer_worker_thread_vec) {
+                if (p_analyzer->getCoreId() == conf.injector_core) {
+                    FATAL_ERROR("Harness: injector_core is the core of an analyzer.");
+                }
+            }
+            p_pool = rte_pktmbuf_pool_create("harness_pool", conf.pool_size, 256, 0,
+                                             RTE_MBUF_DEFAULT_BUF_SIZE, SOCKET_ID_ANY);
+            if (p_pool == nullptr) {
+                FATAL_ERROR("Injector: mbuf pool allocation failed.");
+            }
+            injector = thread(&ThroughputTrial::inject, this);
+        }
+        start_ts = get_time_spec();
+    };
+    h.on_tick = [this] (const ThreadStateManagement & args) -> bool {
+        const double_t _elapsed = get_time_spec() - start_ts;
+        if (!measuring && !cooling && _elapsed >= conf.warmup) {
+            window_begin = snapshot(args);
+            measuring = true;
+        } else if (measuring && _elapsed >= conf.warmup + conf.duration) {
+            window_end = snapshot(args);
+            measuring = false;
+            cooling = true;
+            injector_stop.store(true);
+            if (injector.joinable()) {
+                injector.join();
+            }
+        } else if (cooling) {
+            // let the parsers empty the NIC rings before the shutdown
+            const uint64_t _parsed = snapshot(args).parsed;
+            idle_tick = _parsed == last_parsed ? idle_tick + 1 : 0;
+            last_parsed = _parsed;
+            return idle_tick < 3 && _elapsed < conf.warmup + conf.duration + 5.0;
+        }
+        return true;
+    };
+    h.on_stop = [this] (const ThreadStateManagement & args) -> void {
+        injector_stop.store(true);
+        if (injector.joinable()) {
+            injector.join();
+        }
+        if (window_end.ts == 0) {
+            // interrupted before the end of the window
+            window_end = snapshot(args);
+        }
+        final_counters = snapshot(args);
+    };
+    return h;
+}
+
+auto ThroughputTrial::result() const -> json {
+    const double_t _dt = max(window_end.ts - window_begin.ts, 1e-9);
+    auto _mpps = [_dt] (uint64_t a, uint64_t b) -> double_t {
+        return ((double_t) (b - a)) / _dt / 1e6;
+    };
+    const auto & b = window_begin, & e = window_end, & f = final_counters;
+
+    json res;
+    res["rate_target"] = rate;
+    res["injector"] = conf.injector;
+    res["window"] = _dt;
+    res["stages"]["injector"] = {
+        {"mpps", _mpps(b.offered, e.offered)}, {"drop", e.tx_fail - b.tx_fail}
+    };
+    res["stages"]["nic"] = {
+        {"mpps", conf.injector ? _mpps(b.offered - b.tx_fail, e.offered - e.tx_fail) : _mpps(b.nic_rx, e.nic_rx)},
+        {"drop", e.nic_drop - b.nic_drop}
+    };
+    res["stages"]["parser"] = {
+        {"mpps", _mpps(b.parsed, e.parsed)},
+        {"drop_overload", e.drop_overload - b.drop_overload},
+        {"drop_ring_full", e.drop_full - b.drop_full}
+    };
+    res["stages"]["analyzer"] = {
+        {"mpps", _mpps(b.analyzed, e.analyzed)}
+    };
+
+    // per lcore utilization over the window, the injector and the master by tid
+    const double_t _hz = (double_t) sysconf(_SC_CLK_TCK);
+    const pid_t _main_tid = getpid(), _inj_tid = injector_tid.load();
+    for (const auto & ref: e.cpu) {
+        const auto _it = b.cpu.find(ref.first);
+        const uint64_t _before = _it == b.cpu.end() ? 0 : _it->second.second;
+        const double_t _util = ((double_t) (ref.second.second - _before)) / _hz / _dt;
+        string _role;
+        if (ref.first == _inj_tid) {
+            _role = "injector_core_" + to_string(conf.injector_core);
+        } else if (ref.first == _main_tid) {
+            _role = "master";
+        } else {
+            const int _lcore = lcore_of_thread(ref.second.first);
+            if (_lcore < 0) {
+                continue;
+            }
+            _role = "core_" + to_string(_lcore);
+        }
+        res["cpu"][_role] = _util;
+    }
+
+    // losses over the whole trial, after the drain
+    const uint64_t _offered = conf.injector ? f.offered : f.nic_rx + f.nic_drop;
+    const uint64_t _lost = _offered > f.analyzed ? _offered - f.analyzed : 0;
+    res["offered"] = _offered;
+    res["analyzed"] = f.analyzed;
+    res["lost"] = _lost;
+    res["loss_ratio"] = _offered ? ((double_t) _lost) / _offered : 0;
+    // the injector could not sustain the target: the trial says nothing about Whisper
+    res["injector_bound"] = conf.injector && _mpps(b.offered, e.offered) * 1e6 < 0.98 * rate;
+    res["lossless"] = !res["injector_bound"].get<bool>() &&
+                      res["loss_ratio"].get<double_t>() <= conf.loss_tolerance;
+    return res;
+}
+
+static auto run_trial(const json & config_j, const HarnessConfigParam & conf, double_t rate) -> json {
+    const auto p_device_init = make_shared<DeviceConfig>();
+    p_device_init->configure_via_json(config_j);
+    // a worker sharing the core with the injector would corrupt the measurement
+    if (conf.injector && p_device_init->is_whisper_core(conf.injector_core)) {
+        FATAL_ERROR("Harness: injector_core overlaps the cores of Whisper.");
+    }
+
+    TrafficGenerator generator;
+    if (conf.injector && !generator.configure_via_json(config_j.count("Traffic") ? config_j["Traffic"] : json())) {
+        FATAL_ERROR("Traffic generator configuration failed.");
+    }
+    size_t _tx_queue = 1;
+    if (config_j.count("DPDK") && config_j["DPDK"].count("number_tx_queue")) {
+        _tx_queue = static_cast<size_t>(config_j["DPDK"]["number_tx_queue"]);
+    }
+
+    ThroughputTrial trial(conf, rate);
+    trial.prepare(generator, _tx_queue);
+    p_device_init->set_run_hooks(trial.hooks());
+    // an invalid setup ends the process in do_init, false is a missed latency objective
+    const bool slo_met = p_device_init->do_init();
+    json res = trial.result();
+    res["slo_met"] = slo_met;
+    if (!slo_met) {
+        WARNF("Harness: trial at %4.2lf Mrps missed the detection latency objective.", rate / 1e6);
+        res["lossless"] = false;
+        res["failed"] = true;
+    }
+    return res;
+}
+
+// One trial in a child process: DPDK can not be initialized twice in a process
+static auto spawn_trial(const string & self, double_t rate) -> json {
+    char _tmp[] = "/tmp/whisper_trial_XXXXXX";
+    const int _fd = mkstemp(_tmp);
+    if (_fd < 0) {
+        FATAL_ERROR("Harness: can not create the trial result file.");
+    }
+    close(_fd);
+
+    const pid_t _pid = fork();
+    if (_pid == 0) {
+        const string _config = "--config=" + FLAGS_config;
+        const string _rate = "--rate=" + to_string(rate);
+        const string _out = "--trial_out=" + string(_tmp);
+        execl(self.c_str(), self.c_str(), _config.c_str(), _rate.c_str(), _out.c_str(), (char *) nullptr);
+        _exit(127);
+    }
+    int _status = 0;
+    waitpid(_pid, &_status, 0);
+
+    json res;
+    try {
+        ifstream fin(_tmp, ios::in);
+        fin >> res;
+    } catch (exception & e) {
+        WARNF("Harness: trial at %4.2lf Mrps failed (status %d).", rate / 1e6, _status);
+        res["rate_target"] = rate;
+        res["lossless"] = false;
+        res["failed"] = true;
+    }
+    unlink(_tmp);
+    return res;
+}
+
+static void print_trial(const json & res) {
+    printf("%8.3lf Mrps: %s, loss %4.2le, injector %6.3lf, parser %6.3lf, analyzer %6.3lf Mpps\n",
+           res["rate_target"].get<double_t>() / 1e6,
+           res["lossless"].get<bool>() ? "lossless" : (res.count("injector_bound") && res["injector_bound"].get<bool>() ?
+                                                       "injector bound" : "lossy"),
+           res.count("loss_ratio") ? res["loss_ratio"].get<double_t>() : 1.0,
+           res.count("stages") ? res["stages"]["injector"]["mpps"].get<double_t>() : 0.0,
+           res.count("stages") ? res["stages"]["parser"]["mpps"].get<double_t>() : 0.0,
+           res.count("stages") ? res["stages"]["analyzer"]["mpps"].get<double_t>() : 0.0);
+}
+
+}
+
+
+int main(int argc, char** argv) {
+    __START_FTIMMER__
+
+    // parse command line
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    json config_j;
+    try {
+        ifstream fin(FLAGS_config, ios::in);
+        fin >> config_j;
+    } catch (exception & e) {
+        FATAL_ERROR(e.what());
+    }
+
+    Whisper::HarnessConfigParam conf;
+    if (!Whisper::configure_harness(config_j.count("Harness") ? config_j["Harness"] : json(), conf)) {
+        FATAL_ERROR("Harness configuration failed.");
+    }
+
+    // one trial, in this process
+    if (FLAGS_rate > 0 || !conf.injector) {
+        conf.display_params();
+        const json res = Whisper::run_trial(config_j, conf, conf.injector ? FLAGS_rate : 0);
+        const string _out = FLAGS_trial_out.length() ? FLAGS_trial_out : FLAGS_report;
+        if (_out.length()) {
+            ofstream fout(_out, ios::out);
+            fout << res.dump(4) << endl;
+        } else {
+            cout << res.dump(4) << endl;
+        }
+        return 0;
+    }
+
+    // bisection of the rate, lo is lossless and hi is not
+    conf.display_params();
+    const string self = argv[0];
+    json trials = json::array();
+    auto _trial = [&] (double_t rate) -> bool {
+        const json res = Whisper::spawn_trial(self, rate);
+        Whisper::print_trial(res);
+        trials.push_back(res);
+        return res["lossless"].get<bool>();
+    };
+
+    double_t lo = 0, hi = conf.max_rate;
+    json best;
+    if (_trial(conf.max_rate)) {
+        lo = conf.max_rate;
+        best = trials.back();
+    } else if (_trial(conf.min_rate)) {
+        lo = conf.min_rate;
+        best = trials.back();
+        while ((hi - lo) / hi > conf.precision) {
+            const double_t mid = (lo + hi) / 2;
+            if (_trial(mid)) {
+                lo = mid;
+                best = trials.back();
+            } else {
+                hi = mid;
+            }
+        }
+    } else {
+        WARN("Harness: even the minimum rate is lossy.");
+    }
+
+    json report;
+    report["max_lossless_rate"] = lo;
+    report["upper_bound"] = hi;
+    report["best"] = best;
+    report["trials"] = trials;
+    const string _report = FLAGS_report.length() ? FLAGS_report : conf.report_file;
+    ofstream fout(_report, ios::out);
+    fout << report.dump(4) << endl;
+    printf("Max lossless rate: %4.3lf Mrps (next lossy bound %4.3lf Mrps), report: %s\n",
+           lo / 1e6, hi / 1e6, _report.c_str());
+
+    __STOP_FTIMER__
+    __PRINTF_EXE_TIME__
+}
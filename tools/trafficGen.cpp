@@ -0,0 +1,66 @@
+#include <gflags/gflags.h>
+
+
+#include "../commune/trafficGenerator.hpp"
+#include "../common.hpp"
+
+
+using namespace std;
+
+
+DEFINE_string(config, "../configTemplate.json", "Traffic section (\"Traffic\") of a Whisper JSON file.");
+DEFINE_string(output, "", "Write the Peregrine records to this pcap file.");
+DEFINE_string(labels, "", "Write the attack sources to this file (analysis/address.json format).");
+DEFINE_uint64(num, 1000000, "Number of records, 0 for no limit (with --duration).");
+DEFINE_double(duration, 0, "Seconds of trace time, 0 for no limit (with --num).");
+DEFINE_uint64(print, 0, "Print the first records to stdout.");
+
+
+int main(int argc, char** argv) {
+    __START_FTIMMER__
+
+    // parse command line
+    google::ParseCommandLineFlags(&argc, &argv, true);
+
+    json config_j;
+    try {
+        ifstream fin(FLAGS_config, ios::in);
+        fin >> config_j;
+    } catch (exception & e) {
+        FATAL_ERROR(e.what());
+    }
+    if (config_j.count("Traffic")) {
+        config_j = config_j["Traffic"];
+    }
+
+    Whisper::TrafficGenerator generator;
+    if (!generator.configure_via_json(config_j)) {
+        FATAL_ERROR("Traffic generator configuration failed.");
+    }
+    generator.get_config()->display_params();
+
+    if (FLAGS_num == 0 && FLAGS_duration <= 0) {
+        FATAL_ERROR("Either --num or --duration must limit the trace.");
+    }
+
+    for (size_t i = 0; i < FLAGS_print; i ++) {
+        Whisper::PktMetadata meta;
+        const uint64_t tick = generator.next(meta);
+        const in_addr a = {meta.ip_src};
+        printf("%lu %s %u %u\n", tick, inet_ntoa(a), meta.proto, meta.length);
+    }
+
+    if (FLAGS_output.length() != 0) {
+        const size_t written = generator.write_pcap(FLAGS_output, FLAGS_num, FLAGS_duration);
+        printf("%lu records (%4.2lfs of trace) written to %s.\n",
+               written, generator.get_elapsed(), FLAGS_output.c_str());
+    }
+
+    if (FLAGS_labels.length() != 0 && generator.write_labels(FLAGS_labels)) {
+        printf("%lu attack sources written to %s.\n",
+               generator.malicious_sources().size(), FLAGS_labels.c_str());
+    }
+
+    __STOP_FTIMER__
+    __PRINTF_EXE_TIME__
+}